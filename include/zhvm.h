@@ -10,7 +10,17 @@
 #define __ZHVM_HEADER__
 
 #include "zhvm/constants.h"
+#include "zhvm/vector.h"
+#include "zhvm/lz.h"
+#include "zhvm/segment.class.h"
+#include "zhvm/span.class.h"
+#include "zhvm/debug_info.class.h"
 #include "zhvm/memory.class.h"
+#include "zhvm/host_table.class.h"
+#include "zhvm/buffered_io.class.h"
+#include "zhvm/memory_pool.class.h"
+#include "zhvm/page_store.class.h"
+#include "zhvm/hibernation_log.class.h"
 #include "zhvm/interpreter.h"
 #include "zhvm/assembler.h"
 #include "zhvm/cmplv2.class.h"
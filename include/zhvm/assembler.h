@@ -37,6 +37,14 @@ namespace zhvm {
      */
     cchar* GetRegisterName(uint32_t reg);
 
+    /**
+     * Parse register list in form "{$A $0 $1}" to register bitmask.
+     *
+     * @param text register list
+     * @return bitmask where bit N selects register N, or -1 on error
+     */
+    int64_t GetRegisterMask(cchar* text);
+
     /**
      * Return opcode name by its ID.
      *
@@ -74,6 +82,48 @@ namespace zhvm {
      */
     void UnpackCommand(uint32_t cmd, uint32_t *opcode, uint32_t *regs, int32_t * imm);
 
+    /**
+     * Pack command to compact form.
+     *
+     * Only commands "$d = op[$s]" and "$d = op[$d, $s]" from compact table
+     * without immediate value can be packed. Commands using $p are never 
+     * packed, so jumps always end on word boundary.
+     *
+     * @param opcode operation code
+     * @param regs command registers
+     * @param imm immediate value
+     * @return compact command or ZHVM_COMPACT_NONE
+     */
+    uint32_t PackCompact(uint32_t opcode, const uint32_t *regs, int32_t imm);
+
+    /**
+     * Unpack compact command. Unused table entries are unpacked as OP_UNKNOWN.
+     *
+     * @param code compact command
+     * @param opcode result operation code
+     * @param regs result command registers
+     * @param imm result immediate value
+     */
+    void UnpackCompact(uint32_t code, uint32_t *opcode, uint32_t *regs, int32_t *imm);
+
+    /**
+     * Pack two compact commands into OP_PAIR command.
+     *
+     * @param first command executed first
+     * @param second command executed second
+     * @return OP_PAIR command
+     */
+    uint32_t PackPair(uint32_t first, uint32_t second);
+
+    /**
+     * Unpack OP_PAIR command.
+     *
+     * @param cmd OP_PAIR command
+     * @param first result first compact command
+     * @param second result second compact command
+     */
+    void UnpackPair(uint32_t cmd, uint32_t *first, uint32_t *second);
+
 
 }
 
@@ -0,0 +1,91 @@
+/**
+ * @file buffered_io.class.h
+ * @author marko
+ *
+ * Standard host functions with buffered output
+ *
+ */
+
+#pragma once
+#ifndef __ZBUFFERED_IO_CLASS_HEADER__
+#define __ZBUFFERED_IO_CLASS_HEADER__
+
+#include <istream>
+#include <ostream>
+#include <vector>
+
+namespace zhvm {
+
+    /**
+     * Console host functions of one VM. Output of CN_PUT, CN_PUTC and
+     * CN_WRITE is collected in buffer and written to stream when buffer is
+     * full, on CN_FLUSH, before every read and on Flush. Host calls Flush
+     * after VM halts. CN_WRITE and CN_READ move whole data segment range in
+     * one call.
+     */
+    class buffered_io {
+        std::ostream* out; ///< Output stream
+        std::istream* inp; ///< Input stream
+        std::vector<char> buffer; ///< Pending output
+        size_t capacity; ///< Buffer size, flushed when full
+
+        buffered_io(const buffered_io&);
+        buffered_io& operator=(const buffered_io&);
+
+        static int Put(memory* mem, void* io);
+        static int Get(memory* mem, void* io);
+        static int PutChar(memory* mem, void* io);
+        static int GetChar(memory* mem, void* io);
+        static int Write(memory* mem, void* io);
+        static int Read(memory* mem, void* io);
+        static int FlushOutput(memory* mem, void* io);
+
+        /**
+         * Write buffer to stream without stream flush
+         */
+        void Drain();
+
+        /**
+         * Append bytes to buffer, large ranges go to stream directly
+         */
+        void Append(const char* data, size_t len);
+
+    public:
+
+        /**
+         * @param out output stream
+         * @param inp input stream
+         * @param capacity output buffer size, zero writes every output at once
+         */
+        buffered_io(std::ostream* out, std::istream* inp, size_t capacity = ZHVM_IO_BUFFER_SIZE);
+
+        /**
+         * Flushes pending output
+         */
+        ~buffered_io();
+
+        /**
+         * Set standard console functions of VM, from CN_PUT to CN_FLUSH.
+         * Object must outlive VM and its copies.
+         *
+         * @param mem VM memory
+         */
+        void Install(memory* mem);
+
+        /**
+         * Write pending output to stream.
+         */
+        void Flush();
+
+        /**
+         * Pending output bytes.
+         */
+        inline size_t Pending() const {
+            return this->buffer.size();
+        }
+
+    };
+
+}
+
+#endif // __ZBUFFERED_IO_CLASS_HEADER__
@@ -11,6 +11,7 @@
 
 #include "cmplv2.h"
 #include "constants.h"
+#include <memory>
 #include <queue>
 #include <unordered_map>
 #include <string>
@@ -56,6 +57,7 @@ namespace zhvm {
     class cmplv2 {
         labels_t labels; ///< Store defined labels
         fixes_t fixes; ///< Store offset where labels must be defined
+        labels_t mnemonics; ///< User declared names of custom opcodes
 
         uint32_t code_offset; ///< code offset
         uint32_t data_offset; ///< data offset
@@ -67,6 +69,12 @@ namespace zhvm {
 
         int logstate;
 
+        bool compact; ///< Pack commands in pairs when possible
+        uint32_t pair_offset; ///< Offset of last single compact command
+        uint32_t pair_code; ///< Last single compact command
+
+        std::shared_ptr<debug_info> debug; ///< Collected labels and lines, or null
+
         cmplv2(const cmplv2& copy); ///< Forbids copy
         cmplv2& operator=(const cmplv2& copy); ///< Forbids copy
 
@@ -137,6 +145,41 @@ namespace zhvm {
 
         int LogLevel() const;
 
+        /**
+         * Enable packing of compact commands in pairs. Disabled by default.
+         * 
+         * Two adjacent commands are packed in one word, when both have compact
+         * form and no label points to second one.
+         * 
+         * @param val new state
+         * @return previous state
+         */
+        bool SetCompact(bool val);
+
+        bool Compact() const;
+
+        /**
+         * Collect labels and source line of every command into debug info
+         * attached to destination memory, so it is saved in image debug 
+         * section. Disabled by default.
+         * 
+         * @param val new state
+         * @return previous state
+         */
+        bool SetDebug(bool val);
+
+        bool Debug() const;
+
+        /**
+         * Declare mnemonic for custom opcode. Same can be done in source with
+         * "!opcode name 0x35" macro.
+         * 
+         * @param name new mnemonic
+         * @param opcode custom opcode from OP_USR0 to OP_USR9
+         * @return false if opcode is not custom or name is taken by standard opcode
+         */
+        bool DeclareOpcode(const char* name, uint32_t opcode);
+
     };
 
 }
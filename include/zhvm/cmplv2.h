@@ -33,6 +33,7 @@ namespace zhvm {
         TT2_NUMBER_SHORT,
         TT2_NUMBER_LONG,
         TT2_NUMBER_QUAD,
+        TT2_NUMBER_DOUBLE,
         TT2_MACRO,
         TT2_AT
     };
@@ -17,6 +17,11 @@
  */
 #define ZHVM_MEMORY_FILE_MAGIC (0xD0FA5534)
 
+/**
+ * ZHVM delta checkpoint identifier.
+ */
+#define ZHVM_DELTA_FILE_MAGIC (0xD0FA5535)
+
 /**
  * ZHVM versions.
  * 
@@ -25,9 +30,50 @@
  * 3) Harvard architecture adopted
  * 4) Save registers state in VM image
  * 5) Add "not" opcode
+ * 6) Add vector opcodes
+ * 7) Add hash opcodes
+ * 8) Add multi-register push/pop opcodes
+ * 9) Add "loop" opcode
+ * 10) Add double-precision floating point opcodes
+ * 11) Add compact command pairs and image flags
+ * 12) Add register windows
+ * 13) Add custom host opcodes
+ * 14) Add page aligned image layout
+ * 15) Add per-section crc32c image checksum
+ * 16) Add sparse and compressed image sections
+ * 17) Add delta checkpoints
+ * 18) Add 64-bit segment sizes
+ * 19) Add growable data segment and stack region
+ * 20) Add debug section with labels and source lines
+ * 21) Add imported host function names
  * 
  */
-#define ZHVM_VM_VERSION (5)
+#define ZHVM_VM_VERSION (21)
+
+/**
+ * Oldest ZHVM image version with compatible layout, which still can be loaded.
+ */
+#define ZHVM_VM_VERSION_MIN (4)
+
+/**
+ * First ZHVM image version with flags field in header.
+ */
+#define ZHVM_VM_VERSION_FLAGS (11)
+
+/**
+ * First ZHVM image version with checksum field in header.
+ */
+#define ZHVM_VM_VERSION_CHECKSUM (15)
+
+/**
+ * First ZHVM version with delta checkpoints.
+ */
+#define ZHVM_VM_VERSION_DELTA (17)
+
+/**
+ * First ZHVM image version with 64-bit segment sizes.
+ */
+#define ZHVM_VM_VERSION_WIDE (18)
 
 
 namespace zhvm {
@@ -87,38 +133,38 @@ namespace zhvm {
         OP_ZCL = 0x1C, ///< 0x1C Call ZHVM function
         OP_RET = 0x1D, ///< 0x1D Return from ZHVM function
         OP_NOT = 0x1E, ///< 0x1E Logical not
-        OP_R1F = 0x1F, ///< 0x1F RESERVED
-        OP_R20 = 0x20, ///< 0x20 RESERVED
-        OP_R21 = 0x21, ///< 0x21 RESERVED
-        OP_R22 = 0x22, ///< 0x22 RESERVED
-        OP_R23 = 0x23, ///< 0x23 RESERVED
-        OP_R24 = 0x24, ///< 0x24 RESERVED
-        OP_R25 = 0x25, ///< 0x25 RESERVED
-        OP_R26 = 0x26, ///< 0x26 RESERVED
-        OP_R27 = 0x27, ///< 0x27 RESERVED
-        OP_R28 = 0x28, ///< 0x28 RESERVED
-        OP_R29 = 0x29, ///< 0x29 RESERVED
-        OP_R2A = 0x2A, ///< 0x2A RESERVED
-        OP_R2B = 0x2B, ///< 0x2B RESERVED
-        OP_R2C = 0x2C, ///< 0x2C RESERVED
-        OP_R2D = 0x2D, ///< 0x2D RESERVED
-        OP_R2E = 0x2E, ///< 0x2E RESERVED
-        OP_R2F = 0x2F, ///< 0x2F RESERVED
-        OP_R30 = 0x30, ///< 0x30 RESERVED
-        OP_R31 = 0x31, ///< 0x31 RESERVED
-        OP_R32 = 0x32, ///< 0x32 RESERVED
-        OP_R33 = 0x33, ///< 0x33 RESERVED
-        OP_R34 = 0x34, ///< 0x34 RESERVED
-        OP_R35 = 0x35, ///< 0x35 RESERVED
-        OP_R36 = 0x36, ///< 0x36 RESERVED
-        OP_R37 = 0x37, ///< 0x37 RESERVED
-        OP_R38 = 0x38, ///< 0x38 RESERVED
-        OP_R39 = 0x39, ///< 0x39 RESERVED
-        OP_R3A = 0x3A, ///< 0x3A RESERVED
-        OP_R3B = 0x3B, ///< 0x3B RESERVED
-        OP_R3C = 0x3C, ///< 0x3C RESERVED
-        OP_R3D = 0x3D, ///< 0x3D RESERVED
-        OP_R3E = 0x3E, ///< 0x3E RESERVED
+        OP_VADD = 0x1F, ///< 0x1F mem[D] = mem[D] + mem[S0], S1 elements of IM bytes
+        OP_VMUL = 0x20, ///< 0x20 mem[D] = mem[D] * mem[S0], S1 elements of IM bytes
+        OP_VMIN = 0x21, ///< 0x21 mem[D] = min(mem[D], mem[S0]), S1 elements of IM bytes
+        OP_VMAX = 0x22, ///< 0x22 mem[D] = max(mem[D], mem[S0]), S1 elements of IM bytes
+        OP_VSUM = 0x23, ///< 0x23 D = sum(mem[S0]), S1 elements of IM bytes
+        OP_VDOT = 0x24, ///< 0x24 D = dot(mem[D], mem[S0]), S1 elements of IM bytes
+        OP_SDBM = 0x25, ///< 0x25 D = sdbm(D, mem[S0], S1 + IM)
+        OP_CRC = 0x26, ///< 0x26 D = crc32c(D, mem[S0], S1 + IM)
+        OP_PSH = 0x27, ///< 0x27 Push registers masked by S1 + IM to S0 stack
+        OP_POP = 0x28, ///< 0x28 Pop registers masked by S1 + IM from S0 stack
+        OP_LOOP = 0x29, ///< 0x29 S0 = S0 - 1, IF (S0 != 0) D = S1 + IM
+        OP_FADD = 0x2A, ///< 0x2A D = S0 + (S1 + IM) as doubles
+        OP_FSUB = 0x2B, ///< 0x2B D = S0 - (S1 + IM) as doubles
+        OP_FMUL = 0x2C, ///< 0x2C D = S0 * (S1 + IM) as doubles
+        OP_FDIV = 0x2D, ///< 0x2D D = S0 / (S1 + IM) as doubles
+        OP_FCMP = 0x2E, ///< 0x2E D = -1, 0, 1 comparing S0 with (S1 + IM) as doubles, 2 if unordered
+        OP_ITOF = 0x2F, ///< 0x2F D = (double) (S0 + (S1 + IM))
+        OP_FTOI = 0x30, ///< 0x30 D = (int64) (S0 + (S1 + IM)), S0 and S1 are doubles
+        OP_FSQRT = 0x31, ///< 0x31 D = sqrt(S0 + (S1 + IM)) as doubles
+        OP_PAIR = 0x32, ///< 0x32 Two compact commands in one word
+        OP_WCL = 0x33, ///< 0x33 Save window, D = S0 + (S1 + IM)
+        OP_WRT = 0x34, ///< 0x34 Restore window, D = saved D + S0 + (S1 + IM)
+        OP_USR0 = 0x35, ///< 0x35 Custom host opcode
+        OP_USR1 = 0x36, ///< 0x36 Custom host opcode
+        OP_USR2 = 0x37, ///< 0x37 Custom host opcode
+        OP_USR3 = 0x38, ///< 0x38 Custom host opcode
+        OP_USR4 = 0x39, ///< 0x39 Custom host opcode
+        OP_USR5 = 0x3A, ///< 0x3A Custom host opcode
+        OP_USR6 = 0x3B, ///< 0x3B Custom host opcode
+        OP_USR7 = 0x3C, ///< 0x3C Custom host opcode
+        OP_USR8 = 0x3D, ///< 0x3D Custom host opcode
+        OP_USR9 = 0x3E, ///< 0x3E Custom host opcode
 
         OP_NOP = 0x3F, ///< 0x3F DO NOTHING (WASTE CYCLE)
 
@@ -184,10 +230,104 @@ namespace zhvm {
     const int16_t ZHVM_IMMVAL_MIN = -(1 << 13);
 
     /**
-     * Maximum vm functions.
+     * Compact command: 5-bit index in compact table, 4-bit destination and 
+     * 4-bit source registers. Two compact commands are packed in OP_PAIR word.
+     */
+    const uint32_t ZHVM_COMPACT_BITS = 13;
+
+    /**
+     * Compact table size.
+     */
+    const uint32_t ZHVM_COMPACT_TOTAL = 1 << 5;
+
+    /**
+     * Command can't be represented in compact form.
+     */
+    const uint32_t ZHVM_COMPACT_NONE = 0xFFFFFFFF;
+
+    /**
+     * Image flags stored in VM image header.
+     */
+    enum image_flags {
+        IF_COMPACT = 1 << 0, ///< Code contains compact command pairs
+        IF_WINDOWS = 1 << 1, ///< Code uses register windows, image holds window stack
+        IF_ALIGNED = 1 << 2, ///< Code and data start at page boundary, after registers
+        IF_SPARSE = 1 << 3, ///< Sections are stored as zero runs and literal extents
+        IF_PACKED = 1 << 4, ///< Sparse section extents are compressed
+        IF_GROWABLE = 1 << 5, ///< Image holds segment limits and stack region
+        IF_DEBUG = 1 << 6, ///< Image ends with debug section, before checksum
+        IF_IMPORTS = 1 << 7, ///< Image ends with imported host function names, before debug section
+        IF_KNOWN = IF_COMPACT | IF_WINDOWS | IF_ALIGNED | IF_SPARSE | IF_PACKED | IF_GROWABLE | IF_DEBUG | IF_IMPORTS ///< All flags known to this VM
+    };
+
+    /**
+     * Image checksum algorithms stored in VM image header.
+     */
+    enum image_checksum {
+        IC_SDBM = 0, ///< Single sdbm hash of whole image, used by old images
+        IC_CRC32C = 1, ///< Separate crc32c of state, code and data sections
+        IC_TOTAL
+    };
+
+    /**
+     * Register window holds R0-R8 and return offset.
+     */
+    const uint32_t ZHVM_WINDOW_SIZE = R8 - R0 + 2;
+
+    /**
+     * Register windows kept in VM, older windows are spilled to host memory.
+     */
+    const uint32_t ZHVM_WINDOW_BANKS = 8;
+
+    /**
+     * Maximum number of windows spilled to host memory. Deeper call chains
+     * fault with register window overflow.
+     */
+    const uint32_t ZHVM_WINDOW_SPILL_MAX = 4096;
+
+    /**
+     * Number of custom host opcodes, starting from OP_USR0.
+     */
+    const uint32_t ZHVM_CUSTOM_TOTAL = OP_USR9 - OP_USR0 + 1;
+
+    /**
+     * Data segment page size used by copy-on-write and dirty page tracking.
+     */
+    const uint32_t ZHVM_PAGE_SHIFT = 12;
+    const uint32_t ZHVM_PAGE_SIZE = 1 << ZHVM_PAGE_SHIFT;
+
+    /**
+     * Default segment start alignment.
+     */
+    const uint32_t ZHVM_CACHE_LINE = 64;
+
+    /**
+     * Transparent huge page size, segments using huge pages start at its 
+     * boundary.
+     */
+    const uint32_t ZHVM_HUGE_PAGE_SIZE = 2 << 20;
+
+    /**
+     * Standard vm functions, addressed by index only.
      */
     const uint32_t ZHVM_CFUNC_ARRAY_SIZE = 0x10;
 
+    /**
+     * Maximum vm functions, including named ones. Every index fits cll
+     * immediate.
+     */
+    const uint32_t ZHVM_CFUNC_LIMIT = 0x2000;
+
+    /**
+     * Maximum length of imported function name.
+     */
+    const uint32_t ZHVM_CFUNC_NAME_MAX = 0x100;
+
+    /**
+     * Output buffer size of standard host functions.
+     */
+    const uint32_t ZHVM_IO_BUFFER_SIZE = 1 << 16;
+
     /**
      * Predefined standard vm functions.
      */
@@ -196,6 +336,9 @@ namespace zhvm {
         CN_GET = 1, ///< Read value from console
         CN_PUTC = 2, ///< Put char to stdout
         CN_GETC = 3, ///< Get char from stdin
+        CN_WRITE = 4, ///< Write RB bytes at RA to output
+        CN_READ = 5, ///< Read up to RB bytes from input to RA, RB gets bytes read
+        CN_FLUSH = 6, ///< Flush buffered output
         CN_TOTAL = ZHVM_CFUNC_ARRAY_SIZE
     };
 
@@ -0,0 +1,134 @@
+/**
+ * @file debug_info.class.h
+ * @author marko
+ *
+ * ZHVM image debug section: labels and source lines
+ *
+ */
+
+#pragma once
+#ifndef __ZDEBUG_INFO_CLASS_HEADER__
+#define __ZDEBUG_INFO_CLASS_HEADER__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace zhvm {
+
+    /**
+     * Segment of debug label.
+     */
+    enum debug_section {
+        DS_CODE, ///< Label points to code segment
+        DS_DATA, ///< Label points to data segment
+        DS_TOTAL
+    };
+
+    /**
+     * Labels and code offset to source line table of assembled image.
+     * Filled by assembler, saved in image and kept by VM aside from its
+     * code and data, so it costs nothing while VM runs.
+     */
+    class debug_info {
+
+        /**
+         * Named offset
+         */
+        struct label {
+            uint32_t offset; ///< Label offset
+            uint32_t section; ///< Label segment, see debug_section
+            std::string name; ///< Label name
+        };
+
+        /**
+         * Source line of command
+         */
+        struct line {
+            uint32_t offset; ///< Command code offset
+            uint32_t number; ///< Source line number
+        };
+
+        std::vector<label> labels; ///< Labels sorted by section and offset
+        std::vector<line> lines; ///< Lines sorted by offset
+
+    public:
+
+        /**
+         * Empty debug info
+         */
+        debug_info();
+
+        /**
+         * Add label.
+         *
+         * @param name label name
+         * @param offset label offset
+         * @param section label segment
+         * @see debug_section
+         */
+        void AddLabel(const std::string& name, uint32_t offset, uint32_t section);
+
+        /**
+         * Add source line of command. Replaces line added for same offset.
+         *
+         * @param offset command code offset
+         * @param number source line number
+         */
+        void AddLine(uint32_t offset, uint32_t number);
+
+        /**
+         * Nearest label at or below offset.
+         *
+         * @param offset offset to look up
+         * @param section offset segment
+         * @param delta output distance from label, may be null
+         * @return label name, or null when no label precedes offset
+         */
+        const char* Label(uint32_t offset, uint32_t section, uint32_t* delta) const;
+
+        /**
+         * Source line of command at or below code offset.
+         *
+         * @param offset code offset
+         * @return line number, or zero when unknown
+         */
+        uint32_t Line(uint32_t offset) const;
+
+        /**
+         * Code offset as "label+0x10:12", label or line part is omitted
+         * when unknown, bare hex offset is returned when both are.
+         *
+         * @param offset code offset
+         * @return symbolized offset
+         */
+        std::string Symbolize(uint32_t offset) const;
+
+        /**
+         * Check if there are no labels and lines
+         */
+        inline bool Empty() const {
+            return this->labels.empty() && this->lines.empty();
+        }
+
+        /**
+         * Serialize to image section.
+         *
+         * @param out output buffer, appended
+         */
+        void Save(std::vector<char>* out) const;
+
+        /**
+         * Replace contents with image section written by Save.
+         *
+         * @param buf section data
+         * @param len section length
+         */
+        void Restore(const char* buf, size_t len);
+
+    };
+
+}
+
+#endif // __ZDEBUG_INFO_CLASS_HEADER__
@@ -0,0 +1,66 @@
+/**
+ * @file hibernation_log.class.h
+ * @author marko
+ *
+ * Append-only log of suspended VMs
+ *
+ */
+
+#pragma once
+#ifndef __ZHIBERNATION_LOG_CLASS_HEADER__
+#define __ZHIBERNATION_LOG_CLASS_HEADER__
+
+#include <cstdint>
+#include <fstream>
+
+namespace zhvm {
+
+    class memory;
+
+    /**
+     * Append-only file of suspended VMs. Each record is sparse packed VM
+     * image written by memory::Suspend, so only non-zero parts of segments 
+     * take space. Records are never rewritten, VM can be suspended again 
+     * into new record after it was resumed.
+     */
+    class hibernation_log {
+        std::fstream file;
+
+        hibernation_log(const hibernation_log&);
+        hibernation_log& operator=(const hibernation_log&);
+
+    public:
+
+        /**
+         * Create empty log file.
+         *
+         * @param path log file name
+         */
+        explicit hibernation_log(const char* path);
+
+        /**
+         * Append VM to log and release its memory.
+         *
+         * @param mem VM to suspend
+         * @return record offset
+         */
+        uint64_t Suspend(memory* mem);
+
+        /**
+         * Load VM from log record.
+         *
+         * @param record record offset returned by Suspend
+         * @param mem suspended VM
+         */
+        void Resume(uint64_t record, memory* mem);
+
+        /**
+         * Log size in bytes.
+         */
+        uint64_t Size();
+
+    };
+
+}
+
+#endif // __ZHIBERNATION_LOG_CLASS_HEADER__
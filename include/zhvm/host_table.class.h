@@ -0,0 +1,141 @@
+/**
+ * @file host_table.class.h
+ * @author marko
+ *
+ * ZHVM host functions table
+ *
+ */
+
+#pragma once
+#ifndef __ZHOST_TABLE_CLASS_HEADER__
+#define __ZHOST_TABLE_CLASS_HEADER__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace zhvm {
+
+    /**
+     * Host function entry. Function with userdata is called when set,
+     * plain one otherwise.
+     */
+    struct host_func {
+        cfunc plain; ///< Plain function
+        ufunc func; ///< Function with userdata, or null
+        void* userdata; ///< Passed to func
+    };
+
+    /**
+     * Growable table of host functions called by cll. First
+     * ZHVM_CFUNC_ARRAY_SIZE slots are standard ones, addressed by index
+     * only. Named slots follow them, image imports its names and gets
+     * their indices, host binds functions to names. Index of name never
+     * changes, so call is direct table access.
+     */
+    class host_table {
+        std::vector<host_func> funcs; ///< Functions by index
+        std::vector<std::string> names; ///< Name of every slot, empty for unnamed
+        std::unordered_map<std::string, uint32_t> index; ///< Slot index by name
+
+        /**
+         * Grow table to hold index, new slots call none.
+         */
+        void Grow(uint32_t index);
+
+    public:
+
+        /**
+         * Table with ZHVM_CFUNC_ARRAY_SIZE unnamed slots calling none
+         */
+        host_table();
+
+        /**
+         * Set function at index, table grows to hold it.
+         *
+         * @param index slot index, below ZHVM_CFUNC_LIMIT
+         * @param func function entry
+         */
+        void Set(uint32_t index, const host_func& func);
+
+        /**
+         * Bind function to name. Imported or already bound name keeps its
+         * slot, other name gets new one.
+         *
+         * @param name function name
+         * @param func function entry
+         * @return slot index
+         */
+        uint32_t Bind(const std::string& name, const host_func& func);
+
+        /**
+         * Declare imported name. Name gets new slot calling none until
+         * bound, known name keeps its slot.
+         *
+         * @param name function name
+         * @return slot index
+         */
+        uint32_t Import(const std::string& name);
+
+        /**
+         * Declare imported name at given slot, as saved in image.
+         *
+         * @param name function name
+         * @param index slot index
+         * @return false when slot or name is already taken by other one
+         */
+        bool Import(const std::string& name, uint32_t index);
+
+        /**
+         * Find slot of name.
+         *
+         * @param name function name
+         * @param index output slot index
+         * @return false if name is unknown
+         */
+        bool Find(const std::string& name, uint32_t* index) const;
+
+        /**
+         * Name of slot.
+         *
+         * @return name, empty for unnamed slot
+         */
+        inline const std::string& Name(uint32_t index) const {
+            return this->names[index];
+        }
+
+        /**
+         * Check if named slot has no function bound.
+         */
+        inline bool Unbound(uint32_t index) const {
+            return (this->funcs[index].func == 0) && (this->funcs[index].plain == none);
+        }
+
+        /**
+         * Check if table has named slots.
+         */
+        inline bool Named() const {
+            return !this->index.empty();
+        }
+
+        /**
+         * Functions array
+         */
+        inline const host_func* Data() const {
+            return this->funcs.data();
+        }
+
+        /**
+         * Number of slots
+         */
+        inline uint32_t Size() const {
+            return (uint32_t) this->funcs.size();
+        }
+
+    };
+
+}
+
+#endif // __ZHOST_TABLE_CLASS_HEADER__
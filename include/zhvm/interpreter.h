@@ -16,6 +16,22 @@
 
 namespace zhvm {
 
+    /**
+     * Reinterpret register bits as IEEE double.
+     *
+     * @param val register value
+     * @return double with the same bit pattern
+     */
+    double RegToDouble(int64_t val);
+
+    /**
+     * Reinterpret IEEE double bits as register value.
+     *
+     * @param val double value
+     * @return register value with the same bit pattern
+     */
+    int64_t DoubleToReg(double val);
+
     /**
      * Invoke specified command on VM memory.
      *
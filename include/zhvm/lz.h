@@ -0,0 +1,42 @@
+/**
+ * @file lz.h
+ * @author marko
+ *
+ * Fast LZ77 block compression used by VM images
+ *
+ */
+
+#pragma once
+#ifndef __ZLZ_HEADER__
+#define __ZLZ_HEADER__
+
+#include <cstddef>
+
+namespace zhvm {
+
+    /**
+     * Compress block. Format follows LZ4 block: token with literal and
+     * match length nibbles, literals, 16-bit match offset.
+     *
+     * @param src input data
+     * @param len input length
+     * @param dst output buffer
+     * @param cap output buffer size
+     * @return compressed length, or zero if it does not fit in cap
+     */
+    size_t LzCompress(const void* src, size_t len, void* dst, size_t cap);
+
+    /**
+     * Decompress block produced by LzCompress.
+     *
+     * @param src compressed data
+     * @param len compressed length
+     * @param dst output buffer
+     * @param dlen expected output length
+     * @return true if block is valid and expands exactly to dlen bytes
+     */
+    bool LzDecompress(const void* src, size_t len, void* dst, size_t dlen);
+
+}
+
+#endif // __ZLZ_HEADER__
@@ -11,10 +11,16 @@
 #define __ZMEM_CLASS_HEADER__
 
 #include <ostream>
+#include <istream>
+#include <vector>
+#include <memory>
+#include <string>
 
 namespace zhvm {
 
     class memory;
+    class page_store;
+    class debug_info;
 
     /**
      * VM callback function
@@ -23,6 +29,26 @@ namespace zhvm {
 
     int none(memory* mem);
 
+    /**
+     * VM callback function with host userdata
+     */
+    typedef int (*ufunc)(memory* mem, void* userdata);
+
+    struct host_func;
+    class host_table;
+
+    /**
+     * Custom opcode handler. Receives decoded command registers and immediate.
+     *
+     * @return invoke result
+     * @see invoke_result
+     */
+    typedef int (*cop)(memory* mem, uint32_t dst, uint32_t src0, uint32_t src1, int32_t imm);
+
+    int nocop(memory* mem, uint32_t dst, uint32_t src0, uint32_t src1, int32_t imm);
+
+    struct image_sum;
+
     /**
      * VM memory class.
      */
@@ -30,14 +56,104 @@ namespace zhvm {
       
         reg_t regs[RTOTAL];
         int32_t sflag;
+        uint32_t iflags;
 
-        char* cdata;
+        std::shared_ptr<char> code; ///< Code segment, shared between copies
+        bool cfixed; ///< Code segment is read-only mapping
+        char* cdata; ///< Cached code segment pointer
         size_t csize;
 
-        char* ddata;
-        size_t dsize;
+        segment data; ///< Data segment storage, reserved up to limit
+        char* ddata; ///< Cached data segment pointer
+        size_t dsize; ///< Used data segment size
+        size_t dlimit; ///< Data segment grows up to this size
+
+        segment stack; ///< Stack region below zero address
+        size_t ssize; ///< Used stack region size
+
+        std::shared_ptr<host_table> funcs; ///< Host functions, shared between copies until changed
+        const host_func* fdata; ///< Cached host functions pointer
+        uint32_t fcount; ///< Cached host functions count
+        cop cops[ZHVM_CUSTOM_TOTAL];
+
+        reg_t wbanks[ZHVM_WINDOW_BANKS * ZHVM_WINDOW_SIZE]; ///< Register windows ring
+        uint32_t whead; ///< Next free window in ring
+        uint32_t wcount; ///< Windows in ring
+        std::vector<reg_t> wspill; ///< Windows spilled from ring, oldest first
+
+        uint32_t chkid; ///< Last checkpoint id
+        bool cchanged; ///< Code changed since last checkpoint
+
+        std::shared_ptr<const debug_info> debug; ///< Labels and source lines, never used by interpreter
+
+        /**
+         * Make private copy of shared code segment
+         */
+        void UnshareCode();
+
+        /**
+         * Make private copy of shared host functions table
+         */
+        host_table* UnshareFuncs();
 
-        cfunc funcs[ZHVM_CFUNC_ARRAY_SIZE];
+        /**
+         * Replace host functions table, update cached pointer
+         */
+        void SetTable(const std::shared_ptr<host_table>& table);
+
+        /**
+         * Data or stack region range for reading.
+         *
+         * @return range address, or null when range is out of both regions
+         */
+        const char* Fetch(off_t offset, size_t len) const;
+
+        /**
+         * Data or stack region range for writing. Used size of region grows
+         * up to its limit, written pages are tracked.
+         *
+         * @return range address, or null when range is out of both regions
+         */
+        char* Store(off_t offset, size_t len);
+
+        /**
+         * Reserve data segment up to data limit
+         */
+        void ApplyLimit();
+
+        /**
+         * Write registers and windows to image
+         *
+         * @return bytes written
+         */
+        size_t DumpState(std::ostream& out, image_sum* sum) const;
+
+        /**
+         * Read registers and windows from image
+         *
+         * @return bytes read
+         */
+        size_t LoadState(std::istream& inp, image_sum* sum);
+
+        /**
+         * Write names of imported host functions to image
+         */
+        void DumpImports(std::ostream& out, image_sum* sum) const;
+
+        /**
+         * Read names of imported host functions from image. Names bound in
+         * host table are resolved to their functions.
+         *
+         * @param bound host table with bound functions
+         */
+        void LoadImports(std::istream& inp, image_sum* sum, const host_table* bound);
+
+        /**
+         * Write VM image
+         *
+         * @return image checksum id
+         */
+        uint32_t DumpImage(std::ostream& out) const;
 
     public:
 
@@ -53,7 +169,7 @@ namespace zhvm {
         explicit memory(size_t codesize, size_t datasize);
 
         /**
-         * Copy constructor
+         * Copy constructor. Code segment is shared with copy until SetCode
          * @param copy memory copy
          */
         explicit memory(const memory& copy);
@@ -64,6 +180,15 @@ namespace zhvm {
          */
         explicit memory(memory&& mv);
 
+        /**
+         * Fork VM. Child gets same registers, functions and data, 
+         * data pages are shared copy-on-write, so fork cost depends on 
+         * pages written since first fork, not on data size.
+         * 
+         * @param child memory to replace with forked VM
+         */
+        void Fork(memory* child);
+
         /**
          * Copy assignment
          */
@@ -125,7 +250,8 @@ namespace zhvm {
 
         /**
          * 
-         * Set code instruction in memory
+         * Set code instruction in memory. Shared code segment is copied 
+         * before first write.
          * 
          * @param offset memory offset
          * @param code code to set
@@ -133,6 +259,14 @@ namespace zhvm {
          */
         memory& SetCode(off_t offset, uint32_t code);
 
+        /**
+         * Check if code segment is shared with other memory.
+         *
+         * @param other other memory
+         * @return true if both use same code buffer
+         */
+        bool SharesCode(const memory& other) const;
+
 
         /**
          * Set byte in memory.
@@ -190,6 +324,216 @@ namespace zhvm {
          */
         int32_t Compare(off_t src0, off_t src1, size_t len);
 
+        /**
+         * Write host buffer to memory. Whole range is checked once.
+         *
+         * @param dest destination offset
+         * @param src host buffer
+         * @param len byte length
+         * @return self
+         */
+        memory& Write(off_t dest, const void* src, size_t len);
+
+        /**
+         * Read memory to host buffer. Whole range is checked once.
+         *
+         * @param dest host buffer
+         * @param src source offset
+         * @param len byte length
+         */
+        void Read(void* dest, off_t src, size_t len) const;
+
+        /**
+         * Writable view of memory range. Range is checked and marked as
+         * changed, so host writes through view are seen by Fork and Delta.
+         *
+         * @param offset range offset
+         * @param len byte length
+         * @return view of range
+         */
+        span<char> View(off_t offset, size_t len);
+
+        /**
+         * Read-only view of memory range.
+         *
+         * @param offset range offset
+         * @param len byte length
+         * @return view of range
+         */
+        span<const char> View(off_t offset, size_t len) const;
+
+        /**
+         * Element-wise vector addition mem[dest] += mem[src]
+         * 
+         * Both ranges are checked once before kernel invocation.
+         * 
+         * @param dest destination offset
+         * @param src source offset
+         * @param count number of elements
+         * @param width element width in bytes (1, 2, 4 or 8)
+         * @return self
+         */
+        memory& VectorAdd(off_t dest, off_t src, size_t count, size_t width);
+
+        /**
+         * Element-wise vector multiplication mem[dest] *= mem[src]
+         * 
+         * @param dest destination offset
+         * @param src source offset
+         * @param count number of elements
+         * @param width element width in bytes (1, 2, 4 or 8)
+         * @return self
+         */
+        memory& VectorMul(off_t dest, off_t src, size_t count, size_t width);
+
+        /**
+         * Element-wise vector minimum mem[dest] = min(mem[dest], mem[src])
+         * 
+         * @param dest destination offset
+         * @param src source offset
+         * @param count number of elements
+         * @param width element width in bytes (1, 2, 4 or 8)
+         * @return self
+         */
+        memory& VectorMin(off_t dest, off_t src, size_t count, size_t width);
+
+        /**
+         * Element-wise vector maximum mem[dest] = max(mem[dest], mem[src])
+         * 
+         * @param dest destination offset
+         * @param src source offset
+         * @param count number of elements
+         * @param width element width in bytes (1, 2, 4 or 8)
+         * @return self
+         */
+        memory& VectorMax(off_t dest, off_t src, size_t count, size_t width);
+
+        /**
+         * Sum of vector elements
+         * 
+         * @param src source offset
+         * @param count number of elements
+         * @param width element width in bytes (1, 2, 4 or 8)
+         * @return sum of elements
+         */
+        int64_t VectorSum(off_t src, size_t count, size_t width) const;
+
+        /**
+         * Dot product of two vectors
+         * 
+         * @param src0 first vector offset
+         * @param src1 second vector offset
+         * @param count number of elements
+         * @param width element width in bytes (1, 2, 4 or 8)
+         * @return dot product
+         */
+        int64_t VectorDot(off_t src0, off_t src1, size_t count, size_t width) const;
+
+        /**
+         * Push registers to stack.
+         * 
+         * Registers are stored as quads, lowest register ID at lowest 
+         * address. Zero and stack registers are ignored in mask.
+         * 
+         * @param sreg stack pointer register ID
+         * @param mask registers bitmask, bit N selects register N
+         * @return self
+         */
+        memory& PushRegs(uint32_t sreg, uint32_t mask);
+
+        /**
+         * Pop registers from stack, pushed by PushRegs with same mask.
+         * 
+         * @param sreg stack pointer register ID
+         * @param mask registers bitmask, bit N selects register N
+         * @return self
+         */
+        memory& PopRegs(uint32_t sreg, uint32_t mask);
+
+        /**
+         * Open new register window. Save R0-R8 and return offset, then clear 
+         * R0-R8. When all banks are used, oldest window is spilled to memory.
+         * Throws when ZHVM_WINDOW_SPILL_MAX windows are already spilled.
+         * 
+         * @param ret return offset
+         * @return self
+         */
+        memory& PushWindow(int64_t ret);
+
+        /**
+         * Close register window. Restore R0-R8 saved by PushWindow.
+         * 
+         * @return saved return offset
+         */
+        int64_t PopWindow();
+
+        /**
+         * Number of open register windows.
+         * 
+         * @return window count
+         */
+        size_t WindowDepth() const;
+
+        /**
+         * Set data segment and stack region limits. Data segment grows on 
+         * demand from its current size up to data limit, its addresses never
+         * move. Stack region lies below zero address, so $s starting at zero
+         * grows down into it, up to stack limit. Limits never shrink used 
+         * parts and are saved in image.
+         *
+         * @param datalimit maximum data segment size
+         * @param stacklimit maximum stack region size
+         */
+        void SetLimits(size_t datalimit, size_t stacklimit);
+
+        /**
+         * Code segment size.
+         */
+        inline size_t CodeSize() const {
+            return this->csize;
+        }
+
+        /**
+         * Data segment size limit.
+         */
+        inline size_t DataLimit() const {
+            return this->dlimit;
+        }
+
+        /**
+         * Used data segment size, saved in image.
+         */
+        inline size_t DataSize() const {
+            return this->dsize;
+        }
+
+        /**
+         * Used stack region size.
+         */
+        inline size_t StackSize() const {
+            return this->ssize;
+        }
+
+        /**
+         * Continue sdbm hash over memory range
+         * 
+         * @param hash old hash
+         * @param src data offset
+         * @param len data length
+         * @return new hash
+         */
+        uint32_t HashSdbm(uint32_t hash, off_t src, size_t len) const;
+
+        /**
+         * Continue crc32c checksum over memory range
+         * 
+         * @param crc old checksum
+         * @param src data offset
+         * @param len data length
+         * @return new checksum
+         */
+        uint32_t HashCrc32c(uint32_t crc, off_t src, size_t len) const;
+
         /**
          * 
          * Get code from memory.
@@ -253,21 +597,201 @@ namespace zhvm {
          */
         void Load(std::istream& input);
 
+        /**
+         * Load VM memory image from file. Page aligned images are mapped 
+         * without copying: code read-only, data copy-on-write. Other 
+         * images are loaded with Load.
+         *
+         * @param path image file name
+         * @param verify check image hash, this reads all mapped pages
+         */
+        void Map(const char* path, bool verify);
+
+        /**
+         * Place host file contents in data segment. On POSIX hosts file is 
+         * mapped copy-on-write, so nothing is read until guest touches it, 
+         * elsewhere it is read. Guest writes are private, file never 
+         * changes. Data segment grows to hold file when needed.
+         *
+         * @param path host file name
+         * @param offset data segment offset, must be page aligned
+         * @return file length
+         */
+        size_t MapFile(const char* path, off_t offset);
+
+        /**
+         * Share non-zero data segment pages with store. Pages with same 
+         * contents as pages of other VMs sharing same store use one 
+         * copy-on-write copy. Call right after Load, when segment is still
+         * private to this VM, so memory of its own copies is released.
+         * Does nothing on hosts without mmap.
+         *
+         * @param store page store
+         */
+        void ShareData(page_store* store);
+
+        /**
+         * Write VM as sparse packed image, then release code, data and 
+         * stack. Host functions, custom opcodes and image flags stay, so 
+         * VM is ready for Resume.
+         *
+         * @param output output stream
+         * @return image hash
+         */
+        uint32_t Suspend(std::ostream& output);
+
+        /**
+         * Load VM written by Suspend, keeping host functions, custom 
+         * opcodes and image flags.
+         *
+         * @param input input stream
+         */
+        void Resume(std::istream& input);
+
+        /**
+         * Write full VM image and start tracking changed pages.
+         *
+         * @param output output stream
+         */
+        void Checkpoint(std::ostream& output);
+
+        /**
+         * Write delta checkpoint: registers, windows, code if it was changed 
+         * and data pages changed since last checkpoint.
+         *
+         * @param output output stream
+         */
+        void Delta(std::ostream& output);
+
+        /**
+         * Apply delta checkpoint. Delta must be written right after 
+         * checkpoint, which was loaded into this memory.
+         *
+         * @param input input stream
+         */
+        void LoadDelta(std::istream& input);
+
+        /**
+         * Image flags saved in VM image header.
+         *
+         * @return image flags
+         * @see image_flags
+         */
+        uint32_t ImageFlags() const;
+
+        /**
+         * Set image flags saved in VM image header.
+         *
+         * @param flags image flags
+         * @return self
+         * @see image_flags
+         */
+        memory& SetImageFlags(uint32_t flags);
+
+        /**
+         * Debug info of loaded or assembled image.
+         *
+         * @return debug info, or null
+         */
+        inline const debug_info* Debug() const {
+            return this->debug.get();
+        }
+
+        /**
+         * Attach debug info, saved in image debug section. Info is shared
+         * with copies and forks.
+         *
+         * @param info debug info, null drops it
+         */
+        void SetDebug(const std::shared_ptr<const debug_info>& info);
+
         /**
          * Create new vm image
          */
         void NewImage(size_t codesize, size_t datasize);
 
         /**
-         * Assign function to index
+         * Same as NewImage, but private code and data buffers are reused 
+         * when they are large enough, data segment zeroes only written
+         * pages. Host functions and custom opcodes are kept.
+         */
+        void Reset(size_t codesize, size_t datasize);
+
+        /**
+         * Assign function to index, table grows to hold it
          */
         void SetFuncs(uint32_t index, cfunc func);
 
+        /**
+         * Assign function with userdata to index, table grows to hold it
+         */
+        void SetFuncs(uint32_t index, ufunc func, void* userdata);
+
+        /**
+         * Bind function to name. Name imported by image keeps its index,
+         * other name gets new one. Names bound before Load are resolved 
+         * against image imports.
+         *
+         * @param name function name
+         * @param func function
+         * @param userdata passed to function
+         * @return function index for cll
+         */
+        uint32_t Bind(const char* name, ufunc func, void* userdata);
+
+        /**
+         * Bind plain function to name.
+         *
+         * @see Bind
+         */
+        uint32_t Bind(const char* name, cfunc func);
+
+        /**
+         * Declare host function imported by code. Image saves its name and
+         * index, function is bound by host later.
+         *
+         * @param name function name
+         * @return function index for cll
+         */
+        uint32_t Import(const char* name);
+
+        /**
+         * Host functions table
+         */
+        inline const host_table& Funcs() const {
+            return *this->funcs;
+        }
+
+        /**
+         * Imported names without bound function.
+         *
+         * @param names output names
+         */
+        void Unbound(std::vector<std::string>* names) const;
+
         /**
          * Call function by index
          */
         int Call(uint32_t index);
 
+        /**
+         * Assign handler to custom opcode.
+         *
+         * @param opcode custom opcode from OP_USR0 to OP_USR9
+         * @param handler opcode handler
+         */
+        void SetCustom(uint32_t opcode, cop handler);
+
+        /**
+         * Call custom opcode handler.
+         *
+         * @param opcode custom opcode from OP_USR0 to OP_USR9
+         * @return invoke result
+         */
+        inline int Custom(uint32_t opcode, uint32_t dst, uint32_t src0, uint32_t src1, int32_t imm) {
+            return this->cops[opcode - OP_USR0](this, dst, src0, src1, imm);
+        }
+
     };
     
     /**
@@ -281,6 +805,19 @@ namespace zhvm {
      */
     uint32_t sdbm(uint32_t hash, const void* data, size_t len);
 
+    /**
+     * 
+     * CRC-32C (Castagnoli) checksum.
+     * 
+     * Uses SSE4.2 crc32 instruction when CPU supports it.
+     * 
+     * @param crc old checksum, zero to start
+     * @param data input data buffer
+     * @param len input data length
+     * @return new checksum
+     */
+    uint32_t crc32c(uint32_t crc, const void* data, size_t len);
+
 
 }
 
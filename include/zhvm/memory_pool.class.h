@@ -0,0 +1,80 @@
+/**
+ * @file memory_pool.class.h
+ * @author marko
+ *
+ * Pool of reusable VM instances
+ *
+ */
+
+#pragma once
+#ifndef __ZMEMORY_POOL_CLASS_HEADER__
+#define __ZMEMORY_POOL_CLASS_HEADER__
+
+#include <cstddef>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace zhvm {
+
+    class memory;
+
+    /**
+     * Pool of VM instances for short-lived VMs. Released instances are kept 
+     * by code size and data segment size class, which is power of two pages.
+     * Acquired instance is reset with memory::Reset, so it keeps committed 
+     * buffers and host functions, and zeroes only pages written by previous
+     * owner.
+     *
+     * Pool is not thread safe.
+     */
+    class memory_pool {
+        typedef std::pair<size_t, size_t> size_class;
+
+        std::map<size_class, std::vector<memory*> > idle; ///< Released instances by size class
+        size_t keep; ///< Maximum released instances kept in each size class
+
+        memory_pool(const memory_pool&);
+        memory_pool& operator=(const memory_pool&);
+
+    public:
+
+        /**
+         * Empty pool
+         * @param keep maximum released instances kept in each size class
+         */
+        explicit memory_pool(size_t keep = 64);
+
+        /**
+         * Deletes released instances. Acquired instances stay valid and can
+         * be deleted by owner.
+         */
+        ~memory_pool();
+
+        /**
+         * Get instance same as new memory(codesize, datasize), except 
+         * host functions set by its previous owner.
+         *
+         * @param codesize code segment size
+         * @param datasize data segment size
+         * @return instance owned by caller until Release
+         */
+        memory* Acquire(size_t codesize, size_t datasize);
+
+        /**
+         * Return instance to pool, or delete it when its size class is full.
+         *
+         * @param mem instance from Acquire
+         */
+        void Release(memory* mem);
+
+        /**
+         * Number of released instances kept by pool.
+         */
+        size_t Idle() const;
+
+    };
+
+}
+
+#endif // __ZMEMORY_POOL_CLASS_HEADER__
@@ -0,0 +1,70 @@
+/**
+ * @file page_store.class.h
+ * @author marko
+ *
+ * Content addressed store of data segment pages
+ *
+ */
+
+#pragma once
+#ifndef __ZPAGE_STORE_CLASS_HEADER__
+#define __ZPAGE_STORE_CLASS_HEADER__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+namespace zhvm {
+
+    /**
+     * Store of unique data segment pages. Every page is kept once in store 
+     * file, found by its crc32c and contents. VM sharing its data with store
+     * maps store pages copy-on-write instead of own copies, so identical 
+     * pages of many loaded images use same memory until first write.
+     *
+     * Store is not thread safe. Mapped pages stay valid after store is 
+     * destroyed.
+     */
+    class page_store {
+        std::shared_ptr<int> file; ///< Store file
+        size_t pages; ///< Number of pages in store file
+        std::unordered_multimap<uint32_t, size_t> index; ///< Page index by hash
+
+        page_store(const page_store&);
+        page_store& operator=(const page_store&);
+
+    public:
+
+        /**
+         * Empty store
+         */
+        page_store();
+
+        /**
+         * Find page with same contents, or add it to store.
+         *
+         * @param page ZHVM_PAGE_SIZE bytes
+         * @return page index in store file
+         */
+        size_t Intern(const char* page);
+
+        /**
+         * Store file shared by all mappings.
+         */
+        inline const std::shared_ptr<int>& File() const {
+            return this->file;
+        }
+
+        /**
+         * Number of unique pages in store.
+         */
+        inline size_t Pages() const {
+            return this->pages;
+        }
+
+    };
+
+}
+
+#endif // __ZPAGE_STORE_CLASS_HEADER__
@@ -0,0 +1,248 @@
+/**
+ * @file segment.class.h
+ * @author marko
+ *
+ * ZHVM data segment storage
+ *
+ */
+
+#pragma once
+#ifndef __ZSEGMENT_CLASS_HEADER__
+#define __ZSEGMENT_CLASS_HEADER__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace zhvm {
+
+    /**
+     * Segment allocation options, common for all segments of host process.
+     */
+    struct segment_options {
+        size_t align; ///< Segment start alignment, power of two
+        size_t hugepages; ///< Segments of this size or larger use transparent huge pages, zero disables them
+    };
+
+    /**
+     * Data segment storage with page granular copy-on-write.
+     *
+     * On POSIX hosts segment is mapped memory. Written pages are tracked in
+     * dirty bitmap. First Fork writes them to anonymous file, which becomes
+     * immutable base for parent and all children, both map it privately.
+     * Base file descriptor is shared by them and closed with last one, so
+     * segments hold no descriptor until they fork. Pages written after that
+     * are tracked again, so next forks copy only them. Segment mapped from
+     * image file uses that file as base. Host files mapped over segment 
+     * range stay mapped in children too. Memory is mapped without swap 
+     * reservation, pages are committed on first write.
+     *
+     * On other hosts Fork falls back to full copy.
+     */
+    class segment {
+
+        /**
+         * Host file mapped over segment range
+         */
+        struct file_range {
+            size_t offset; ///< Range offset in segment
+            size_t len; ///< Range length
+            size_t foffset; ///< Range offset in file
+            std::shared_ptr<int> file; ///< File descriptor, closed with last range
+        };
+
+        char* data;
+        size_t size;
+        std::shared_ptr<int> base; ///< Base file descriptor, or null
+        size_t boffset; ///< Segment offset in base file
+        size_t blen; ///< Segment bytes backed by base file
+        std::vector<uint64_t> dirty; ///< Pages changed since base was created, or allocation
+        std::vector<uint64_t> changed; ///< Pages changed since last checkpoint
+        std::vector<file_range> files; ///< Host files mapped over base
+
+        void Allocate(size_t size);
+        void CopyDirty(const segment& copy);
+        void Release();
+        void Freeze();
+        void Clone(segment* child, size_t size) const;
+        void MapRange(const std::shared_ptr<int>& file, size_t offset, size_t len, size_t foffset);
+
+    public:
+
+        /**
+         * Empty segment
+         */
+        segment();
+
+        /**
+         * Zero filled segment
+         * @param size segment size in bytes
+         */
+        explicit segment(size_t size);
+
+#ifndef WIN32
+        /**
+         * Copy-on-write mapping of file range. File becomes segment base.
+         * @param fd file descriptor, segment keeps own duplicate
+         * @param offset range offset, must be page aligned
+         * @param size segment size in bytes
+         */
+        segment(int fd, size_t offset, size_t size);
+#endif
+
+        /**
+         * Full copy of segment
+         * @param copy source segment
+         */
+        segment(const segment& copy);
+
+        /**
+         * Segment of same size, where only len bytes at offset are copied
+         * and rest is zero.
+         * @param copy source segment
+         * @param offset copied range offset
+         * @param len copied range length
+         */
+        segment(const segment& copy, size_t offset, size_t len);
+
+        segment(segment&& mv);
+
+        segment& operator=(const segment& src);
+
+        segment& operator=(segment&& src);
+
+        ~segment();
+
+        /**
+         * Reserve zero filled memory. On POSIX hosts memory is mapped 
+         * without swap reservation, pages are committed on first write.
+         *
+         * @param size size in bytes
+         * @return memory, or null for zero size
+         */
+        static char* Reserve(size_t size);
+
+        /**
+         * Release memory returned by Reserve.
+         */
+        static void Unreserve(char* ptr, size_t size);
+
+        /**
+         * Set allocation options for segments allocated later. Segments 
+         * are page aligned on POSIX hosts, larger alignment is honored too.
+         * Segment using huge pages starts at huge page boundary and is 
+         * advised to kernel as huge page candidate.
+         *
+         * Must be called before VM instances are created.
+         */
+        static void SetOptions(const segment_options& options);
+
+        /**
+         * Current allocation options.
+         */
+        static segment_options Options();
+
+        /**
+         * Segment data
+         */
+        inline char* Data() const {
+            return this->data;
+        }
+
+        /**
+         * Segment size in bytes
+         */
+        inline size_t Size() const {
+            return this->size;
+        }
+
+        /**
+         * Mark range as changed. Must be called before every write.
+         *
+         * @param offset range offset
+         * @param len range length
+         */
+        inline void Touch(size_t offset, size_t len) {
+            if (len != 0) {
+                size_t last = (offset + len - 1) >> ZHVM_PAGE_SHIFT;
+                for (size_t page = offset >> ZHVM_PAGE_SHIFT; page <= last; ++page) {
+                    this->dirty[page >> 6] |= 1ull << (page & 63);
+                    this->changed[page >> 6] |= 1ull << (page & 63);
+                }
+            }
+        }
+
+        /**
+         * Create copy-on-write child. Parent and child see
+         * same data, but later writes are private.
+         *
+         * @param child segment to replace with child
+         */
+        void Fork(segment* child);
+
+        /**
+         * Grow segment to new size. Contents are kept, new bytes are zero.
+         * Host address of data may change, smaller size is ignored.
+         *
+         * @param size new size in bytes
+         */
+        void Resize(size_t size);
+
+        /**
+         * Zero whole segment. Segment without base and host files keeps its
+         * memory and zeroes only pages written since allocation, other 
+         * segment is allocated again.
+         */
+        void Reset();
+
+#ifndef WIN32
+        /**
+         * Map host file copy-on-write over segment range. Range gets file
+         * contents and is marked as changed, later writes are private and
+         * never reach the file.
+         *
+         * @param fd file descriptor, segment keeps own duplicate
+         * @param offset range offset, must be page aligned
+         * @param len mapped file length
+         */
+        void MapFile(int fd, size_t offset, size_t len);
+
+        /**
+         * Replace segment range with copy-on-write mapping of file range 
+         * holding same contents, so identical pages of many segments use 
+         * same memory. Memory under range is released when segment is only
+         * owner of it. Range is not marked as changed.
+         *
+         * @param file file descriptor shared by all its mappings
+         * @param offset range offset, must be page aligned
+         * @param len range length
+         * @param foffset range offset in file, must be page aligned
+         */
+        void Share(const std::shared_ptr<int>& file, size_t offset, size_t len, size_t foffset);
+
+        /**
+         * Unlinked temporary file, in memory where host supports it.
+         *
+         * @return file descriptor, or -1
+         */
+        static int AnonymousFile();
+#endif
+
+        /**
+         * Pages changed since last ClearChanged.
+         *
+         * @param pages output page indices, ascending
+         */
+        void ChangedPages(std::vector<uint32_t>* pages) const;
+
+        /**
+         * Start new checkpoint, forget changed pages.
+         */
+        void ClearChanged();
+
+    };
+
+}
+
+#endif // __ZSEGMENT_CLASS_HEADER__
@@ -0,0 +1,76 @@
+/**
+ * @file span.class.h
+ * @author marko
+ *
+ * Direct view of guest memory range
+ *
+ */
+
+#pragma once
+#ifndef __ZSPAN_CLASS_HEADER__
+#define __ZSPAN_CLASS_HEADER__
+
+#include <cstddef>
+
+namespace zhvm {
+
+    /**
+     * Host view of checked guest memory range. View does not own memory and
+     * stays valid until data segment grows, or memory is loaded or assigned.
+     *
+     * @param T char for writable view, const char for read-only one
+     */
+    template<typename T>
+    class span {
+        T* ptr;
+        size_t len;
+
+    public:
+
+        /**
+         * Empty view
+         */
+        span() : ptr(0), len(0) {
+            ;
+        }
+
+        /**
+         * View of len bytes at ptr
+         */
+        span(T* ptr, size_t len) : ptr(ptr), len(len) {
+            ;
+        }
+
+        /**
+         * Writable view is also read-only view
+         */
+        template<typename U>
+        span(const span<U>& other) : ptr(other.Data()), len(other.Size()) {
+            ;
+        }
+
+        inline T* Data() const {
+            return this->ptr;
+        }
+
+        inline size_t Size() const {
+            return this->len;
+        }
+
+        inline T* begin() const {
+            return this->ptr;
+        }
+
+        inline T* end() const {
+            return this->ptr + this->len;
+        }
+
+        inline T& operator[](size_t index) const {
+            return this->ptr[index];
+        }
+
+    };
+
+}
+
+#endif // __ZSPAN_CLASS_HEADER__
@@ -0,0 +1,91 @@
+/**
+ * @file vector.h
+ * @author marko
+ *
+ * Vector kernels over raw memory ranges
+ *
+ */
+
+#pragma once
+#ifndef __ZVECTOR_HEADER__
+#define __ZVECTOR_HEADER__
+
+#include <cstdint>
+#include <cstddef>
+
+namespace zhvm {
+
+    /**
+     * Check if vector element width is supported.
+     *
+     * @param width element width in bytes
+     * @return true for 1, 2, 4 or 8 bytes
+     */
+    bool VecWidth(size_t width);
+
+    /**
+     * Element-wise addition: dst[i] = dst[i] + src[i].
+     *
+     * Kernels do not check bounds, caller must validate both ranges.
+     *
+     * @param dst destination elements
+     * @param src source elements
+     * @param count number of elements
+     * @param width element width in bytes
+     */
+    void VecAdd(void* dst, const void* src, size_t count, size_t width);
+
+    /**
+     * Element-wise multiplication: dst[i] = dst[i] * src[i].
+     *
+     * @param dst destination elements
+     * @param src source elements
+     * @param count number of elements
+     * @param width element width in bytes
+     */
+    void VecMul(void* dst, const void* src, size_t count, size_t width);
+
+    /**
+     * Element-wise minimum: dst[i] = min(dst[i], src[i]).
+     *
+     * @param dst destination elements
+     * @param src source elements
+     * @param count number of elements
+     * @param width element width in bytes
+     */
+    void VecMin(void* dst, const void* src, size_t count, size_t width);
+
+    /**
+     * Element-wise maximum: dst[i] = max(dst[i], src[i]).
+     *
+     * @param dst destination elements
+     * @param src source elements
+     * @param count number of elements
+     * @param width element width in bytes
+     */
+    void VecMax(void* dst, const void* src, size_t count, size_t width);
+
+    /**
+     * Sum of signed elements.
+     *
+     * @param src source elements
+     * @param count number of elements
+     * @param width element width in bytes
+     * @return sum of elements
+     */
+    int64_t VecSum(const void* src, size_t count, size_t width);
+
+    /**
+     * Dot product of signed elements.
+     *
+     * @param src0 first vector elements
+     * @param src1 second vector elements
+     * @param count number of elements
+     * @param width element width in bytes
+     * @return sum of src0[i] * src1[i]
+     */
+    int64_t VecDot(const void* src0, const void* src1, size_t count, size_t width);
+
+}
+
+#endif // __ZVECTOR_HEADER__
@@ -168,6 +168,18 @@ namespace zlg {
         zbinop(opid id, node_p left, node_p right) : node(), id(id), left(left), right(right) {
         }
 
+        opid ID() const {
+            return this->id;
+        }
+
+        node_p Left() const {
+            return this->left;
+        }
+
+        node_p Right() const {
+            return this->right;
+        }
+
         zbinop(const zbinop& src) : node(src), id(src.id), left(src.left), right(src.right) {
             ;
         }
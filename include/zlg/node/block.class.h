@@ -13,6 +13,10 @@ namespace zlg {
             this->items.push_back(item);
         }
 
+        const std::list<node_p>& Items() const {
+            return this->items;
+        }
+
         void prepare_node(regmap_t* map) {
             for (std::list<node_p>::iterator i = this->items.begin(), e = this->items.end(); i != e; ++i) {
                 (*i)->prepare_node(map);
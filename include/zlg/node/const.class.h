@@ -51,6 +51,10 @@ namespace zlg {
             ;
         }
 
+        int64_t Value() const {
+            return this->value;
+        }
+
         zconst& operator=(const zconst& src) {
             if (this != &src) {
                 node::operator=(src);
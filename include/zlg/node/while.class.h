@@ -19,8 +19,97 @@ namespace zlg {
             this->uid = map->Counter();
         }
 
+    private:
+
+        /**
+         * Check if item is "counter = counter - 1" statement.
+         */
+        static bool IsDecrement(const node_p& item, const zvar* counter) {
+            const zbinop* set = dynamic_cast<const zbinop*> (item.get());
+            if ((set == 0) || (set->ID() != zbinop::SET)) {
+                return false;
+            }
+            const zvar* left = dynamic_cast<const zvar*> (set->Left().get());
+            const zbinop* sub = dynamic_cast<const zbinop*> (set->Right().get());
+            if ((left == 0) || (sub == 0) || (sub->ID() != zbinop::SUB)) {
+                return false;
+            }
+            const zvar* subleft = dynamic_cast<const zvar*> (sub->Left().get());
+            const zconst* subright = dynamic_cast<const zconst*> (sub->Right().get());
+            return (subleft != 0) && (subright != 0) && (subright->Value() == 1)
+                    && (left->VarID() == counter->VarID())
+                    && (subleft->VarID() == counter->VarID());
+        }
+
+        /**
+         * Detect counted loop "dum (i) [ ... i = i - 1 ]".
+         * 
+         * @return counter variable or zero, if loop has other shape
+         */
+        const zvar* Counter() const {
+            const zvar* counter = dynamic_cast<const zvar*> (this->cond.get());
+            if (counter == 0) {
+                return 0;
+            }
+            const zblock* block = dynamic_cast<const zblock*> (this->trueb.get());
+            if (block != 0) {
+                if ((!block->Items().empty()) && IsDecrement(block->Items().back(), counter)) {
+                    return counter;
+                }
+                return 0;
+            }
+            return IsDecrement(this->trueb, counter) ? counter : 0;
+        }
+
+        /**
+         * Counted loop lowering. Decrement is stored back to counter variable
+         * and "loop" command jumps straight to loop body, while counter is 
+         * not zero. Result is counter register, it holds final counter value
+         * on both exits.
+         */
+        void produce_counted(std::ostream& output, regmap_t* map, int verbose, const zvar* counter) const {
+            this->cond->produce_node(output, map, verbose);
+            uint32_t creg = this->cond->result();
+            output << zhvm::GetRegisterName(zhvm::RP) << " = cmz[" << zhvm::GetRegisterName(creg) << ", @__while_end__" << this->uid << "]" << std::endl;
+            map->Release(creg);
+
+            // Body without trailing decrement, it is folded into back edge
+            output << "!__while_body__" << this->uid << std::endl;
+            zblock body;
+            const zblock* block = dynamic_cast<const zblock*> (this->trueb.get());
+            if (block != 0) {
+                std::list<node_p>::const_iterator last = --block->Items().end();
+                for (std::list<node_p>::const_iterator i = block->Items().begin(); i != last; ++i) {
+                    body.add_item(*i);
+                }
+            }
+            body.produce_node(output, map, verbose);
+
+            char buffer[64];
+            snprintf(buffer, 64, "@%s", counter->VarID().c_str());
+
+            map->AddRef(creg);
+            uint32_t areg = map->GetRegBinOp();
+            output << zhvm::GetRegisterName(areg) << " = add[," << buffer << "]" << std::endl;
+            output << zhvm::GetRegisterName(creg) << " = ldq[" << zhvm::GetRegisterName(areg) << "]" << std::endl;
+            output << zhvm::GetRegisterName(areg) << " = svq[" << zhvm::GetRegisterName(creg) << ", -1]" << std::endl;
+            output << zhvm::GetRegisterName(zhvm::RP) << " = loop[" << zhvm::GetRegisterName(creg) << ", @__while_body__" << this->uid << "]" << std::endl;
+            map->Release(areg);
+            map->MarkRegister(buffer, creg);
+            this->setResult(creg);
+        }
+
+    public:
+
         void produce_node(std::ostream& output, regmap_t* map, int verbose) const {
             output << "!__while_start__" << this->uid << std::endl;
+            const zvar* counter = this->Counter();
+            if (counter != 0) {
+                this->produce_counted(output, map, verbose, counter);
+                output << "!__while_end__" << this->uid << std::endl;
+                output << "nop[]" << std::endl;
+                return;
+            }
             this->cond->produce_node(output, map, verbose);
             output << zhvm::GetRegisterName(zhvm::RP) << " = cmz[" << zhvm::GetRegisterName(this->cond->result()) << ", @__while_end__" << this->uid << "]" << std::endl;
             map->Release(this->cond->result());
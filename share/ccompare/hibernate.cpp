@@ -0,0 +1,58 @@
+/**
+ * Hibernation log size and resume latency of idle VMs.
+ *
+ * Build: g++ -O2 -I../../include hibernate.cpp -L<build>/src/zhvm -lzhvm
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <zhvm.h>
+#include <zhtime.h>
+
+const int COUNT = 1000;
+const size_t CODE_SIZE = 4096;
+const size_t DATA_SIZE = 1 << 20;
+
+int main(int argc, char* argv[]) {
+
+    std::vector<zhvm::memory*> vms;
+    for (int i = 0; i < COUNT; ++i) {
+        zhvm::memory* mem = new zhvm::memory(CODE_SIZE, DATA_SIZE);
+        // Idle VM state: few quads over its data segment
+        for (int k = 0; k < 16; ++k) {
+            mem->SetQuad((rand() % (DATA_SIZE / 8)) * 8, rand());
+        }
+        vms.push_back(mem);
+    }
+
+    zhvm::hibernation_log log("hibernate.log");
+    std::vector<uint64_t> records;
+
+    zhvm::TD_TIME start;
+    zhvm::TD_TIME stop;
+
+    zhvm::zhtime(&start);
+    for (int i = 0; i < COUNT; ++i) {
+        records.push_back(log.Suspend(vms[i]));
+    }
+    zhvm::zhtime(&stop);
+    double suspend = zhvm::time_diff(start, stop);
+
+    zhvm::zhtime(&start);
+    for (int i = 0; i < COUNT; ++i) {
+        log.Resume(records[i], vms[i]);
+    }
+    zhvm::zhtime(&stop);
+    double resume = zhvm::time_diff(start, stop);
+
+    printf("bytes per VM: %llu\n", (unsigned long long) (log.Size() / COUNT));
+    printf("suspend: %.1f us\n", suspend * 1.0e6 / COUNT);
+    printf("resume: %.1f us\n", resume * 1.0e6 / COUNT);
+
+    for (int i = 0; i < COUNT; ++i) {
+        delete vms[i];
+    }
+    remove("hibernate.log");
+    return 0;
+}
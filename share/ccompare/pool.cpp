@@ -0,0 +1,51 @@
+/**
+ * Construct/destroy throughput of short-lived VMs, with and without pool.
+ *
+ * Build: g++ -O2 -I../../include pool.cpp -L<build>/src/zhvm -lzhvm
+ */
+
+#include <cstdio>
+#include <zhvm.h>
+#include <zhtime.h>
+
+const int COUNT = 100000;
+const size_t CODE_SIZE = 4096;
+const size_t DATA_SIZE = 1 << 20;
+
+/**
+ * Request handler: touches few data pages, as typical short VM does.
+ */
+void work(zhvm::memory* mem) {
+    for (size_t offset = 0; offset < 4 * zhvm::ZHVM_PAGE_SIZE; offset += zhvm::ZHVM_PAGE_SIZE) {
+        mem->SetQuad(offset, offset);
+    }
+}
+
+int main(int argc, char* argv[]) {
+
+    zhvm::TD_TIME start;
+    zhvm::TD_TIME stop;
+
+    zhvm::zhtime(&start);
+    for (int i = 0; i < COUNT; ++i) {
+        zhvm::memory* mem = new zhvm::memory(CODE_SIZE, DATA_SIZE);
+        work(mem);
+        delete mem;
+    }
+    zhvm::zhtime(&stop);
+    double plain = zhvm::time_diff(start, stop);
+
+    zhvm::memory_pool pool;
+    zhvm::zhtime(&start);
+    for (int i = 0; i < COUNT; ++i) {
+        zhvm::memory* mem = pool.Acquire(CODE_SIZE, DATA_SIZE);
+        work(mem);
+        pool.Release(mem);
+    }
+    zhvm::zhtime(&stop);
+    double pooled = zhvm::time_diff(start, stop);
+
+    printf("new/delete: %.0f VM/s\n", COUNT / plain);
+    printf("memory_pool: %.0f VM/s\n", COUNT / pooled);
+    return 0;
+}
@@ -53,11 +53,10 @@ int main(int argc, char* argv[]) {
                     counter += 3;
                     break;
                 case BT_PUT:
-                    printf("$c = add[$a]\n");
-                    printf("$a = ldb[$a]\n");
-                    printf("cll[,2]\n");
-                    printf("$a = add[$c]\n");
-                    counter += 4;
+                    // Write cell at $a, output is buffered by host
+                    printf("$b = add[,1]\n");
+                    printf("cll[,4]\n");
+                    counter += 2;
                     break;
                 case BT_GET:
                     printf("$c = add[$a]\n");
@@ -9,12 +9,20 @@ using namespace zhvm;
 const char* inputname = 0;
 const char* outputname = 0;
 size_t memsize = 1024;
+size_t datalimit = 0;
+size_t stacklimit = 0;
+bool compact = false;
+bool aligned = false;
+bool sparse = false;
+bool debug = false;
 
 enum arguments {
     PA_START,
     PA_INPUT,
     PA_OUTPUT,
-    PA_SIZE
+    PA_SIZE,
+    PA_LIMIT,
+    PA_STACK
 };
 
 int parse_args(int argc, char* argv[]) {
@@ -44,6 +52,30 @@ int parse_args(int argc, char* argv[]) {
                             mode = PA_SIZE;
                             ++i;
                             break;
+                        case 'l':
+                            mode = PA_LIMIT;
+                            ++i;
+                            break;
+                        case 't':
+                            mode = PA_STACK;
+                            ++i;
+                            break;
+                        case 'c':
+                            compact = true;
+                            ++i;
+                            break;
+                        case 'a':
+                            aligned = true;
+                            ++i;
+                            break;
+                        case 'z':
+                            sparse = true;
+                            ++i;
+                            break;
+                        case 'g':
+                            debug = true;
+                            ++i;
+                            break;
                         case 'h':
                             return -1;
                         default:
@@ -77,6 +109,20 @@ int parse_args(int argc, char* argv[]) {
                 ++i;
                 break;
             }
+            case PA_LIMIT:
+            {
+                datalimit = strtol(argv[i], 0, 0);
+                mode = PA_START;
+                ++i;
+                break;
+            }
+            case PA_STACK:
+            {
+                stacklimit = strtol(argv[i], 0, 0);
+                mode = PA_START;
+                ++i;
+                break;
+            }
             default:
                 fprintf(stderr, "%s: %s %s\n", "ERROR", "invalid state", argv[i]);
                 return -1;
@@ -101,7 +147,7 @@ int parse_args(int argc, char* argv[]) {
 int main(int argc, char* argv[]) {
 
     if (parse_args(argc, argv) != 0) {
-        fprintf(stdout, "%s: %s %s\n", "Usage", argv[0], "[-i INPUT] [-o OUTPUT] [-s SIZE]");
+        fprintf(stdout, "%s: %s %s\n", "Usage", argv[0], "[-i INPUT] [-o OUTPUT] [-s SIZE] [-l LIMIT] [-t STACK] [-c] [-a] [-z] [-g]");
         return -1;
     }
 
@@ -136,6 +182,8 @@ int main(int argc, char* argv[]) {
 
     memory mem(memsize, memsize);
     cmplv2 cmpl(input, &mem);
+    cmpl.SetCompact(compact);
+    cmpl.SetDebug(debug);
 
     if (cmpl() != TT2_EOF) {
         return -1;
@@ -144,6 +192,15 @@ int main(int argc, char* argv[]) {
     fprintf(stderr, "%s: %#x\n", "CODE SIZE", cmpl.CodeOffset());
     fprintf(stderr, "%s: %#x\n", "DATA SIZE", cmpl.DataOffset());
 
+    if ((datalimit != 0) || (stacklimit != 0)) {
+        mem.SetLimits(datalimit, stacklimit);
+    }
+    if (aligned) {
+        mem.SetImageFlags(mem.ImageFlags() | IF_ALIGNED);
+    }
+    if (sparse) {
+        mem.SetImageFlags(mem.ImageFlags() | IF_SPARSE | IF_PACKED);
+    }
     mem.Dump(*output);
 
     if ((input != stdin) && (input != 0)) {
@@ -10,6 +10,8 @@
 #include <cstring>
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <vector>
 #include <zhvm.h>
 #include <zhtime.h>
 
@@ -19,13 +21,21 @@ const char* inputname = 0;
 bool burst = false;
 bool verbose = true;
 bool debug = false;
+bool verify = true;
+bool hugepages = false;
+const char* filename = 0;
+off_t fileoffset = -1;
 
 enum arguments {
     PA_START,
     PA_INPUT,
     PA_BURST,
     PA_SILENT,
-    PA_DEBUG
+    PA_DEBUG,
+    PA_UNVERIFIED,
+    PA_HUGE,
+    PA_FILE,
+    PA_OFFSET
 };
 
 int parse_args(int argc, char* argv[]) {
@@ -56,6 +66,20 @@ int parse_args(int argc, char* argv[]) {
                         case 'd':
                             mode = PA_DEBUG;
                             break;
+                        case 'u':
+                            mode = PA_UNVERIFIED;
+                            break;
+                        case 't':
+                            mode = PA_HUGE;
+                            break;
+                        case 'f':
+                            mode = PA_FILE;
+                            ++i;
+                            break;
+                        case 'o':
+                            mode = PA_OFFSET;
+                            ++i;
+                            break;
                         case 'h':
                             return -1;
                         default:
@@ -96,6 +120,34 @@ int parse_args(int argc, char* argv[]) {
                 ++i;
                 break;
             }
+            case PA_UNVERIFIED:
+            {
+                verify = false;
+                mode = PA_START;
+                ++i;
+                break;
+            }
+            case PA_HUGE:
+            {
+                hugepages = true;
+                mode = PA_START;
+                ++i;
+                break;
+            }
+            case PA_FILE:
+            {
+                filename = argv[i];
+                mode = PA_START;
+                ++i;
+                break;
+            }
+            case PA_OFFSET:
+            {
+                fileoffset = strtoll(argv[i], 0, 0);
+                mode = PA_START;
+                ++i;
+                break;
+            }
             default:
                 fprintf(stderr, "%s: %s %s\n", "ERROR", "invalid state", argv[i]);
                 return -1;
@@ -107,70 +159,80 @@ int parse_args(int argc, char* argv[]) {
         case PA_INPUT:
             fprintf(stderr, "%s: %s\n", "ERROR", "input filename expected");
             return -1;
+        case PA_FILE:
+            fprintf(stderr, "%s: %s\n", "ERROR", "mapped filename expected");
+            return -1;
+        case PA_OFFSET:
+            fprintf(stderr, "%s: %s\n", "ERROR", "mapped file offset expected");
+            return -1;
     }
     fprintf(stderr, "%s: %s\n", "ERROR", "can't reach here");
     return -1;
 }
 
-int vm_put(zhvm::memory* mem) {
-    std::cout << std::hex << "0x" << mem->Get(zhvm::RA) << std::endl;
-    return zhvm::IR_RUN;
-}
-
-int vm_get(zhvm::memory* mem) {
-    int val = 0;
-    std::cin >> val;
-    mem->Set(zhvm::RA, val);
-    return zhvm::IR_RUN;
-}
-
-int vm_putc(zhvm::memory* mem) {
-    std::cout << (char) mem->Get(zhvm::RA);
-    return zhvm::IR_RUN;
-}
-
-int vm_getc(zhvm::memory* mem) {
-    char chr = 0;
-    std::cin >> chr;
-    mem->Set(zhvm::RA, chr);
-    return zhvm::IR_RUN;
-}
-
 int main(int argc, char* argv[]) {
 
     if (parse_args(argc, argv) != 0) {
-        fprintf(stdout, "%s: %s %s\n", "Usage", argv[0], "[-i INPUT] [-b] [-s]");
+        fprintf(stdout, "%s: %s %s\n", "Usage", argv[0], "[-i INPUT] [-b] [-s] [-d] [-u] [-t] [-f FILE] [-o OFFSET]");
         return -1;
     }
 
-    std::istream* input = 0;
-    std::ifstream inputf;
+    if (hugepages) {
+        segment_options options = segment::Options();
+        options.hugepages = ZHVM_HUGE_PAGE_SIZE;
+        segment::SetOptions(options);
+    }
+
+    memory mem;
 
     if (inputname == 0) {
-        input = &std::cin;
         if (verbose) {
             fprintf(stderr, "%s: %s\n", "USE INPUT", "stdin");
         }
+        mem.Load(std::cin);
     } else {
-        inputf.open(inputname, std::ios_base::in);
+        std::ifstream inputf(inputname, std::ios_base::in | std::ios_base::binary);
         if (!inputf) {
             if (verbose) {
                 fprintf(stderr, "%s: %s %s (%s)\n", "ERROR", "Failed to open file", inputname, strerror(errno));
             }
             return -1;
         }
+        inputf.close();
         if (verbose) {
             fprintf(stderr, "%s: %s\n", "USE INPUT", inputname);
         }
-        input = &inputf;
+        mem.Map(inputname, verify);
     }
 
-    memory mem;
-    mem.Load(*input);
-    mem.SetFuncs(zhvm::CN_PUT, vm_put);
-    mem.SetFuncs(zhvm::CN_GET, vm_get);
-    mem.SetFuncs(zhvm::CN_PUTC, vm_putc);
-    mem.SetFuncs(zhvm::CN_GETC, vm_getc);
+    if (filename != 0) {
+        // File goes to first free page after data by default
+        if (fileoffset < 0) {
+            fileoffset = (mem.DataSize() + ZHVM_PAGE_SIZE - 1) & ~(size_t) (ZHVM_PAGE_SIZE - 1);
+        }
+        try {
+            size_t len = mem.MapFile(filename, fileoffset);
+            if (verbose) {
+                fprintf(stderr, "%s: %s %#llx [%llu]\n", "MAP FILE", filename, (unsigned long long) fileoffset, (unsigned long long) len);
+            }
+        } catch (std::runtime_error& err) {
+            fprintf(stderr, "%s: %s %s (%s)\n", "ERROR", "Failed to map file", filename, err.what());
+            return -1;
+        }
+    }
+
+    // Debug trace shares stdout, so output must not wait in buffer
+    buffered_io io(&std::cout, &std::cin, debug ? 0 : ZHVM_IO_BUFFER_SIZE);
+    io.Install(&mem);
+
+    std::vector<std::string> unbound;
+    mem.Unbound(&unbound);
+    if (!unbound.empty()) {
+        for (auto& name : unbound) {
+            fprintf(stderr, "%s: %s %s\n", "ERROR", "Unknown host function", name.c_str());
+        }
+        return -1;
+    }
 
     TD_TIME start;
     TD_TIME stop;
@@ -179,10 +241,12 @@ int main(int argc, char* argv[]) {
     if (burst) {
         zhtime(&start);
         result = ExecutePrefetch(&mem);
+        io.Flush();
         zhtime(&stop);
     } else {
         zhtime(&start);
         result = Execute(&mem, debug);
+        io.Flush();
         zhtime(&stop);
     }
 
@@ -33,6 +33,7 @@ enum replcmd {
     RC_BURST, ///< Burst program execution from current RP position
     RC_NOLOG, ///< Disable log
     RC_LOG, ///< Enable log
+    RC_FLOAT, ///< Print registers as doubles
     RC_TOTAL ///< Total REPL command count
 };
 
@@ -53,6 +54,7 @@ namespace {
         "  ~burst - burst program execution in vm memory from $p offset",
         "  ~nolog - disable log",
         "  ~log   - enable log",
+        "  ~float - print registers as doubles",
         0
     };
 
@@ -97,7 +99,30 @@ namespace {
         "  cmp [0x1B] D = memcmp(D, S0, S1 + IM)",
         "  zcl [0x1C] CALL ZHVM FUNCTION",
         "  ret [0x1D] RETURN FROM ZHVM FUNCTION",
-        "  not [0x1E] D = !(S0 | (S1 + IM))"
+        "  not [0x1E] D = !(S0 | (S1 + IM))",
+        " vadd [0x1F] mem[D] = mem[D] + mem[S0], S1 elements of IM bytes",
+        " vmul [0x20] mem[D] = mem[D] * mem[S0], S1 elements of IM bytes",
+        " vmin [0x21] mem[D] = min(mem[D], mem[S0]), S1 elements of IM bytes",
+        " vmax [0x22] mem[D] = max(mem[D], mem[S0]), S1 elements of IM bytes",
+        " vsum [0x23] D = sum(mem[S0]), S1 elements of IM bytes",
+        " vdot [0x24] D = dot(mem[D], mem[S0]), S1 elements of IM bytes",
+        " sdbm [0x25] D = sdbm(D, mem[S0], S1 + IM)",
+        "  crc [0x26] D = crc32c(D, mem[S0], S1 + IM)",
+        "  psh [0x27] PUSH REGISTERS {S1 + IM} TO S0 STACK",
+        "  pop [0x28] POP REGISTERS {S1 + IM} FROM S0 STACK",
+        " loop [0x29] S0 = S0 - 1, IF (S0 != 0) D = (S1+IM)",
+        " fadd [0x2A] D = S0 + (S1 + IM) AS DOUBLES",
+        " fsub [0x2B] D = S0 - (S1 + IM) AS DOUBLES",
+        " fmul [0x2C] D = S0 * (S1 + IM) AS DOUBLES",
+        " fdiv [0x2D] D = S0 / (S1 + IM) AS DOUBLES",
+        " fcmp [0x2E] D = -1, 0, 1 COMPARING S0 AND (S1 + IM) AS DOUBLES, 2 IF UNORDERED",
+        " itof [0x2F] D = (double)(S0 + (S1 + IM))",
+        " ftoi [0x30] D = (int64)(S0 + (S1 + IM)) AS DOUBLES",
+        "fsqrt [0x31] D = sqrt(S0 + (S1 + IM)) AS DOUBLES",
+        " pair [0x32] TWO COMPACT COMMANDS IN ONE WORD",
+        "  wcl [0x33] SAVE WINDOW (R0-R8, D + 4), D = S0 + (S1 + IM)",
+        "  wrt [0x34] RESTORE WINDOW, D = SAVED D + S0 + (S1 + IM)",
+        " usr0 [0x35] CUSTOM HOST OPCODE, ALSO usr1-usr9 [0x36-0x3E]",
         "  nop [0x3F] DO NOTHING",
         0
     };
@@ -127,6 +152,7 @@ int GetCMD(const std::string &str) {
         "~burst\n",
         "~nolog\n",
         "~log\n",
+        "~float\n",
         0
     };
 
@@ -351,6 +377,11 @@ int replRound(std::istream& istrm, zhvm::memory* mem) {
         case RC_LOG:
             regprinter = 1;
             return RS_CMD;
+        case RC_FLOAT:
+            for (uint32_t reg = zhvm::RA; reg < zhvm::RTOTAL; ++reg) {
+                std::cout << zhvm::GetRegisterName(reg) << ": " << zhvm::RegToDouble(mem->Get(reg)) << std::endl;
+            }
+            return RS_CMD;
         case RC_TOTAL:
             std::cerr << "UNKNOWN REPL COMMAND: " << input << std::endl;
             return RS_CMD;
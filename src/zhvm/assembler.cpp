@@ -73,38 +73,38 @@ namespace {
         "zcl",
         "ret",
         "not",
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
-        0,
+        "vadd",
+        "vmul",
+        "vmin",
+        "vmax",
+        "vsum",
+        "vdot",
+        "sdbm",
+        "crc",
+        "psh",
+        "pop",
+        "loop",
+        "fadd",
+        "fsub",
+        "fmul",
+        "fdiv",
+        "fcmp",
+        "itof",
+        "ftoi",
+        "fsqrt",
+        "pair",
+        "wcl",
+        "wrt",
+        "usr0",
+        "usr1",
+        "usr2",
+        "usr3",
+        "usr4",
+        "usr5",
+        "usr6",
+        "usr7",
+        "usr8",
+        "usr9",
         "nop"
     };
 
@@ -135,6 +135,34 @@ namespace zhvm {
         return result;
     }
 
+    uint32_t PackCompact(uint32_t opcode, const uint32_t *regs, int32_t imm) {
+        if ((imm != 0) || (regs[CR_DEST] == RP) || (regs[CR_SRC0] == RP) || (regs[CR_SRC1] == RP)) {
+            return ZHVM_COMPACT_NONE;
+        }
+
+        const uint32_t sources[2] = {regs[CR_SRC0], regs[CR_SRC1]};
+        for (uint32_t index = 0; index < ZHVM_COMPACT_TOTAL; ++index) {
+            for (int i = 0; i < 2; ++i) {
+                uint32_t code = index | (regs[CR_DEST] << 5) | (sources[i] << 9);
+
+                uint32_t copcode;
+                uint32_t cregs[CR_TOTAL];
+                int32_t cimm;
+                UnpackCompact(code, &copcode, cregs, &cimm);
+
+                if ((copcode == opcode) && (cregs[CR_DEST] == regs[CR_DEST])
+                        && (cregs[CR_SRC0] == regs[CR_SRC0]) && (cregs[CR_SRC1] == regs[CR_SRC1])) {
+                    return code;
+                }
+            }
+        }
+        return ZHVM_COMPACT_NONE;
+    }
+
+    uint32_t PackPair(uint32_t first, uint32_t second) {
+        return OP_PAIR | (first << 6) | (second << (6 + ZHVM_COMPACT_BITS));
+    }
+
     cchar* Assemble(cchar *cursor, memory* result, int loglevel) {
 
         if (cursor == 0) {
@@ -154,6 +182,38 @@ namespace zhvm {
         return 0;
     }
 
+    int64_t GetRegisterMask(cchar* text) {
+        int64_t result = 0;
+        while (*text != 0) {
+            switch (*text) {
+                case '{':
+                case '}':
+                case ',':
+                case ' ':
+                case '\t':
+                    ++text;
+                    break;
+                case '$':
+                {
+                    ++text;
+                    uint32_t reg = RZ;
+                    while ((reg < RTOTAL) && (regnames[reg][1] != toupper(*text))) {
+                        ++reg;
+                    }
+                    if ((*text == 0) || (reg == RTOTAL)) {
+                        return -1;
+                    }
+                    result |= 1 << reg;
+                    ++text;
+                    break;
+                }
+                default:
+                    return -1;
+            }
+        }
+        return result;
+    }
+
     cchar* GetRegisterName(uint32_t reg) {
         if (reg < RTOTAL) {
             return regnames[reg];
@@ -0,0 +1,107 @@
+#include <cstdio>
+#include <cstring>
+
+#include <zhvm.h>
+
+namespace zhvm {
+
+    buffered_io::buffered_io(std::ostream* out, std::istream* inp, size_t capacity) : out(out), inp(inp), buffer(), capacity(capacity) {
+        this->buffer.reserve(capacity);
+    }
+
+    buffered_io::~buffered_io() {
+        this->Flush();
+    }
+
+    void buffered_io::Install(memory* mem) {
+        mem->SetFuncs(CN_PUT, Put, this);
+        mem->SetFuncs(CN_GET, Get, this);
+        mem->SetFuncs(CN_PUTC, PutChar, this);
+        mem->SetFuncs(CN_GETC, GetChar, this);
+        mem->SetFuncs(CN_WRITE, Write, this);
+        mem->SetFuncs(CN_READ, Read, this);
+        mem->SetFuncs(CN_FLUSH, FlushOutput, this);
+    }
+
+    void buffered_io::Drain() {
+        if (!this->buffer.empty()) {
+            this->out->write(this->buffer.data(), this->buffer.size());
+            this->buffer.clear();
+        }
+    }
+
+    void buffered_io::Flush() {
+        this->Drain();
+        this->out->flush();
+    }
+
+    void buffered_io::Append(const char* data, size_t len) {
+        if (this->buffer.size() + len > this->capacity) {
+            this->Drain();
+            if (len >= this->capacity) {
+                this->out->write(data, len);
+                return;
+            }
+        }
+        this->buffer.insert(this->buffer.end(), data, data + len);
+    }
+
+    int buffered_io::Put(memory* mem, void* io) {
+        char text[24];
+        int len = snprintf(text, sizeof (text), "0x%llx\n", (unsigned long long) mem->Get(RA));
+        ((buffered_io*) io)->Append(text, len);
+        return IR_RUN;
+    }
+
+    int buffered_io::Get(memory* mem, void* io) {
+        buffered_io* self = (buffered_io*) io;
+        self->Flush();
+        int val = 0;
+        *self->inp >> val;
+        mem->Set(RA, val);
+        return IR_RUN;
+    }
+
+    int buffered_io::PutChar(memory* mem, void* io) {
+        buffered_io* self = (buffered_io*) io;
+        const char chr = (char) mem->Get(RA);
+        if (self->buffer.size() < self->capacity) {
+            self->buffer.push_back(chr);
+        } else {
+            self->Append(&chr, 1);
+        }
+        return IR_RUN;
+    }
+
+    int buffered_io::GetChar(memory* mem, void* io) {
+        buffered_io* self = (buffered_io*) io;
+        self->Flush();
+        char chr = 0;
+        *self->inp >> chr;
+        mem->Set(RA, chr);
+        return IR_RUN;
+    }
+
+    int buffered_io::Write(memory* mem, void* io) {
+        const memory* src = mem;
+        span<const char> range = src->View(mem->Get(RA), mem->Get(RB));
+        ((buffered_io*) io)->Append(range.Data(), range.Size());
+        return IR_RUN;
+    }
+
+    int buffered_io::Read(memory* mem, void* io) {
+        buffered_io* self = (buffered_io*) io;
+        self->Flush();
+        span<char> range = mem->View(mem->Get(RA), mem->Get(RB));
+        self->inp->read(range.Data(), range.Size());
+        mem->Set(RB, self->inp->gcount());
+        return IR_RUN;
+    }
+
+    int buffered_io::FlushOutput(memory* mem, void* io) {
+        (void) mem;
+        ((buffered_io*) io)->Flush();
+        return IR_RUN;
+    }
+
+}
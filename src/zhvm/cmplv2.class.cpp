@@ -52,7 +52,7 @@ namespace zhvm {
         }
     }
 
-    cmplv2::cmplv2(const char* input, memory* mem) : labels(), fixes(), code_offset(0), data_offset(0), cur_offset(0), context(0), bs(0), mem(mem), logstate(LL_INFO) {
+    cmplv2::cmplv2(const char* input, memory* mem) : labels(), fixes(), mnemonics(), code_offset(0), data_offset(0), cur_offset(0), context(0), bs(0), mem(mem), logstate(LL_INFO), compact(false), pair_offset(ZHVM_COMPACT_NONE), pair_code(0), debug() {
         if (this->mem == 0) {
             throw std::runtime_error("Invalid memory pointer");
         }
@@ -63,12 +63,14 @@ namespace zhvm {
 
         cmplv2lex_init(&this->context);
         this->bs = cmplv2_scan_string(input, this->context);
+        // Scanned buffer leaves line number unset
+        cmplv2set_lineno(1, this->context);
         this->code_offset = mem->Get(zhvm::RP);
         this->data_offset = mem->Get(zhvm::RD);
         this->cur_offset = &this->code_offset;
     }
 
-    cmplv2::cmplv2(FILE* input, memory* mem) : labels(), fixes(), code_offset(0), data_offset(0), cur_offset(0), context(0), bs(0), mem(mem), logstate(LL_INFO) {
+    cmplv2::cmplv2(FILE* input, memory* mem) : labels(), fixes(), mnemonics(), code_offset(0), data_offset(0), cur_offset(0), context(0), bs(0), mem(mem), logstate(LL_INFO), compact(false), pair_offset(ZHVM_COMPACT_NONE), pair_code(0), debug() {
 
         if (this->mem == 0) {
             throw std::runtime_error("Invalid memory pointer");
@@ -80,6 +82,7 @@ namespace zhvm {
 
         cmplv2lex_init(&this->context);
         cmplv2set_in(input, this->context);
+        cmplv2set_lineno(1, this->context);
         this->code_offset = mem->Get(zhvm::RP);
         this->data_offset = mem->Get(zhvm::RD);
         this->cur_offset = &this->code_offset;
@@ -195,6 +198,8 @@ namespace zhvm {
     enum labeltype {
         LT_CODE,
         LT_DATA,
+        LT_OPCODE,
+        LT_IMPORT,
         LT_LABEL,
     };
 
@@ -205,6 +210,12 @@ namespace zhvm {
         if (strcmp(lb, "data") == 0) {
             return LT_DATA;
         }
+        if (strcmp(lb, "opcode") == 0) {
+            return LT_OPCODE;
+        }
+        if (strcmp(lb, "import") == 0) {
+            return LT_IMPORT;
+        }
         return LT_LABEL;
     }
 
@@ -218,6 +229,40 @@ namespace zhvm {
         return this->logstate;
     }
 
+    bool cmplv2::SetCompact(bool val) {
+        bool result = this->compact;
+        this->compact = val;
+        return result;
+    }
+
+    bool cmplv2::Compact() const {
+        return this->compact;
+    }
+
+    bool cmplv2::SetDebug(bool val) {
+        bool result = (bool) this->debug;
+        if (val && !this->debug) {
+            this->debug = std::make_shared<debug_info>();
+            this->mem->SetDebug(this->debug);
+        } else if (!val && this->debug) {
+            this->debug.reset();
+            this->mem->SetDebug(this->debug);
+        }
+        return result;
+    }
+
+    bool cmplv2::Debug() const {
+        return (bool) this->debug;
+    }
+
+    bool cmplv2::DeclareOpcode(const char* name, uint32_t opcode) {
+        if ((opcode < OP_USR0) || (opcode > OP_USR9) || (GetOpcode(name) != OP_UNKNOWN)) {
+            return false;
+        }
+        this->mnemonics[name] = opcode;
+        return true;
+    }
+
     int cmplv2::macro(std::queue<yydata>* toks) {
         std::queue<yydata>& tks = *toks;
         int state = MS_START;
@@ -232,6 +277,7 @@ namespace zhvm {
                         case TT2_NUMBER_SHORT:
                         case TT2_NUMBER_LONG:
                         case TT2_NUMBER_QUAD:
+                        case TT2_NUMBER_DOUBLE:
                             state = MS_NUMBER;
                             break;
                         case TT2_WORD:
@@ -278,6 +324,7 @@ namespace zhvm {
                             }
                             return TT2_EOF;
                         case TT2_NUMBER_QUAD:
+                        case TT2_NUMBER_DOUBLE:
                             this->mem->SetQuad(this->data_offset, tksfront.tok.num);
                             this->data_offset += sizeof (int64_t);
                             LogMsg(this->LogLevel(), "0x%04x: 0x%016x", this->data_offset - (uint32_t)sizeof (int64_t), tksfront.tok.num);
@@ -314,6 +361,54 @@ namespace zhvm {
                                         return TT2_ERROR;
                                     }
                                     return TT2_EOF;
+                                case LT_OPCODE:
+                                {
+                                    if ((!nextToken(this->context, tks)) || (tks.front().tok.type != TT2_WORD)) {
+                                        ErrorMsg(this->LogLevel(), tks.front().loc, "%s: %s", "FORMAT ERROR", "OPCODE NAME EXPECTED");
+                                        return TT2_ERROR;
+                                    }
+                                    std::string name = tks.front().tok.opr;
+
+                                    if (!nextToken(this->context, tks)) {
+                                        ErrorMsg(this->LogLevel(), tks.front().loc, "%s: %s", "FORMAT ERROR", "unexpected eof");
+                                        return TT2_ERROR;
+                                    }
+
+                                    yydata& code = tks.front();
+                                    if (((code.tok.type != TT2_NUMBER_BYTE) && (code.tok.type != TT2_NUMBER_SHORT))
+                                            || (!this->DeclareOpcode(name.c_str(), code.tok.num))) {
+                                        ErrorMsg(this->LogLevel(), code.loc, "%s: %s %s", "FORMAT ERROR", "CUSTOM OPCODE EXPECTED FOR", name.c_str());
+                                        return TT2_ERROR;
+                                    }
+
+                                    LogMsg(this->LogLevel(), "%s: %s = 0x%02x", "OPCODE", name.c_str(), code.tok.num);
+                                    if (!nextToken(this->context, tks)) {
+                                        ErrorMsg(this->LogLevel(), code.loc, "%s: %s", "FORMAT ERROR", "unexpected eof");
+                                        return TT2_ERROR;
+                                    }
+                                    return TT2_EOF;
+                                }
+                                case LT_IMPORT:
+                                {
+                                    if ((!nextToken(this->context, tks)) || (tks.front().tok.type != TT2_WORD)) {
+                                        ErrorMsg(this->LogLevel(), tks.front().loc, "%s: %s", "FORMAT ERROR", "FUNCTION NAME EXPECTED");
+                                        return TT2_ERROR;
+                                    }
+                                    yydata& func = tks.front();
+                                    if (this->labels.find(func.tok.opr) != this->labels.end()) {
+                                        ErrorMsg(this->LogLevel(), func.loc, "%s: %s %s", "LABEL ERROR", func.tok.opr.c_str(), " is already defined");
+                                        return TT2_ERROR;
+                                    }
+
+                                    uint32_t index = this->mem->Import(func.tok.opr.c_str());
+                                    this->labels[func.tok.opr] = index;
+                                    LogMsg(this->LogLevel(), "%s: %s = 0x%02x", "IMPORT", func.tok.opr.c_str(), index);
+                                    if (!nextToken(this->context, tks)) {
+                                        ErrorMsg(this->LogLevel(), func.loc, "%s: %s", "FORMAT ERROR", "unexpected eof");
+                                        return TT2_ERROR;
+                                    }
+                                    return TT2_EOF;
+                                }
                                 case LT_LABEL:
                                     auto oldlb = this->labels.find(tksfront.tok.opr);
                                     if (oldlb != this->labels.end()) {
@@ -321,6 +416,10 @@ namespace zhvm {
                                         return TT2_ERROR;
                                     }
                                     this->labels[tksfront.tok.opr] = *this->cur_offset;
+                                    this->pair_offset = ZHVM_COMPACT_NONE;
+                                    if (this->debug) {
+                                        this->debug->AddLabel(tksfront.tok.opr, *this->cur_offset, (this->cur_offset == &this->code_offset) ? DS_CODE : DS_DATA);
+                                    }
                                     LogMsg(this->LogLevel(), "%s: 0x%04x", tksfront.tok.opr.c_str(), *this->cur_offset);
                                     if (!nextToken(this->context, tks)) {
                                         ErrorMsg(this->LogLevel(), tksfront.loc, "%s: %s", "FORMAT ERROR", "unexpected eof");
@@ -353,6 +452,7 @@ namespace zhvm {
                         case TT2_NUMBER_SHORT:
                         case TT2_NUMBER_LONG:
                         case TT2_NUMBER_QUAD:
+                        case TT2_NUMBER_DOUBLE:
                         {
                             this->mem->Set(reg, tksfront.tok.num);
                             LogMsg(this->LogLevel(), "%s := 0x%016x", GetRegisterName(reg), tksfront.tok.num);
@@ -406,6 +506,7 @@ namespace zhvm {
         uint32_t opcode = zhvm::OP_HLT;
         int32_t imm = 0;
         int16_t signum = 1;
+        location line = 0;
 
         state.push(CS_START);
         if (!nextToken(this->context, toks)) {
@@ -420,9 +521,11 @@ namespace zhvm {
                 {
                     switch (toks.front().tok.type) {
                         case TT2_REG:
+                            line = toks.front().loc;
                             state.push(CS_DST);
                             break;
                         case TT2_WORD:
+                            line = toks.front().loc;
                             regs[0] = zhvm::RZ;
                             state.push(CS_OPERATOR);
                             break;
@@ -488,6 +591,12 @@ namespace zhvm {
                     switch (toks.front().tok.type) {
                         case TT2_WORD:
                             opcode = zhvm::GetOpcode(toks.front().tok.opr.c_str());
+                            if (opcode == OP_UNKNOWN) {
+                                auto mnemonic = this->mnemonics.find(toks.front().tok.opr);
+                                if (mnemonic != this->mnemonics.end()) {
+                                    opcode = mnemonic->second;
+                                }
+                            }
 
                             if (opcode == OP_UNKNOWN) {
                                 ErrorMsg(this->LogLevel(), toks.front().loc, "%s: %s: %s", "SYNTAX ERROR", "unknown opcode", toks.front().tok.opr.c_str());
@@ -755,11 +864,32 @@ namespace zhvm {
                 }
                 case CS_FINISH:
                 {
-                    uint32_t cmd = zhvm::PackCommand(opcode, regs, imm * signum);
-                    mem->SetCode(this->code_offset, cmd);
-                    this->code_offset += sizeof (uint32_t);
+                    if ((opcode == OP_WCL) || (opcode == OP_WRT)) {
+                        mem->SetImageFlags(mem->ImageFlags() | IF_WINDOWS);
+                    }
 
-                    LogMsg(this->LogLevel(), "0x%04x: 0x%08x", this->code_offset - (uint32_t)sizeof (uint32_t), cmd);
+                    uint32_t code = (this->compact) ? zhvm::PackCompact(opcode, regs, imm * signum) : ZHVM_COMPACT_NONE;
+
+                    if ((code != ZHVM_COMPACT_NONE) && (this->pair_offset != ZHVM_COMPACT_NONE)
+                            && (this->pair_offset + sizeof (uint32_t) == this->code_offset)) {
+                        uint32_t cmd = zhvm::PackPair(this->pair_code, code);
+                        mem->SetCode(this->pair_offset, cmd);
+                        mem->SetImageFlags(mem->ImageFlags() | IF_COMPACT);
+                        this->pair_offset = ZHVM_COMPACT_NONE;
+
+                        LogMsg(this->LogLevel(), "0x%04x: 0x%08x (pair)", this->code_offset - (uint32_t)sizeof (uint32_t), cmd);
+                    } else {
+                        uint32_t cmd = zhvm::PackCommand(opcode, regs, imm * signum);
+                        mem->SetCode(this->code_offset, cmd);
+                        if (this->debug) {
+                            this->debug->AddLine(this->code_offset, line);
+                        }
+                        this->pair_offset = (code != ZHVM_COMPACT_NONE) ? this->code_offset : ZHVM_COMPACT_NONE;
+                        this->pair_code = code;
+                        this->code_offset += sizeof (uint32_t);
+
+                        LogMsg(this->LogLevel(), "0x%04x: 0x%08x", this->code_offset - (uint32_t)sizeof (uint32_t), cmd);
+                    }
 
                     regs[0] = zhvm::RZ;
                     regs[1] = zhvm::RZ;
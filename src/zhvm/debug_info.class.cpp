@@ -0,0 +1,165 @@
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <zhvm.h>
+
+namespace zhvm {
+
+    debug_info::debug_info() : labels(), lines() {
+        ;
+    }
+
+    void debug_info::AddLabel(const std::string& name, uint32_t offset, uint32_t section) {
+        label lb = {offset, section, name};
+        auto pos = std::upper_bound(this->labels.begin(), this->labels.end(), lb, [](const label& a, const label & b) {
+            return (a.section < b.section) || ((a.section == b.section) && (a.offset < b.offset));
+        });
+        this->labels.insert(pos, lb);
+    }
+
+    void debug_info::AddLine(uint32_t offset, uint32_t number) {
+        auto pos = std::lower_bound(this->lines.begin(), this->lines.end(), offset, [](const line& a, uint32_t b) {
+            return a.offset < b;
+        });
+        if ((pos != this->lines.end()) && (pos->offset == offset)) {
+            pos->number = number;
+        } else {
+            line ln = {offset, number};
+            this->lines.insert(pos, ln);
+        }
+    }
+
+    const char* debug_info::Label(uint32_t offset, uint32_t section, uint32_t* delta) const {
+        label key = {offset, section, std::string()};
+        // First label past offset, nearest one is right before it
+        auto pos = std::upper_bound(this->labels.begin(), this->labels.end(), key, [](const label& a, const label & b) {
+            return (a.section < b.section) || ((a.section == b.section) && (a.offset < b.offset));
+        });
+        if ((pos == this->labels.begin()) || ((pos - 1)->section != section)) {
+            return 0;
+        }
+        --pos;
+        if (delta != 0) {
+            *delta = offset - pos->offset;
+        }
+        return pos->name.c_str();
+    }
+
+    uint32_t debug_info::Line(uint32_t offset) const {
+        auto pos = std::upper_bound(this->lines.begin(), this->lines.end(), offset, [](uint32_t a, const line & b) {
+            return a < b.offset;
+        });
+        if (pos == this->lines.begin()) {
+            return 0;
+        }
+        return (pos - 1)->number;
+    }
+
+    std::string debug_info::Symbolize(uint32_t offset) const {
+        char buffer[32] = "";
+        std::string result;
+
+        uint32_t delta = 0;
+        const char* name = this->Label(offset, DS_CODE, &delta);
+        if (name != 0) {
+            result = name;
+            if (delta != 0) {
+                snprintf(buffer, sizeof (buffer), "+%#x", delta);
+                result += buffer;
+            }
+        } else {
+            snprintf(buffer, sizeof (buffer), "%#x", offset);
+            result = buffer;
+        }
+
+        const uint32_t number = this->Line(offset);
+        if (number != 0) {
+            snprintf(buffer, sizeof (buffer), ":%u", number);
+            result += buffer;
+        }
+        return result;
+    }
+
+    static void Append(std::vector<char>* out, uint32_t val) {
+        const char* ptr = (const char*) &val;
+        out->insert(out->end(), ptr, ptr + sizeof (uint32_t));
+    }
+
+    void debug_info::Save(std::vector<char>* out) const {
+        Append(out, (uint32_t) this->lines.size());
+        Append(out, (uint32_t) this->labels.size());
+        for (auto& ln : this->lines) {
+            Append(out, ln.offset);
+            Append(out, ln.number);
+        }
+        for (auto& lb : this->labels) {
+            Append(out, lb.offset);
+            Append(out, lb.section);
+            Append(out, (uint32_t) lb.name.size());
+            out->insert(out->end(), lb.name.begin(), lb.name.end());
+        }
+    }
+
+    /**
+     * Take uint32_t from section
+     */
+    static uint32_t Take(const char* buf, size_t len, size_t* pos) {
+        uint32_t result = 0;
+        if (len - *pos < sizeof (uint32_t)) {
+            std::cerr << "Restore: " << *pos << " of " << len << std::endl;
+            throw std::runtime_error("Image Format Error");
+        }
+        memcpy(&result, buf + *pos, sizeof (uint32_t));
+        *pos += sizeof (uint32_t);
+        return result;
+    }
+
+    void debug_info::Restore(const char* buf, size_t len) {
+        std::vector<line> nlines;
+        std::vector<label> nlabels;
+
+        size_t pos = 0;
+        const uint32_t lcount = Take(buf, len, &pos);
+        const uint32_t bcount = Take(buf, len, &pos);
+        if (lcount > len / (2 * sizeof (uint32_t))) {
+            std::cerr << "Restore: " << lcount << " lines" << std::endl;
+            throw std::runtime_error("Image Format Error");
+        }
+
+        nlines.reserve(lcount);
+        for (uint32_t i = 0; i < lcount; ++i) {
+            line ln;
+            ln.offset = Take(buf, len, &pos);
+            ln.number = Take(buf, len, &pos);
+            if (!nlines.empty() && (nlines.back().offset >= ln.offset)) {
+                std::cerr << "Restore: line at " << ln.offset << " out of order" << std::endl;
+                throw std::runtime_error("Image Format Error");
+            }
+            nlines.push_back(ln);
+        }
+
+        for (uint32_t i = 0; i < bcount; ++i) {
+            label lb;
+            lb.offset = Take(buf, len, &pos);
+            lb.section = Take(buf, len, &pos);
+            const uint32_t nlen = Take(buf, len, &pos);
+            if ((lb.section >= DS_TOTAL) || (nlen > len - pos)) {
+                std::cerr << "Restore: label at " << lb.offset << " [" << lb.section << "]" << std::endl;
+                throw std::runtime_error("Image Format Error");
+            }
+            lb.name.assign(buf + pos, nlen);
+            pos += nlen;
+            nlabels.push_back(lb);
+        }
+
+        this->lines.swap(nlines);
+        this->labels.clear();
+        for (auto& lb : nlabels) {
+            this->AddLabel(lb.name, lb.offset, lb.section);
+        }
+    }
+
+}
@@ -0,0 +1,43 @@
+#include <iostream>
+#include <stdexcept>
+
+#include <zhvm.h>
+
+namespace zhvm {
+
+    hibernation_log::hibernation_log(const char* path) : file(path, std::ios_base::in | std::ios_base::out | std::ios_base::trunc | std::ios_base::binary) {
+        if (!this->file) {
+            std::cerr << "hibernation_log: " << path << std::endl;
+            throw std::runtime_error("Can't create hibernation log");
+        }
+    }
+
+    uint64_t hibernation_log::Suspend(memory* mem) {
+        this->file.clear();
+        this->file.seekp(0, std::ios_base::end);
+        const uint64_t result = (uint64_t) this->file.tellp();
+        mem->Suspend(this->file);
+        this->file.flush();
+        if (!this->file) {
+            throw std::runtime_error("Can't write hibernation log");
+        }
+        return result;
+    }
+
+    void hibernation_log::Resume(uint64_t record, memory* mem) {
+        this->file.clear();
+        this->file.seekg(record);
+        if (!this->file) {
+            std::cerr << "Resume: " << record << std::endl;
+            throw std::runtime_error("Invalid hibernation record");
+        }
+        mem->Resume(this->file);
+    }
+
+    uint64_t hibernation_log::Size() {
+        this->file.clear();
+        this->file.seekp(0, std::ios_base::end);
+        return (uint64_t) this->file.tellp();
+    }
+
+}
@@ -0,0 +1,77 @@
+#include <iostream>
+#include <stdexcept>
+
+#include <zhvm.h>
+
+namespace zhvm {
+
+    host_table::host_table() : funcs(), names(), index() {
+        this->Grow(ZHVM_CFUNC_ARRAY_SIZE - 1);
+    }
+
+    void host_table::Grow(uint32_t index) {
+        if (index >= ZHVM_CFUNC_LIMIT) {
+            std::cerr << "host_table: " << index << std::endl;
+            throw std::runtime_error("Too many host functions");
+        }
+        if (index >= this->funcs.size()) {
+            const host_func empty = {none, 0, 0};
+            this->funcs.resize(index + 1, empty);
+            this->names.resize(index + 1);
+        }
+    }
+
+    void host_table::Set(uint32_t index, const host_func& func) {
+        this->Grow(index);
+        this->funcs[index] = func;
+        if (this->funcs[index].plain == 0) {
+            this->funcs[index].plain = none;
+        }
+    }
+
+    uint32_t host_table::Bind(const std::string& name, const host_func& func) {
+        const uint32_t slot = this->Import(name);
+        this->Set(slot, func);
+        return slot;
+    }
+
+    uint32_t host_table::Import(const std::string& name) {
+        uint32_t slot = 0;
+        if (!this->Find(name, &slot)) {
+            slot = this->Size();
+            if (!this->Import(name, slot)) {
+                std::cerr << "host_table: '" << name << "'" << std::endl;
+                throw std::runtime_error("Invalid host function name");
+            }
+        }
+        return slot;
+    }
+
+    bool host_table::Import(const std::string& name, uint32_t index) {
+        if (name.empty() || (name.size() > ZHVM_CFUNC_NAME_MAX) || (index < ZHVM_CFUNC_ARRAY_SIZE)) {
+            return false;
+        }
+
+        uint32_t slot = 0;
+        if (this->Find(name, &slot)) {
+            return slot == index;
+        }
+        this->Grow(index);
+        if (!this->names[index].empty()) {
+            return false;
+        }
+        this->names[index] = name;
+        this->index[name] = index;
+        return true;
+    }
+
+    bool host_table::Find(const std::string& name, uint32_t* index) const {
+        auto slot = this->index.find(name);
+        if (slot == this->index.end()) {
+            return false;
+        }
+        *index = slot->second;
+        return true;
+    }
+
+}
@@ -4,6 +4,7 @@
  */
 
 #include <cassert>
+#include <cmath>
 #include <zhvm.h>
 #include <string.h>
 #include <iostream>
@@ -22,12 +23,149 @@ namespace zhvm {
         *imm = temp;
     }
 
+    /**
+     * Compact command forms.
+     */
+    enum compact_form {
+        CF_NONE, ///< Unused table entry
+        CF_UNARY, ///< $d = op[$s]
+        CF_BINARY ///< $d = op[$d, $s]
+    };
+
+    /**
+     * Compact table entry.
+     */
+    struct compact_cmd {
+        uint32_t opc;
+        compact_form form;
+    };
+
+    /**
+     * Most frequent commands without immediate value.
+     */
+    const compact_cmd compacts[ZHVM_COMPACT_TOTAL] = {
+        {OP_ADD, CF_UNARY},
+        {OP_LDB, CF_UNARY},
+        {OP_LDS, CF_UNARY},
+        {OP_LDL, CF_UNARY},
+        {OP_LDQ, CF_UNARY},
+        {OP_SVB, CF_UNARY},
+        {OP_SVS, CF_UNARY},
+        {OP_SVL, CF_UNARY},
+        {OP_SVQ, CF_UNARY},
+        {OP_NOT, CF_UNARY},
+        {OP_ADD, CF_BINARY},
+        {OP_SUB, CF_BINARY},
+        {OP_MUL, CF_BINARY},
+        {OP_DIV, CF_BINARY},
+        {OP_MOD, CF_BINARY},
+        {OP_AND, CF_BINARY},
+        {OP_OR, CF_BINARY},
+        {OP_XOR, CF_BINARY},
+        {OP_GR, CF_BINARY},
+        {OP_LS, CF_BINARY},
+        {OP_GRE, CF_BINARY},
+        {OP_LSE, CF_BINARY},
+        {OP_EQ, CF_BINARY},
+        {OP_NEQ, CF_BINARY},
+        {OP_FADD, CF_BINARY},
+        {OP_FSUB, CF_BINARY},
+        {OP_FMUL, CF_BINARY},
+        {OP_FDIV, CF_BINARY},
+        {OP_UNKNOWN, CF_NONE},
+        {OP_UNKNOWN, CF_NONE},
+        {OP_UNKNOWN, CF_NONE},
+        {OP_UNKNOWN, CF_NONE}
+    };
+
+    void UnpackCompact(uint32_t code, uint32_t *opcode, uint32_t *regs, int32_t *imm) {
+        const compact_cmd& item = compacts[code & (ZHVM_COMPACT_TOTAL - 1)];
+        uint32_t dst = (code >> 5) & ((1 << 4) - 1);
+        uint32_t src = (code >> 9) & ((1 << 4) - 1);
+
+        *opcode = item.opc;
+        *imm = 0;
+        regs[CR_DEST] = dst;
+        switch (item.form) {
+            case CF_UNARY:
+                regs[CR_SRC0] = src;
+                regs[CR_SRC1] = RZ;
+                break;
+            case CF_BINARY:
+                regs[CR_SRC0] = dst;
+                regs[CR_SRC1] = src;
+                break;
+            default:
+                regs[CR_SRC0] = RZ;
+                regs[CR_SRC1] = RZ;
+        }
+
+        if ((dst == RP) || (src == RP)) {
+            // Compact commands never touch $p, so pair is never split by jump
+            *opcode = OP_UNKNOWN;
+        }
+    }
+
+    void UnpackPair(uint32_t cmd, uint32_t *first, uint32_t *second) {
+        *first = (cmd >> 6) & ((1 << ZHVM_COMPACT_BITS) - 1);
+        *second = (cmd >> (6 + ZHVM_COMPACT_BITS)) & ((1 << ZHVM_COMPACT_BITS) - 1);
+    }
+
     struct longcmd {
         uint32_t opc;
         uint32_t regs[CR_TOTAL];
         int32_t imm;
+        uint32_t size; ///< Bytes to move $p after command
     };
 
+    double RegToDouble(int64_t val) {
+        double result;
+        memcpy(&result, &val, sizeof (double));
+        return result;
+    }
+
+    int64_t DoubleToReg(double val) {
+        int64_t result;
+        memcpy(&result, &val, sizeof (int64_t));
+        return result;
+    }
+
+    /**
+     * Floating point operand: S1 as double plus integer immediate.
+     */
+    static double FloatOperand(zhvm::memory *mem, const longcmd& icmd) {
+        return RegToDouble(mem->Get(icmd.regs[CR_SRC1])) + icmd.imm;
+    }
+
+    /**
+     * Saturating double to integer conversion. NaN is converted to zero.
+     */
+    static int64_t FloatToInt(double val) {
+        if (val != val) {
+            return 0;
+        }
+        if (val >= 9223372036854775807.0) {
+            return INT64_MAX;
+        }
+        if (val <= -9223372036854775808.0) {
+            return INT64_MIN;
+        }
+        return (int64_t) val;
+    }
+
+    static int64_t FloatCompare(double left, double right) {
+        if (left < right) {
+            return -1;
+        }
+        if (left > right) {
+            return 1;
+        }
+        if (left == right) {
+            return 0;
+        }
+        return 2;
+    }
+
     /**
      * Main interperter function.
      * 
@@ -170,6 +308,93 @@ namespace zhvm {
                 mem->Set(icmd.regs[CR_DEST], !(mem->Get(icmd.regs[CR_SRC0]) | (mem->Get(icmd.regs[CR_SRC1]) + icmd.imm)));
                 break;
             }
+            case OP_VADD:
+                mem->VectorAdd(mem->Get(icmd.regs[CR_DEST]), mem->Get(icmd.regs[CR_SRC0]), mem->Get(icmd.regs[CR_SRC1]), icmd.imm);
+                break;
+            case OP_VMUL:
+                mem->VectorMul(mem->Get(icmd.regs[CR_DEST]), mem->Get(icmd.regs[CR_SRC0]), mem->Get(icmd.regs[CR_SRC1]), icmd.imm);
+                break;
+            case OP_VMIN:
+                mem->VectorMin(mem->Get(icmd.regs[CR_DEST]), mem->Get(icmd.regs[CR_SRC0]), mem->Get(icmd.regs[CR_SRC1]), icmd.imm);
+                break;
+            case OP_VMAX:
+                mem->VectorMax(mem->Get(icmd.regs[CR_DEST]), mem->Get(icmd.regs[CR_SRC0]), mem->Get(icmd.regs[CR_SRC1]), icmd.imm);
+                break;
+            case OP_VSUM:
+                mem->Set(icmd.regs[CR_DEST], mem->VectorSum(mem->Get(icmd.regs[CR_SRC0]), mem->Get(icmd.regs[CR_SRC1]), icmd.imm));
+                break;
+            case OP_VDOT:
+                mem->Set(icmd.regs[CR_DEST], mem->VectorDot(mem->Get(icmd.regs[CR_DEST]), mem->Get(icmd.regs[CR_SRC0]), mem->Get(icmd.regs[CR_SRC1]), icmd.imm));
+                break;
+            case OP_SDBM:
+                mem->Set(icmd.regs[CR_DEST], mem->HashSdbm(mem->Get(icmd.regs[CR_DEST]), mem->Get(icmd.regs[CR_SRC0]), mem->Get(icmd.regs[CR_SRC1]) + icmd.imm));
+                break;
+            case OP_CRC:
+                mem->Set(icmd.regs[CR_DEST], mem->HashCrc32c(mem->Get(icmd.regs[CR_DEST]), mem->Get(icmd.regs[CR_SRC0]), mem->Get(icmd.regs[CR_SRC1]) + icmd.imm));
+                break;
+            case OP_PSH:
+                mem->PushRegs(icmd.regs[CR_SRC0], mem->Get(icmd.regs[CR_SRC1]) + icmd.imm);
+                break;
+            case OP_POP:
+                mem->PopRegs(icmd.regs[CR_SRC0], mem->Get(icmd.regs[CR_SRC1]) + icmd.imm);
+                break;
+            case OP_LOOP:
+            {
+                int64_t counter = mem->Get(icmd.regs[CR_SRC0]) - 1;
+                mem->Set(icmd.regs[CR_SRC0], counter);
+                if (counter != 0) {
+                    mem->Set(icmd.regs[CR_DEST], mem->Get(icmd.regs[CR_SRC1]) + icmd.imm);
+                }
+                break;
+            }
+            case OP_FADD:
+                mem->Set(icmd.regs[CR_DEST], DoubleToReg(RegToDouble(mem->Get(icmd.regs[CR_SRC0])) + FloatOperand(mem, icmd)));
+                break;
+            case OP_FSUB:
+                mem->Set(icmd.regs[CR_DEST], DoubleToReg(RegToDouble(mem->Get(icmd.regs[CR_SRC0])) - FloatOperand(mem, icmd)));
+                break;
+            case OP_FMUL:
+                mem->Set(icmd.regs[CR_DEST], DoubleToReg(RegToDouble(mem->Get(icmd.regs[CR_SRC0])) * FloatOperand(mem, icmd)));
+                break;
+            case OP_FDIV:
+                mem->Set(icmd.regs[CR_DEST], DoubleToReg(RegToDouble(mem->Get(icmd.regs[CR_SRC0])) / FloatOperand(mem, icmd)));
+                break;
+            case OP_FCMP:
+                mem->Set(icmd.regs[CR_DEST], FloatCompare(RegToDouble(mem->Get(icmd.regs[CR_SRC0])), FloatOperand(mem, icmd)));
+                break;
+            case OP_ITOF:
+                mem->Set(icmd.regs[CR_DEST], DoubleToReg((double) (mem->Get(icmd.regs[CR_SRC0]) + (mem->Get(icmd.regs[CR_SRC1]) + icmd.imm))));
+                break;
+            case OP_FTOI:
+                mem->Set(icmd.regs[CR_DEST], FloatToInt(RegToDouble(mem->Get(icmd.regs[CR_SRC0])) + FloatOperand(mem, icmd)));
+                break;
+            case OP_FSQRT:
+                mem->Set(icmd.regs[CR_DEST], DoubleToReg(std::sqrt(RegToDouble(mem->Get(icmd.regs[CR_SRC0])) + FloatOperand(mem, icmd))));
+                break;
+            case OP_WCL:
+            {
+                int64_t target = mem->Get(icmd.regs[CR_SRC0]) + (mem->Get(icmd.regs[CR_SRC1]) + icmd.imm);
+                mem->PushWindow(mem->Get(icmd.regs[CR_DEST]) + sizeof (uint32_t));
+                mem->Set(icmd.regs[CR_DEST], target);
+                break;
+            }
+            case OP_WRT:
+            {
+                int64_t offset = mem->Get(icmd.regs[CR_SRC0]) + (mem->Get(icmd.regs[CR_SRC1]) + icmd.imm);
+                mem->Set(icmd.regs[CR_DEST], mem->PopWindow() + offset);
+                break;
+            }
+            case OP_USR0:
+            case OP_USR1:
+            case OP_USR2:
+            case OP_USR3:
+            case OP_USR4:
+            case OP_USR5:
+            case OP_USR6:
+            case OP_USR7:
+            case OP_USR8:
+            case OP_USR9:
+                return mem->Custom(icmd.opc, icmd.regs[CR_DEST], icmd.regs[CR_SRC0], icmd.regs[CR_SRC1], icmd.imm);
             case OP_NOP:
                 break;
             default:
@@ -186,6 +411,19 @@ namespace zhvm {
         longcmd lcmd;
         UnpackCommand(icmd, &lcmd.opc, lcmd.regs, &lcmd.imm);
 
+        if (lcmd.opc == OP_PAIR) {
+            uint32_t first;
+            uint32_t second;
+            UnpackPair(icmd, &first, &second);
+
+            UnpackCompact(first, &lcmd.opc, lcmd.regs, &lcmd.imm);
+            int result = InterpretCommand(mem, lcmd);
+            if (result != IR_RUN) {
+                return result;
+            }
+            UnpackCompact(second, &lcmd.opc, lcmd.regs, &lcmd.imm);
+        }
+
         return InterpretCommand(mem, lcmd);
     }
 
@@ -212,9 +450,24 @@ namespace zhvm {
         size_t loop = 0;
         while (result == IR_RUN) {
             std::cout << "===" << loop << "===" << std::endl;
+            if (mem->Debug() != 0) {
+                std::cout << "AT: " << mem->Debug()->Symbolize((uint32_t) mem->Get(RP)) << std::endl;
+            }
 
-            uint32_t opcode = ZHVM_OPMASK(mem->GetCode(mem->Get(RP)));
-            std::cout << "CODE: " << GetOpcodeName(opcode) << std::endl;
+            uint32_t cmd = mem->GetCode(mem->Get(RP));
+            uint32_t opcode = ZHVM_OPMASK(cmd);
+            std::cout << "CODE: " << GetOpcodeName(opcode);
+            if (opcode == OP_PAIR) {
+                uint32_t pair[2];
+                UnpackPair(cmd, pair, pair + 1);
+                for (int i = 0; i < 2; ++i) {
+                    uint32_t regs[CR_TOTAL];
+                    int32_t imm;
+                    UnpackCompact(pair[i], &opcode, regs, &imm);
+                    std::cout << " " << ((opcode < OP_TOTAL) ? GetOpcodeName(opcode) : "???");
+                }
+            }
+            std::cout << std::endl;
             result = Step(mem);
             mem->Print(std::cout);
             ++loop;
@@ -250,7 +503,7 @@ namespace zhvm {
             result = InterpretCommand(mem, cache[i]);
             if (result == IR_RUN) {
                 if (mem->TestSetRP() == 0) {
-                    mem->Set(RP, mem->Get(RP) + sizeof (uint32_t));
+                    mem->Set(RP, mem->Get(RP) + cache[i].size);
                 } else {
                     return result;
                 }
@@ -270,7 +523,11 @@ namespace zhvm {
      * 
      * CMZ, CMN commands might or might not write to RP. So, this commands are
      * still prefetched in hope that it wont write. That must improve
-     * performance in some cases.
+     * performance in some cases. LOOP writes RP on every iteration, but last,
+     * so it always ends prefetch.
+     * 
+     * OP_PAIR is expanded to two cached commands. First one does not move RP,
+     * so pair is never split between chunks.
      * 
      * @param mem VM memory
      * @param offset commands offset
@@ -280,11 +537,31 @@ namespace zhvm {
      */
     static size_t FillCache(memory* mem, off_t offset, longcmd* cache, const size_t maxsize) {
         size_t i = 0;
-        for (i = 0; i < maxsize; ++i) {
-            UnpackCommand(mem->GetCode(offset + i * sizeof (uint32_t)), &cache[i].opc, cache[i].regs, &cache[i].imm);
+        while (i < maxsize) {
+            uint32_t cmd = mem->GetCode(offset);
+            if (ZHVM_OPMASK(cmd) == OP_PAIR) {
+                if (i + 2 > maxsize) {
+                    break;
+                }
+                uint32_t first;
+                uint32_t second;
+                UnpackPair(cmd, &first, &second);
+                UnpackCompact(first, &cache[i].opc, cache[i].regs, &cache[i].imm);
+                cache[i].size = 0;
+                UnpackCompact(second, &cache[i + 1].opc, cache[i + 1].regs, &cache[i + 1].imm);
+                cache[i + 1].size = sizeof (uint32_t);
+                offset += sizeof (uint32_t);
+                i += 2;
+                continue;
+            }
+
+            UnpackCommand(cmd, &cache[i].opc, cache[i].regs, &cache[i].imm);
+            cache[i].size = sizeof (uint32_t);
             if (((cache[i].regs[CR_DEST] == RP) && (cache[i].opc != OP_CMZ) && (cache[i].opc != OP_CMN)) || (cache[i].opc == OP_HLT)) {
                 return i + 1;
             }
+            offset += sizeof (uint32_t);
+            ++i;
         }
         return i;
     }
@@ -0,0 +1,190 @@
+/**
+ * @file lz.cpp
+ * @author marko
+ *
+ * Greedy LZ77 compressor with single-entry hash table, and bounds
+ * checked decompressor.
+ */
+
+#include <cstring>
+#include <zhvm.h>
+
+namespace {
+
+    const size_t LZ_MIN_MATCH = 4;
+    const size_t LZ_MAX_OFFSET = 0xFFFF;
+    const uint32_t LZ_HASH_BITS = 12;
+
+    inline uint32_t LzHash(const uint8_t* ptr) {
+        uint32_t seq;
+        memcpy(&seq, ptr, sizeof (uint32_t));
+        return (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+    }
+
+    /**
+     * Write length extension bytes, used when nibble is 15.
+     */
+    inline bool LzLength(uint8_t* out, size_t* op, size_t cap, size_t len) {
+        while (len >= 0xFF) {
+            if (*op >= cap) {
+                return false;
+            }
+            out[(*op)++] = 0xFF;
+            len -= 0xFF;
+        }
+        if (*op >= cap) {
+            return false;
+        }
+        out[(*op)++] = (uint8_t) len;
+        return true;
+    }
+
+    /**
+     * Write sequence: literals and optional match.
+     */
+    bool LzSequence(uint8_t* out, size_t* op, size_t cap, const uint8_t* lit, size_t nlit, size_t offset, size_t mlen) {
+        const size_t mcode = (mlen != 0) ? mlen - LZ_MIN_MATCH : 0;
+
+        if (*op >= cap) {
+            return false;
+        }
+        out[(*op)++] = (uint8_t) (((nlit < 15) ? nlit : 15) << 4 | ((mcode < 15) ? mcode : 15));
+
+        if ((nlit >= 15) && !LzLength(out, op, cap, nlit - 15)) {
+            return false;
+        }
+
+        if (cap - *op < nlit) {
+            return false;
+        }
+        memcpy(out + *op, lit, nlit);
+        *op += nlit;
+
+        if (mlen == 0) {
+            return true;
+        }
+
+        if (cap - *op < 2) {
+            return false;
+        }
+        out[(*op)++] = (uint8_t) (offset & 0xFF);
+        out[(*op)++] = (uint8_t) (offset >> 8);
+
+        if ((mcode >= 15) && !LzLength(out, op, cap, mcode - 15)) {
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Read length extension bytes.
+     */
+    inline bool LzReadLength(const uint8_t* in, size_t* ip, size_t len, size_t* result) {
+        uint8_t byte;
+        do {
+            if (*ip >= len) {
+                return false;
+            }
+            byte = in[(*ip)++];
+            *result += byte;
+        } while (byte == 0xFF);
+        return true;
+    }
+
+}
+
+namespace zhvm {
+
+    size_t LzCompress(const void* src, size_t len, void* dst, size_t cap) {
+        const uint8_t* in = (const uint8_t*) src;
+        uint8_t* out = (uint8_t*) dst;
+
+        // Last position + 1 for each hash, zero if empty
+        uint32_t table[1 << LZ_HASH_BITS];
+        memset(table, 0, sizeof (table));
+
+        size_t op = 0;
+        size_t anchor = 0;
+        size_t pos = 0;
+
+        while (pos + LZ_MIN_MATCH <= len) {
+            const uint32_t hash = LzHash(in + pos);
+            const size_t cand = table[hash];
+            table[hash] = (uint32_t) (pos + 1);
+
+            if ((cand != 0) && (pos - (cand - 1) <= LZ_MAX_OFFSET) && (memcmp(in + cand - 1, in + pos, LZ_MIN_MATCH) == 0)) {
+                const size_t ref = cand - 1;
+                size_t mlen = LZ_MIN_MATCH;
+                while ((pos + mlen < len) && (in[ref + mlen] == in[pos + mlen])) {
+                    ++mlen;
+                }
+
+                if (!LzSequence(out, &op, cap, in + anchor, pos - anchor, pos - ref, mlen)) {
+                    return 0;
+                }
+                pos += mlen;
+                anchor = pos;
+            } else {
+                ++pos;
+            }
+        }
+
+        if (!LzSequence(out, &op, cap, in + anchor, len - anchor, 0, 0)) {
+            return 0;
+        }
+        return op;
+    }
+
+    bool LzDecompress(const void* src, size_t len, void* dst, size_t dlen) {
+        const uint8_t* in = (const uint8_t*) src;
+        uint8_t* out = (uint8_t*) dst;
+
+        size_t ip = 0;
+        size_t op = 0;
+
+        while (ip < len) {
+            const uint8_t token = in[ip++];
+
+            size_t nlit = token >> 4;
+            if ((nlit == 15) && !LzReadLength(in, &ip, len, &nlit)) {
+                return false;
+            }
+            if ((len - ip < nlit) || (dlen - op < nlit)) {
+                return false;
+            }
+            memcpy(out + op, in + ip, nlit);
+            ip += nlit;
+            op += nlit;
+
+            if (ip == len) {
+                // Last sequence has no match
+                break;
+            }
+
+            if (len - ip < 2) {
+                return false;
+            }
+            const size_t offset = in[ip] | (in[ip + 1] << 8);
+            ip += 2;
+
+            size_t mlen = token & 0x0F;
+            if ((mlen == 15) && !LzReadLength(in, &ip, len, &mlen)) {
+                return false;
+            }
+            mlen += LZ_MIN_MATCH;
+
+            if ((offset == 0) || (offset > op) || (dlen - op < mlen)) {
+                return false;
+            }
+
+            // Match may overlap output, copy forward byte by byte
+            const uint8_t* ref = out + op - offset;
+            for (size_t i = 0; i < mlen; ++i) {
+                out[op + i] = ref[i];
+            }
+            op += mlen;
+        }
+        return op == dlen;
+    }
+
+}
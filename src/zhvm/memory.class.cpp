@@ -2,168 +2,373 @@
 #include <fstream>
 #include <iostream>
 #include <cstring>
+#include <cstddef>
 
 #include <zhvm.h>
 #include <string.h>
 
+#ifndef WIN32
+#define ZHVM_IMAGE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define ZHVM_CRC32C_SSE42
+#include <nmmintrin.h>
+#endif
+
 namespace zhvm {
 
     int none(memory* mem) {
         return IR_HALT;
     }
 
-    memory::memory() : regs(), sflag(0), cdata(0), csize(0), ddata(0), dsize(0), funcs() {
+    int nocop(memory* mem, uint32_t dst, uint32_t src0, uint32_t src1, int32_t imm) {
+        return IR_OP_UNKNWN;
+    }
+
+    memory::memory() : regs(), sflag(0), iflags(0), code(), cfixed(false), cdata(0), csize(0), data(), ddata(0), dsize(0), dlimit(0), stack(), ssize(0), funcs(), fdata(0), fcount(0), cops(), wbanks(), whead(0), wcount(0), wspill(), chkid(0), cchanged(false), debug() {
         this->NewImage(1024, 1024);
     }
 
-    memory::memory(size_t codesize, size_t datasize) : regs(), sflag(0), cdata(0), csize(0), ddata(0), dsize(0), funcs() {
+    memory::memory(size_t codesize, size_t datasize) : regs(), sflag(0), iflags(0), code(), cfixed(false), cdata(0), csize(0), data(), ddata(0), dsize(0), dlimit(0), stack(), ssize(0), funcs(), fdata(0), fcount(0), cops(), wbanks(), whead(0), wcount(0), wspill(), chkid(0), cchanged(false), debug() {
         this->NewImage(codesize, datasize);
     }
 
-    memory::memory(const memory& copy) : regs(), sflag(copy.sflag), cdata(0), csize(0), ddata(0), dsize(0), funcs() {
-        this->cdata = new char[copy.csize];
-        this->csize = copy.csize;
-        memcpy(this->cdata, copy.cdata, this->csize);
-
-
-        this->ddata = new char[copy.dsize];
-        this->dsize = copy.dsize;
-        memcpy(this->ddata, copy.ddata, this->dsize);
+    memory::memory(const memory& copy) : regs(), sflag(copy.sflag), iflags(copy.iflags), code(copy.code), cfixed(copy.cfixed), cdata(copy.cdata), csize(copy.csize), data(copy.data, 0, copy.dsize), ddata(0), dsize(copy.dsize), dlimit(copy.dlimit), stack(copy.stack, copy.stack.Size() - copy.ssize, copy.ssize), ssize(copy.ssize), funcs(copy.funcs), fdata(copy.fdata), fcount(copy.fcount), cops(), wbanks(), whead(0), wcount(0), wspill(), chkid(0), cchanged(false), debug(copy.debug) {
+        this->ddata = this->data.Data();
 
         for (int i = RZ; i < RTOTAL; ++i) {
             this->regs[i] = copy.regs[i];
         }
 
-        for (uint32_t i = 0; i < ZHVM_CFUNC_ARRAY_SIZE; ++i) {
-            this->funcs[i] = copy.funcs[i];
+        for (uint32_t i = 0; i < ZHVM_CUSTOM_TOTAL; ++i) {
+            this->cops[i] = copy.cops[i];
         }
 
+        memcpy(this->wbanks, copy.wbanks, sizeof (this->wbanks));
+        this->whead = copy.whead;
+        this->wcount = copy.wcount;
+        this->wspill = copy.wspill;
+        this->chkid = copy.chkid;
+        this->cchanged = copy.cchanged;
+
     }
 
     memory& memory::operator=(const memory& src) {
         if (this != &src) {
-            delete[] this->cdata;
-
-            this->cdata = new char[src.csize];
+            this->code = src.code;
+            this->cfixed = src.cfixed;
+            this->cdata = src.cdata;
             this->csize = src.csize;
-            memcpy(this->cdata, src.cdata, this->csize);
-
-            delete[] this->ddata;
 
-            this->ddata = new char[src.dsize];
+            this->data = segment(src.data, 0, src.dsize);
+            this->ddata = this->data.Data();
             this->dsize = src.dsize;
-            memcpy(this->ddata, src.ddata, this->dsize);
+            this->dlimit = src.dlimit;
+            this->stack = segment(src.stack, src.stack.Size() - src.ssize, src.ssize);
+            this->ssize = src.ssize;
 
             for (int i = RZ; i < RTOTAL; ++i) {
                 this->regs[i] = src.regs[i];
             }
-            for (uint32_t i = 0; i < ZHVM_CFUNC_ARRAY_SIZE; ++i) {
-                this->funcs[i] = src.funcs[i];
+            this->SetTable(src.funcs);
+            for (uint32_t i = 0; i < ZHVM_CUSTOM_TOTAL; ++i) {
+                this->cops[i] = src.cops[i];
             }
             this->sflag = src.sflag;
+            this->iflags = src.iflags;
+
+            memcpy(this->wbanks, src.wbanks, sizeof (this->wbanks));
+            this->whead = src.whead;
+            this->wcount = src.wcount;
+            this->wspill = src.wspill;
+            this->chkid = src.chkid;
+            this->cchanged = src.cchanged;
+            this->debug = src.debug;
         }
         return *this;
     }
 
     memory& memory::operator=(memory&& src) {
         if (this != &src) {
-            delete[] this->cdata;
-
+            this->code = std::move(src.code);
+            this->cfixed = src.cfixed;
             this->cdata = src.cdata;
             this->csize = src.csize;
 
-            delete[] this->ddata;
-
+            this->data = std::move(src.data);
             this->ddata = src.ddata;
             this->dsize = src.dsize;
+            this->dlimit = src.dlimit;
+            this->stack = std::move(src.stack);
+            this->ssize = src.ssize;
 
             for (int i = RZ; i < RTOTAL; ++i) {
                 this->regs[i] = src.regs[i];
             }
-            for (uint32_t i = 0; i < ZHVM_CFUNC_ARRAY_SIZE; ++i) {
-                this->funcs[i] = src.funcs[i];
+            this->SetTable(src.funcs);
+            for (uint32_t i = 0; i < ZHVM_CUSTOM_TOTAL; ++i) {
+                this->cops[i] = src.cops[i];
             }
             this->sflag = src.sflag;
+            this->iflags = src.iflags;
+
+            memcpy(this->wbanks, src.wbanks, sizeof (this->wbanks));
+            this->whead = src.whead;
+            this->wcount = src.wcount;
+            this->wspill = std::move(src.wspill);
+            this->chkid = src.chkid;
+            this->cchanged = src.cchanged;
+            this->debug = std::move(src.debug);
 
             src.cdata = 0;
             src.csize = 0;
 
             src.ddata = 0;
             src.dsize = 0;
+            src.dlimit = 0;
+            src.ssize = 0;
         }
         return *this;
     }
 
-    memory::memory(memory&& mv) : regs(), sflag(mv.sflag), cdata(mv.cdata), csize(mv.csize), ddata(mv.ddata), dsize(mv.dsize), funcs() {
+    memory::memory(memory&& mv) : regs(), sflag(mv.sflag), iflags(mv.iflags), code(std::move(mv.code)), cfixed(mv.cfixed), cdata(mv.cdata), csize(mv.csize), data(std::move(mv.data)), ddata(mv.ddata), dsize(mv.dsize), dlimit(mv.dlimit), stack(std::move(mv.stack)), ssize(mv.ssize), funcs(mv.funcs), fdata(mv.fdata), fcount(mv.fcount), cops(), wbanks(), whead(mv.whead), wcount(mv.wcount), wspill(std::move(mv.wspill)), chkid(mv.chkid), cchanged(mv.cchanged), debug(std::move(mv.debug)) {
+        memcpy(this->wbanks, mv.wbanks, sizeof (this->wbanks));
         for (int i = RZ; i < RTOTAL; ++i) {
             this->regs[i] = mv.regs[i];
         }
-        for (uint32_t i = 0; i < ZHVM_CFUNC_ARRAY_SIZE; ++i) {
-            this->funcs[i] = mv.funcs[i];
+        for (uint32_t i = 0; i < ZHVM_CUSTOM_TOTAL; ++i) {
+            this->cops[i] = mv.cops[i];
         }
         mv.cdata = 0;
         mv.csize = 0;
 
         mv.ddata = 0;
         mv.dsize = 0;
+        mv.dlimit = 0;
+        mv.ssize = 0;
+    }
+
+    void memory::Fork(memory* child) {
+        if (child == this) {
+            return;
+        }
+
+        this->data.Fork(&child->data);
+        child->ddata = child->data.Data();
+        child->dsize = this->dsize;
+        child->dlimit = this->dlimit;
+        this->stack.Fork(&child->stack);
+        child->ssize = this->ssize;
+
+        child->code = this->code;
+        child->cfixed = this->cfixed;
+        child->cdata = this->cdata;
+        child->csize = this->csize;
+
+        for (int i = RZ; i < RTOTAL; ++i) {
+            child->regs[i] = this->regs[i];
+        }
+        child->SetTable(this->funcs);
+        for (uint32_t i = 0; i < ZHVM_CUSTOM_TOTAL; ++i) {
+            child->cops[i] = this->cops[i];
+        }
+        child->sflag = this->sflag;
+        child->iflags = this->iflags;
+
+        memcpy(child->wbanks, this->wbanks, sizeof (this->wbanks));
+        child->whead = this->whead;
+        child->wcount = this->wcount;
+        child->wspill = this->wspill;
+        child->chkid = this->chkid;
+        child->cchanged = this->cchanged;
+        child->debug = this->debug;
     }
 
     memory::~memory() {
-        delete[] this->cdata;
-        delete[] this->ddata;
+        ;
     }
 
     memory& memory::SetCode(off_t offset, uint32_t val) {
         if (offset + sizeof (uint32_t) < this->csize) {
+            if (this->cfixed || (this->code.use_count() > 1)) {
+                this->UnshareCode();
+            }
             *(uint32_t*) (this->cdata + offset) = (uint32_t) val;
+            this->cchanged = true;
             return *this;
         }
         std::cerr << "SetCode: " << std::hex << offset << " = " << std::dec << val << std::endl;
         throw std::runtime_error("Code Access Violation (SetCode)");
     }
 
+    void memory::UnshareCode() {
+        const size_t size = this->csize;
+        std::shared_ptr<char> own(segment::Reserve(size), [size](char* ptr) {
+            segment::Unreserve(ptr, size);
+        });
+        memcpy(own.get(), this->cdata, this->csize);
+        this->code = std::move(own);
+        this->cfixed = false;
+        this->cdata = this->code.get();
+    }
+
+    bool memory::SharesCode(const memory& other) const {
+        return this->cdata == other.cdata;
+    }
+
+    /**
+     * Check that len bytes at offset fits into memory segment.
+     */
+    static bool DataRange(off_t offset, size_t len, size_t size) {
+        return (offset >= 0) && (len <= size) && ((size_t) offset <= size - len);
+    }
+
+    const char* memory::Fetch(off_t offset, size_t len) const {
+        if (offset >= 0) {
+            // Data segment is zero past its size, up to limit
+            return DataRange(offset, len, this->dlimit) ? this->ddata + offset : 0;
+        }
+        const size_t depth = (size_t) -(int64_t) offset;
+        if ((depth <= this->stack.Size()) && (len <= depth)) {
+            return this->stack.Data() + this->stack.Size() - depth;
+        }
+        return 0;
+    }
+
+    char* memory::Store(off_t offset, size_t len) {
+        char* result = (char*) this->Fetch(offset, len);
+        if (result == 0) {
+            return 0;
+        }
+        if (offset >= 0) {
+            if ((size_t) offset + len > this->dsize) {
+                const size_t end = ((size_t) offset + len + ZHVM_PAGE_SIZE - 1) & ~(size_t) (ZHVM_PAGE_SIZE - 1);
+                this->dsize = std::min(end, this->dlimit);
+            }
+            this->data.Touch(offset, len);
+        } else {
+            const size_t depth = (size_t) -(int64_t) offset;
+            if (depth > this->ssize) {
+                const size_t end = (depth + ZHVM_PAGE_SIZE - 1) & ~(size_t) (ZHVM_PAGE_SIZE - 1);
+                this->ssize = std::min(end, this->stack.Size());
+            }
+            this->stack.Touch(this->stack.Size() - depth, len);
+        }
+        return result;
+    }
+
     memory& memory::SetByte(off_t offset, int64_t val) {
-        if (offset + sizeof (int8_t) < this->dsize) {
+        if (DataRange(offset, sizeof (int8_t), this->dsize)) {
+            this->data.Touch(offset, sizeof (int8_t));
             *(int8_t*) (this->ddata + offset) = (int8_t) val;
             return *this;
         }
+        char* ptr = this->Store(offset, sizeof (int8_t));
+        if (ptr != 0) {
+            *(int8_t*) ptr = (int8_t) val;
+            return *this;
+        }
         std::cerr << "SetByte: " << std::hex << offset << " = " << std::dec << val << std::endl;
         throw std::runtime_error("Data Access Violation (SetByte)");
     }
 
     memory& memory::SetShort(off_t offset, int64_t val) {
-        if (offset + sizeof (int16_t) < this->dsize) {
+        if (DataRange(offset, sizeof (int16_t), this->dsize)) {
+            this->data.Touch(offset, sizeof (int16_t));
             *(int16_t*) (this->ddata + offset) = (int16_t) val;
             return *this;
         }
+        char* ptr = this->Store(offset, sizeof (int16_t));
+        if (ptr != 0) {
+            *(int16_t*) ptr = (int16_t) val;
+            return *this;
+        }
         std::cerr << "SetShort: " << std::hex << offset << " = " << std::dec << val << std::endl;
         throw std::runtime_error("Data Access Violation (SetShort)");
     }
 
     memory& memory::SetLong(off_t offset, int64_t val) {
-        if (offset + sizeof (int32_t) < this->dsize) {
+        if (DataRange(offset, sizeof (int32_t), this->dsize)) {
+            this->data.Touch(offset, sizeof (int32_t));
             *(int32_t*) (this->ddata + offset) = (int32_t) val;
             return *this;
         }
+        char* ptr = this->Store(offset, sizeof (int32_t));
+        if (ptr != 0) {
+            *(int32_t*) ptr = (int32_t) val;
+            return *this;
+        }
         std::cerr << "SetLong: " << std::hex << offset << " = " << std::dec << val << std::endl;
         throw std::runtime_error("Data Access Violation (SetLong)");
     }
 
     memory& memory::SetQuad(off_t offset, int64_t val) {
-        if (offset + sizeof (int64_t) < this->dsize) {
+        if (DataRange(offset, sizeof (int64_t), this->dsize)) {
+            this->data.Touch(offset, sizeof (int64_t));
             *(int64_t*) (this->ddata + offset) = val;
             return *this;
         }
+        char* ptr = this->Store(offset, sizeof (int64_t));
+        if (ptr != 0) {
+            *(int64_t*) ptr = val;
+            return *this;
+        }
         std::cerr << "SetQuad: " << std::hex << offset << " = " << std::dec << val << std::endl;
         throw std::runtime_error("Data Access Violation (SetQuad)");
     }
 
     memory & memory::Copy(off_t dest, off_t src, size_t len) {
-        len = std::min<size_t>(len, this->dsize - dest);
-        len = std::min<size_t>(len, this->dsize - src);
+        const char* from = this->Fetch(src, len);
+        char* to = (from != 0) ? this->Store(dest, len) : 0;
+        if (to != 0) {
+            memmove(to, from, len);
+            return *this;
+        }
+        std::cerr << "Copy: " << std::hex << dest << " <- " << src << " [" << len << "]" << std::endl;
+        throw std::runtime_error("Data Access Violation (Copy)");
+    }
 
-        memmove(this->ddata + dest, this->ddata + src, len);
-        return *this;
+    memory& memory::Write(off_t dest, const void* src, size_t len) {
+        char* to = this->Store(dest, len);
+        if (to != 0) {
+            memcpy(to, src, len);
+            return *this;
+        }
+        std::cerr << "Write: " << std::hex << dest << std::dec << " [" << len << "]" << std::endl;
+        throw std::runtime_error("Data Access Violation (Write)");
+    }
+
+    void memory::Read(void* dest, off_t src, size_t len) const {
+        const char* from = this->Fetch(src, len);
+        if (from != 0) {
+            memcpy(dest, from, len);
+            return;
+        }
+        std::cerr << "Read: " << std::hex << src << std::dec << " [" << len << "]" << std::endl;
+        throw std::runtime_error("Data Access Violation (Read)");
+    }
+
+    span<char> memory::View(off_t offset, size_t len) {
+        char* ptr = this->Store(offset, len);
+        if (ptr != 0) {
+            return span<char>(ptr, len);
+        }
+        std::cerr << "View: " << std::hex << offset << std::dec << " [" << len << "]" << std::endl;
+        throw std::runtime_error("Data Access Violation (View)");
+    }
+
+    span<const char> memory::View(off_t offset, size_t len) const {
+        const char* ptr = this->Fetch(offset, len);
+        if (ptr != 0) {
+            return span<const char>(ptr, len);
+        }
+        std::cerr << "View: " << std::hex << offset << std::dec << " [" << len << "]" << std::endl;
+        throw std::runtime_error("Data Access Violation (View)");
     }
 
     int32_t memory::Compare(off_t src0, off_t src1, size_t len) {
@@ -173,34 +378,242 @@ namespace zhvm {
         return memcmp(this->ddata + src0, this->ddata + src1, len);
     }
 
+    /**
+     * Check that vector of count elements has valid byte length.
+     */
+    static bool VectorLength(size_t count, size_t width) {
+        return VecWidth(width) && (count <= SIZE_MAX / width);
+    }
+
+    memory& memory::VectorAdd(off_t dest, off_t src, size_t count, size_t width) {
+        const char* from = VectorLength(count, width) ? this->Fetch(src, count * width) : 0;
+        char* to = (from != 0) ? this->Store(dest, count * width) : 0;
+        if (to != 0) {
+            VecAdd(to, from, count, width);
+            return *this;
+        }
+        std::cerr << "VectorAdd: " << std::hex << dest << ", " << src << std::dec << " [" << count << "x" << width << "]" << std::endl;
+        throw std::runtime_error("Data Access Violation (VectorAdd)");
+    }
+
+    memory& memory::VectorMul(off_t dest, off_t src, size_t count, size_t width) {
+        const char* from = VectorLength(count, width) ? this->Fetch(src, count * width) : 0;
+        char* to = (from != 0) ? this->Store(dest, count * width) : 0;
+        if (to != 0) {
+            VecMul(to, from, count, width);
+            return *this;
+        }
+        std::cerr << "VectorMul: " << std::hex << dest << ", " << src << std::dec << " [" << count << "x" << width << "]" << std::endl;
+        throw std::runtime_error("Data Access Violation (VectorMul)");
+    }
+
+    memory& memory::VectorMin(off_t dest, off_t src, size_t count, size_t width) {
+        const char* from = VectorLength(count, width) ? this->Fetch(src, count * width) : 0;
+        char* to = (from != 0) ? this->Store(dest, count * width) : 0;
+        if (to != 0) {
+            VecMin(to, from, count, width);
+            return *this;
+        }
+        std::cerr << "VectorMin: " << std::hex << dest << ", " << src << std::dec << " [" << count << "x" << width << "]" << std::endl;
+        throw std::runtime_error("Data Access Violation (VectorMin)");
+    }
+
+    memory& memory::VectorMax(off_t dest, off_t src, size_t count, size_t width) {
+        const char* from = VectorLength(count, width) ? this->Fetch(src, count * width) : 0;
+        char* to = (from != 0) ? this->Store(dest, count * width) : 0;
+        if (to != 0) {
+            VecMax(to, from, count, width);
+            return *this;
+        }
+        std::cerr << "VectorMax: " << std::hex << dest << ", " << src << std::dec << " [" << count << "x" << width << "]" << std::endl;
+        throw std::runtime_error("Data Access Violation (VectorMax)");
+    }
+
+    int64_t memory::VectorSum(off_t src, size_t count, size_t width) const {
+        const char* from = VectorLength(count, width) ? this->Fetch(src, count * width) : 0;
+        if (from != 0) {
+            return VecSum(from, count, width);
+        }
+        std::cerr << "VectorSum: " << std::hex << src << std::dec << " [" << count << "x" << width << "]" << std::endl;
+        throw std::runtime_error("Data Access Violation (VectorSum)");
+    }
+
+    int64_t memory::VectorDot(off_t src0, off_t src1, size_t count, size_t width) const {
+        const char* first = VectorLength(count, width) ? this->Fetch(src0, count * width) : 0;
+        const char* second = (first != 0) ? this->Fetch(src1, count * width) : 0;
+        if (second != 0) {
+            return VecDot(first, second, count, width);
+        }
+        std::cerr << "VectorDot: " << std::hex << src0 << ", " << src1 << std::dec << " [" << count << "x" << width << "]" << std::endl;
+        throw std::runtime_error("Data Access Violation (VectorDot)");
+    }
+
+    /**
+     * Registers selected by push/pop mask.
+     */
+    static uint32_t StackMask(uint32_t sreg, uint32_t mask) {
+        return mask & ((1 << RTOTAL) - 1) & ~((1 << RZ) | (1 << sreg));
+    }
+
+    /**
+     * Number of registers selected by mask.
+     */
+    static size_t StackCount(uint32_t mask) {
+        size_t result = 0;
+        for (; mask != 0; mask &= mask - 1) {
+            ++result;
+        }
+        return result;
+    }
+
+    memory& memory::PushRegs(uint32_t sreg, uint32_t mask) {
+        mask = StackMask(sreg, mask);
+        size_t len = StackCount(mask) * sizeof (reg_t);
+        int64_t top = this->Get(sreg) - (int64_t) len;
+        char* cursor = this->Store(top, len);
+        if (cursor != 0) {
+            for (uint32_t i = RA; i < RTOTAL; ++i) {
+                if (mask & (1 << i)) {
+                    *(int64_t*) cursor = this->regs[i];
+                    cursor += sizeof (reg_t);
+                }
+            }
+            this->Set(sreg, top);
+            return *this;
+        }
+        std::cerr << "PushRegs: " << std::hex << top << " [" << mask << "]" << std::endl;
+        throw std::runtime_error("Data Access Violation (PushRegs)");
+    }
+
+    memory& memory::PopRegs(uint32_t sreg, uint32_t mask) {
+        mask = StackMask(sreg, mask);
+        size_t len = StackCount(mask) * sizeof (reg_t);
+        int64_t top = this->Get(sreg);
+        const char* cursor = this->Fetch(top, len);
+        if (cursor != 0) {
+            for (uint32_t i = RA; i < RTOTAL; ++i) {
+                if (mask & (1 << i)) {
+                    this->Set(i, *(const int64_t*) cursor);
+                    cursor += sizeof (reg_t);
+                }
+            }
+            this->Set(sreg, top + len);
+            return *this;
+        }
+        std::cerr << "PopRegs: " << std::hex << top << " [" << mask << "]" << std::endl;
+        throw std::runtime_error("Data Access Violation (PopRegs)");
+    }
+
+    memory& memory::PushWindow(int64_t ret) {
+        if (this->wcount == ZHVM_WINDOW_BANKS) {
+            if (this->wspill.size() >= ZHVM_WINDOW_SPILL_MAX * ZHVM_WINDOW_SIZE) {
+                std::cerr << "PushWindow: " << this->WindowDepth() << " windows open" << std::endl;
+                throw std::runtime_error("Register Window Overflow");
+            }
+            const reg_t* oldest = this->wbanks + ((this->whead + ZHVM_WINDOW_BANKS - this->wcount) % ZHVM_WINDOW_BANKS) * ZHVM_WINDOW_SIZE;
+            this->wspill.insert(this->wspill.end(), oldest, oldest + ZHVM_WINDOW_SIZE);
+            --this->wcount;
+        }
+
+        reg_t* bank = this->wbanks + this->whead * ZHVM_WINDOW_SIZE;
+        memcpy(bank, this->regs + R0, (ZHVM_WINDOW_SIZE - 1) * sizeof (reg_t));
+        bank[ZHVM_WINDOW_SIZE - 1] = ret;
+        memset(this->regs + R0, 0, (ZHVM_WINDOW_SIZE - 1) * sizeof (reg_t));
+
+        this->whead = (this->whead + 1) % ZHVM_WINDOW_BANKS;
+        ++this->wcount;
+        return *this;
+    }
+
+    int64_t memory::PopWindow() {
+        const size_t spilled = this->wspill.size();
+        if (this->wcount > 0) {
+            this->whead = (this->whead + ZHVM_WINDOW_BANKS - 1) % ZHVM_WINDOW_BANKS;
+            --this->wcount;
+
+            const reg_t* bank = this->wbanks + this->whead * ZHVM_WINDOW_SIZE;
+            memcpy(this->regs + R0, bank, (ZHVM_WINDOW_SIZE - 1) * sizeof (reg_t));
+            return bank[ZHVM_WINDOW_SIZE - 1];
+        }
+
+        if (spilled >= ZHVM_WINDOW_SIZE) {
+            const reg_t* bank = &this->wspill[spilled - ZHVM_WINDOW_SIZE];
+            memcpy(this->regs + R0, bank, (ZHVM_WINDOW_SIZE - 1) * sizeof (reg_t));
+            int64_t ret = bank[ZHVM_WINDOW_SIZE - 1];
+            this->wspill.resize(spilled - ZHVM_WINDOW_SIZE);
+            return ret;
+        }
+
+        std::cerr << "PopWindow: no open window" << std::endl;
+        throw std::runtime_error("Register Window Underflow");
+    }
+
+    size_t memory::WindowDepth() const {
+        return this->wcount + this->wspill.size() / ZHVM_WINDOW_SIZE;
+    }
+
+    uint32_t memory::HashSdbm(uint32_t hash, off_t src, size_t len) const {
+        const char* from = this->Fetch(src, len);
+        if (from != 0) {
+            return sdbm(hash, from, len);
+        }
+        std::cerr << "HashSdbm: " << std::hex << src << std::dec << " [" << len << "]" << std::endl;
+        throw std::runtime_error("Data Access Violation (HashSdbm)");
+    }
+
+    uint32_t memory::HashCrc32c(uint32_t crc, off_t src, size_t len) const {
+        const char* from = this->Fetch(src, len);
+        if (from != 0) {
+            return crc32c(crc, from, len);
+        }
+        std::cerr << "HashCrc32c: " << std::hex << src << std::dec << " [" << len << "]" << std::endl;
+        throw std::runtime_error("Data Access Violation (HashCrc32c)");
+    }
+
     int8_t memory::GetByte(off_t offset) const {
-        if (offset + sizeof (int8_t) < this->dsize) {
+        if (DataRange(offset, sizeof (int8_t), this->dsize)) {
             return *(int8_t*) (this->ddata + offset);
         }
+        const char* ptr = this->Fetch(offset, sizeof (int8_t));
+        if (ptr != 0) {
+            return *(const int8_t*) ptr;
+        }
         std::cerr << "GetByte: " << std::hex << offset << std::endl;
         throw std::runtime_error("Data Access Violation  (GetByte)");
     }
 
     int16_t memory::GetShort(off_t offset) const {
-        if (offset + sizeof (int16_t) < this->dsize) {
+        if (DataRange(offset, sizeof (int16_t), this->dsize)) {
             return *(int16_t*) (this->ddata + offset);
         }
+        const char* ptr = this->Fetch(offset, sizeof (int16_t));
+        if (ptr != 0) {
+            return *(const int16_t*) ptr;
+        }
         std::cerr << "GetShort: " << std::hex << offset << std::endl;
         throw std::runtime_error("Data Access Violation (GetShort)");
     }
 
     int32_t memory::GetLong(off_t offset) const {
-        if (offset + sizeof (int32_t) < this->dsize) {
+        if (DataRange(offset, sizeof (int32_t), this->dsize)) {
             return *(int32_t*) (this->ddata + offset);
         }
+        const char* ptr = this->Fetch(offset, sizeof (int32_t));
+        if (ptr != 0) {
+            return *(const int32_t*) ptr;
+        }
         std::cerr << "GetLong: " << std::hex << offset << std::endl;
         throw std::runtime_error("Data Access Violation (GetLong)");
     }
 
     int64_t memory::GetQuad(off_t offset) const {
-        if (offset + sizeof (int64_t) < this->dsize) {
+        if (DataRange(offset, sizeof (int64_t), this->dsize)) {
             return *(int64_t*) (this->ddata + offset);
         }
+        const char* ptr = this->Fetch(offset, sizeof (int64_t));
+        if (ptr != 0) {
+            return *(const int64_t*) ptr;
+        }
         std::cerr << "GetQuad: " << std::hex << offset << std::endl;
         throw std::runtime_error("Data Access Violation (GetQuad)");
     }
@@ -218,8 +631,36 @@ namespace zhvm {
         uint32_t dsize;
         reg_t regs[RTOTAL - 1];
         int32_t sflag;
+        uint32_t flags; ///< Image flags, since ZHVM_VM_VERSION_FLAGS
+        uint32_t checksum; ///< Image checksum algorithm, since ZHVM_VM_VERSION_CHECKSUM
+        uint32_t csizehi; ///< High bits of code size, since ZHVM_VM_VERSION_WIDE
+        uint32_t dsizehi; ///< High bits of data size, since ZHVM_VM_VERSION_WIDE
     };
 
+    /**
+     * Header size of given image version.
+     */
+    static size_t HeaderSize(uint32_t version) {
+        if (version < ZHVM_VM_VERSION_FLAGS) {
+            return offsetof(memory_file_header, flags);
+        }
+        if (version < ZHVM_VM_VERSION_CHECKSUM) {
+            return offsetof(memory_file_header, checksum);
+        }
+        if (version < ZHVM_VM_VERSION_WIDE) {
+            return offsetof(memory_file_header, csizehi);
+        }
+        // Structure tail padding is not saved
+        return offsetof(memory_file_header, dsizehi) + sizeof (uint32_t);
+    }
+
+    /**
+     * Full 64-bit section size from header.
+     */
+    static uint64_t SectionSize(uint32_t lo, uint32_t hi) {
+        return ((uint64_t) hi << 32) | lo;
+    }
+
     uint32_t sdbm(uint32_t hash, const void* data, size_t len) {
         const uint8_t* str = (const uint8_t*) data;
         while (len-- > 0) {
@@ -229,112 +670,1185 @@ namespace zhvm {
         return hash;
     }
 
+    /**
+     * Reflected CRC-32C lookup table.
+     */
+    struct crc32c_table {
+        uint32_t item[256];
+
+        crc32c_table() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; ++bit) {
+                    crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78 : 0);
+                }
+                this->item[i] = crc;
+            }
+        }
+    };
+
+    static uint32_t crc32c_soft(uint32_t crc, const uint8_t* str, size_t len) {
+        static const crc32c_table table;
+        while (len-- > 0) {
+            crc = table.item[(crc ^ *str) & 0xFF] ^ (crc >> 8);
+            ++str;
+        }
+        return crc;
+    }
+
+#ifdef ZHVM_CRC32C_SSE42
+
+    __attribute__((target("sse4.2")))
+    static uint32_t crc32c_sse42(uint32_t crc, const uint8_t* str, size_t len) {
+#if defined(__x86_64__)
+        uint64_t crcq = crc;
+        while (len >= sizeof (uint64_t)) {
+            uint64_t val;
+            memcpy(&val, str, sizeof (uint64_t));
+            crcq = _mm_crc32_u64(crcq, val);
+            str += sizeof (uint64_t);
+            len -= sizeof (uint64_t);
+        }
+        crc = (uint32_t) crcq;
+#endif
+        while (len >= sizeof (uint32_t)) {
+            uint32_t val;
+            memcpy(&val, str, sizeof (uint32_t));
+            crc = _mm_crc32_u32(crc, val);
+            str += sizeof (uint32_t);
+            len -= sizeof (uint32_t);
+        }
+        while (len-- > 0) {
+            crc = _mm_crc32_u8(crc, *str);
+            ++str;
+        }
+        return crc;
+    }
+
+    static bool crc32c_has_sse42() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.2");
+    }
+
+#endif
+
+    uint32_t crc32c(uint32_t crc, const void* data, size_t len) {
+        const uint8_t* str = (const uint8_t*) data;
+#ifdef ZHVM_CRC32C_SSE42
+        static const bool hardware = crc32c_has_sse42();
+        if (hardware) {
+            return ~crc32c_sse42(~crc, str, len);
+        }
+#endif
+        return ~crc32c_soft(~crc, str, len);
+    }
+
+    /**
+     * Padding before page aligned image section.
+     */
+    static size_t ImagePad(size_t offset) {
+        return (ZHVM_PAGE_SIZE - offset % ZHVM_PAGE_SIZE) % ZHVM_PAGE_SIZE;
+    }
+
+    static size_t WritePad(std::ostream& out, size_t offset) {
+        static const char zeros[ZHVM_PAGE_SIZE] = {0};
+        const size_t pad = ImagePad(offset);
+        out.write(zeros, pad);
+        return pad;
+    }
+
+    static void ReadExact(std::istream& inp, void* dst, size_t len) {
+        inp.read((char*) dst, len);
+        if (inp.gcount() != (std::streamsize) len) {
+            throw std::runtime_error("Unexpected EOF");
+        }
+    }
+
+    /**
+     * Shortest zero run, which ends literal extent of sparse section.
+     */
+    static const size_t ZHVM_SPARSE_GAP = 32;
+
+    /**
+     * Longest literal extent of sparse section.
+     */
+    static const size_t ZHVM_SPARSE_EXTENT = 0x10000;
+
+    /**
+     * Write sparse section. Section is list of extents: zero run length,
+     * literal length, stored length and stored bytes. Stored length less 
+     * than literal length means compressed literal.
+     */
+    static void WriteSection(std::ostream& out, const char* buf, size_t len, bool packed) {
+        std::vector<char> scratch;
+        size_t pos = 0;
+        while (pos < len) {
+            const size_t start = pos;
+            uint64_t word = 0;
+            while ((pos + sizeof (uint64_t) <= len) && (pos - start < UINT32_MAX) && (memcpy(&word, buf + pos, sizeof (uint64_t)), word == 0)) {
+                pos += sizeof (uint64_t);
+            }
+            while ((pos < len) && (buf[pos] == 0)) {
+                ++pos;
+            }
+            if (pos - start > UINT32_MAX) {
+                // Extent holds 32-bit zero run length
+                pos = start + UINT32_MAX;
+            }
+
+            size_t end = pos;
+            size_t zrun = 0;
+            while ((end < len) && (end - pos < ZHVM_SPARSE_EXTENT)) {
+                zrun = (buf[end] == 0) ? zrun + 1 : 0;
+                ++end;
+                if (zrun == ZHVM_SPARSE_GAP) {
+                    end -= zrun;
+                    break;
+                }
+            }
+
+            uint32_t extent[3] = {(uint32_t) (pos - start), (uint32_t) (end - pos), (uint32_t) (end - pos)};
+            const char* stored = buf + pos;
+            if (packed && (extent[1] > 0)) {
+                scratch.resize(extent[1]);
+                size_t clen = LzCompress(buf + pos, extent[1], scratch.data(), extent[1] - 1);
+                if (clen != 0) {
+                    extent[2] = (uint32_t) clen;
+                    stored = scratch.data();
+                }
+            }
+
+            out.write((const char*) extent, sizeof (extent));
+            out.write(stored, extent[2]);
+            pos = end;
+        }
+    }
+
+    /**
+     * Read sparse section straight into zero filled buffer. Zero runs are
+     * skipped, so their pages are never touched.
+     */
+    static void SkipPad(std::istream& inp, size_t offset) {
+        const size_t pad = ImagePad(offset);
+        inp.ignore(pad);
+        if (inp.gcount() != (std::streamsize) pad) {
+            throw std::runtime_error("Unexpected EOF");
+        }
+    }
+
+    /**
+     * Read and validate image header.
+     *
+     * @return header size of image version
+     */
+    static size_t ReadHeader(std::istream& inp, memory_file_header* mfh) {
+        memset(mfh, 0, sizeof (memory_file_header));
+
+        const size_t common = offsetof(memory_file_header, flags);
+        ReadExact(inp, mfh, common);
+
+        if (mfh->magic != ZHVM_MEMORY_FILE_MAGIC) {
+            throw std::runtime_error("Not a ZHVM image");
+        }
+
+        if ((mfh->version < ZHVM_VM_VERSION_MIN) || (mfh->version > ZHVM_VM_VERSION)) {
+            throw std::runtime_error("Invalid ZHVM version");
+        }
+
+        const size_t hsize = HeaderSize(mfh->version);
+        ReadExact(inp, ((char*) mfh) + common, hsize - common);
+
+        if ((mfh->flags & ~IF_KNOWN) != 0) {
+            throw std::runtime_error("Unsupported ZHVM image flags");
+        }
+
+        if (mfh->checksum >= IC_TOTAL) {
+            throw std::runtime_error("Unsupported ZHVM image checksum");
+        }
+
+        if ((mfh->csizehi != 0) || (mfh->dsizehi != 0)) {
+            if ((sizeof (size_t) < sizeof (uint64_t)) || (SectionSize(mfh->csize, mfh->csizehi) + SectionSize(mfh->dsize, mfh->dsizehi) < SectionSize(mfh->csize, mfh->csizehi))) {
+                throw std::runtime_error("ZHVM image too large");
+            }
+        }
+        return hsize;
+    }
+
+    /**
+     * Image sections with own checksum.
+     */
+    enum image_section {
+        IS_STATE, ///< Header, registers and windows
+        IS_CODE, ///< Code segment
+        IS_DATA, ///< Data segment
+        IS_TOTAL
+    };
+
+    /**
+     * Image checksum. Sdbm is single hash over whole image in write order,
+     * crc32c is computed for every section separately.
+     */
+    struct image_sum {
+        uint32_t kind;
+        uint32_t sums[IS_TOTAL];
+
+        explicit image_sum(uint32_t kind) : kind(kind), sums() {
+            ;
+        }
+
+        void Add(uint32_t section, const void* data, size_t len) {
+            if (this->kind == IC_SDBM) {
+                this->sums[0] = sdbm(this->sums[0], data, len);
+            } else {
+                this->sums[section] = crc32c(this->sums[section], data, len);
+            }
+        }
+
+        /**
+         * Checksum size at image end
+         */
+        size_t Size() const {
+            return (this->kind == IC_SDBM) ? sizeof (uint32_t) : sizeof (this->sums);
+        }
+
+        void Write(std::ostream& out) const {
+            out.write((const char*) this->sums, this->Size());
+        }
+
+        /**
+         * Take checksum from image end without check
+         */
+        void Read(std::istream& inp) {
+            ReadExact(inp, this->sums, this->Size());
+        }
+
+        /**
+         * Image id, used to chain delta checkpoints
+         */
+        uint32_t Id() const {
+            return crc32c(0, this->sums, this->Size());
+        }
+
+        /**
+         * Read checksum from image end and compare with computed one
+         */
+        void Check(std::istream& inp) const {
+            uint32_t fsums[IS_TOTAL] = {0};
+            ReadExact(inp, fsums, this->Size());
+            if (memcmp(fsums, this->sums, this->Size()) != 0) {
+                throw std::runtime_error("ZHVM image corrupted");
+            }
+        }
+    };
+
+    /**
+     * Read sparse section and add it to checksum. Zero runs are summed from
+     * static zero buffer, so untouched pages of fresh segment stay uncommitted.
+     * Literal runs are marked as written in seg, when given.
+     */
+    static void ReadSection(std::istream& inp, char* buf, size_t len, image_sum* sum, uint32_t section, segment* seg = 0) {
+        static const char zero[ZHVM_PAGE_SIZE] = {0};
+        std::vector<char> scratch;
+        size_t pos = 0;
+        while (pos < len) {
+            uint32_t extent[3];
+            ReadExact(inp, extent, sizeof (extent));
+
+            const size_t zeros = extent[0];
+            const size_t literal = extent[1];
+            const size_t stored = extent[2];
+            if ((zeros + literal == 0) || (zeros > len - pos) || (literal > len - pos - zeros) || (stored > literal)) {
+                throw std::runtime_error("ZHVM image corrupted");
+            }
+
+            for (size_t left = zeros; left != 0;) {
+                const size_t chunk = std::min(left, sizeof (zero));
+                sum->Add(section, zero, chunk);
+                left -= chunk;
+            }
+            pos += zeros;
+
+            if (seg != 0) {
+                seg->Touch(pos, literal);
+            }
+            if (stored == literal) {
+                ReadExact(inp, buf + pos, literal);
+            } else {
+                scratch.resize(stored);
+                ReadExact(inp, scratch.data(), stored);
+                if (!LzDecompress(scratch.data(), stored, buf + pos, literal)) {
+                    throw std::runtime_error("ZHVM image corrupted");
+                }
+            }
+            sum->Add(section, buf + pos, literal);
+            pos += literal;
+        }
+    }
+
+    /**
+     * Write debug section: byte length, then debug_info::Save output.
+     */
+    static void DumpDebug(std::ostream& out, const debug_info* info, image_sum* sum) {
+        std::vector<char> buf;
+        info->Save(&buf);
+        uint64_t len = buf.size();
+
+        sum->Add(IS_STATE, &len, sizeof (uint64_t));
+        sum->Add(IS_STATE, buf.data(), buf.size());
+
+        out.write((char*) &len, sizeof (uint64_t));
+        out.write(buf.data(), buf.size());
+    }
+
+    static std::shared_ptr<const debug_info> LoadDebug(std::istream& inp, image_sum* sum) {
+        uint64_t len = 0;
+        ReadExact(inp, &len, sizeof (uint64_t));
+        if (len != (size_t) len) {
+            std::cerr << "LoadDebug: " << len << std::endl;
+            throw std::runtime_error("Image Format Error");
+        }
+        std::vector<char> buf((size_t) len);
+        ReadExact(inp, buf.data(), buf.size());
+
+        sum->Add(IS_STATE, &len, sizeof (uint64_t));
+        sum->Add(IS_STATE, buf.data(), buf.size());
+
+        std::shared_ptr<debug_info> info = std::make_shared<debug_info>();
+        info->Restore(buf.data(), buf.size());
+        return info;
+    }
+
+    void memory::DumpImports(std::ostream& out, image_sum* sum) const {
+        std::vector<char> buf;
+        uint32_t count = 0;
+        for (uint32_t i = ZHVM_CFUNC_ARRAY_SIZE; i < this->fcount; ++i) {
+            const std::string& name = this->funcs->Name(i);
+            if (!name.empty()) {
+                uint32_t head[2] = {i, (uint32_t) name.size()};
+                buf.insert(buf.end(), (char*) head, (char*) (head + 2));
+                buf.insert(buf.end(), name.begin(), name.end());
+                ++count;
+            }
+        }
+
+        sum->Add(IS_STATE, &count, sizeof (uint32_t));
+        sum->Add(IS_STATE, buf.data(), buf.size());
+
+        out.write((char*) &count, sizeof (uint32_t));
+        out.write(buf.data(), buf.size());
+    }
+
+    void memory::LoadImports(std::istream& inp, image_sum* sum, const host_table* bound) {
+        uint32_t count = 0;
+        ReadExact(inp, &count, sizeof (uint32_t));
+        sum->Add(IS_STATE, &count, sizeof (uint32_t));
+        if (count > ZHVM_CFUNC_LIMIT) {
+            std::cerr << "LoadImports: " << count << " imports" << std::endl;
+            throw std::runtime_error("Image Format Error");
+        }
+
+        host_table* table = this->UnshareFuncs();
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t head[2] = {0, 0};
+            ReadExact(inp, head, sizeof (head));
+            if ((head[0] >= ZHVM_CFUNC_LIMIT) || (head[1] == 0) || (head[1] > ZHVM_CFUNC_NAME_MAX)) {
+                std::cerr << "LoadImports: " << head[0] << " [" << head[1] << "]" << std::endl;
+                throw std::runtime_error("Image Format Error");
+            }
+            std::string name(head[1], '\0');
+            ReadExact(inp, &name[0], head[1]);
+
+            sum->Add(IS_STATE, head, sizeof (head));
+            sum->Add(IS_STATE, name.data(), name.size());
+
+            if (!table->Import(name, head[0])) {
+                std::cerr << "LoadImports: " << name << " at " << head[0] << std::endl;
+                throw std::runtime_error("Image Format Error");
+            }
+
+            // Function bound by host before load
+            uint32_t slot = 0;
+            if ((bound != 0) && bound->Find(name, &slot) && !bound->Unbound(slot)) {
+                table->Set(head[0], bound->Data()[slot]);
+            }
+        }
+        this->SetTable(this->funcs);
+    }
+
+    size_t memory::DumpState(std::ostream& out, image_sum* sum) const {
+        const size_t rsize = sizeof (reg_t)*(RTOTAL - 1);
+        sum->Add(IS_STATE, this->regs + 1, rsize);
+        sum->Add(IS_STATE, &this->sflag, sizeof (int32_t));
+
+        out.write((char*) (this->regs + 1), rsize);
+        out.write((char*) &this->sflag, sizeof (int32_t));
+        size_t result = rsize + sizeof (int32_t);
+
+        if (this->iflags & IF_WINDOWS) {
+            // Window stack is saved oldest first
+            std::vector<reg_t> windows(this->wspill);
+            for (uint32_t i = this->wcount; i > 0; --i) {
+                const reg_t* bank = this->wbanks + ((this->whead + ZHVM_WINDOW_BANKS - i) % ZHVM_WINDOW_BANKS) * ZHVM_WINDOW_SIZE;
+                windows.insert(windows.end(), bank, bank + ZHVM_WINDOW_SIZE);
+            }
+            uint32_t wlen = windows.size() / ZHVM_WINDOW_SIZE;
+
+            sum->Add(IS_STATE, &wlen, sizeof (uint32_t));
+            sum->Add(IS_STATE, windows.data(), windows.size() * sizeof (reg_t));
+
+            out.write((char*) &wlen, sizeof (uint32_t));
+            out.write((char*) windows.data(), windows.size() * sizeof (reg_t));
+            result += sizeof (uint32_t) + windows.size() * sizeof (reg_t);
+        }
+
+        if (this->iflags & IF_GROWABLE) {
+            // Limits and used top of stack region
+            uint64_t limits[3] = {this->dlimit, this->stack.Size(), this->ssize};
+            const char* top = this->stack.Data() + this->stack.Size() - this->ssize;
+
+            sum->Add(IS_STATE, limits, sizeof (limits));
+            sum->Add(IS_STATE, top, this->ssize);
+
+            out.write((char*) limits, sizeof (limits));
+            out.write(top, this->ssize);
+            result += sizeof (limits) + this->ssize;
+        }
+        return result;
+    }
+
+    size_t memory::LoadState(std::istream& inp, image_sum* sum) {
+        const size_t rsize = sizeof (reg_t)*(RTOTAL - 1);
+        ReadExact(inp, this->regs + 1, rsize);
+        ReadExact(inp, &this->sflag, sizeof (int32_t));
+
+        sum->Add(IS_STATE, this->regs + 1, rsize);
+        sum->Add(IS_STATE, &this->sflag, sizeof (int32_t));
+        size_t result = rsize + sizeof (int32_t);
+
+        if (this->iflags & IF_WINDOWS) {
+            // Loaded windows stay spilled, until they are popped
+            uint32_t wlen = 0;
+            ReadExact(inp, &wlen, sizeof (uint32_t));
+            if (wlen > ZHVM_WINDOW_SPILL_MAX + ZHVM_WINDOW_BANKS) {
+                std::cerr << "LoadState: " << wlen << " windows saved" << std::endl;
+                throw std::runtime_error("Image Format Error");
+            }
+
+            this->wspill.resize(wlen * ZHVM_WINDOW_SIZE);
+            const size_t wsize = this->wspill.size() * sizeof (reg_t);
+            ReadExact(inp, this->wspill.data(), wsize);
+
+            sum->Add(IS_STATE, &wlen, sizeof (uint32_t));
+            sum->Add(IS_STATE, this->wspill.data(), wsize);
+            result += sizeof (uint32_t) + wsize;
+        }
+
+        if (this->iflags & IF_GROWABLE) {
+            // Data limit is applied by caller, after data segment is loaded
+            uint64_t limits[3];
+            ReadExact(inp, limits, sizeof (limits));
+            if ((limits[0] != (size_t) limits[0]) || (limits[1] != (size_t) limits[1]) || (limits[2] > limits[1])) {
+                std::cerr << "LoadState: " << limits[0] << ", " << limits[1] << " [" << limits[2] << "]" << std::endl;
+                throw std::runtime_error("Image Format Error");
+            }
+            this->dlimit = (size_t) limits[0];
+            this->stack = segment((size_t) limits[1]);
+            this->ssize = (size_t) limits[2];
+
+            char* top = this->stack.Data() + this->stack.Size() - this->ssize;
+            this->stack.Touch(this->stack.Size() - this->ssize, this->ssize);
+            ReadExact(inp, top, this->ssize);
+
+            sum->Add(IS_STATE, limits, sizeof (limits));
+            sum->Add(IS_STATE, top, this->ssize);
+            result += sizeof (limits) + this->ssize;
+        }
+        return result;
+    }
+
     void memory::Dump(std::ostream & out) const {
+        this->DumpImage(out);
+    }
+
+    uint32_t memory::DumpImage(std::ostream & out) const {
         if (out) {
             memory_file_header mfh;
+            memset(&mfh, 0, sizeof (memory_file_header));
             mfh.magic = ZHVM_MEMORY_FILE_MAGIC;
             mfh.version = ZHVM_VM_VERSION;
-            mfh.csize = this->csize;
-            mfh.dsize = this->dsize;
+            mfh.csize = (uint32_t) this->csize;
+            mfh.dsize = (uint32_t) this->dsize;
+            mfh.csizehi = (uint32_t) ((uint64_t) this->csize >> 32);
+            mfh.dsizehi = (uint32_t) ((uint64_t) this->dsize >> 32);
+            mfh.flags = this->iflags;
+            mfh.checksum = IC_CRC32C;
+            if (mfh.flags & IF_ALIGNED) {
+                // Aligned sections are mapped as is
+                mfh.flags &= ~(IF_SPARSE | IF_PACKED);
+            }
+            if (!this->debug) {
+                mfh.flags &= ~IF_DEBUG;
+            }
 
-            uint32_t hash = sdbm(0, &mfh, sizeof (memory_file_header));
-            hash = sdbm(hash, this->cdata, this->csize);
-            hash = sdbm(hash, this->ddata, this->dsize);
-            hash = sdbm(hash, this->regs + 1, sizeof (reg_t)*(RTOTAL - 1));
-            hash = sdbm(hash, &this->sflag, sizeof (int32_t));
+            image_sum sum(mfh.checksum);
+            const size_t hsize = HeaderSize(mfh.version);
+            sum.Add(IS_STATE, &mfh, hsize);
+            out.write((char*) &mfh, hsize);
+
+            if ((this->iflags & IF_ALIGNED) == 0) {
+                sum.Add(IS_CODE, this->cdata, this->csize);
+                sum.Add(IS_DATA, this->ddata, this->dsize);
+
+                if ((mfh.flags & (IF_SPARSE | IF_PACKED)) == 0) {
+                    out.write(this->cdata, this->csize);
+                    out.write(this->ddata, this->dsize);
+                } else {
+                    const bool packed = (mfh.flags & IF_PACKED) != 0;
+                    WriteSection(out, this->cdata, this->csize, packed);
+                    WriteSection(out, this->ddata, this->dsize, packed);
+                }
+                this->DumpState(out, &sum);
+            } else {
+                // State goes first, so code and data start at page boundary
+                size_t offset = hsize + this->DumpState(out, &sum);
+                offset += WritePad(out, offset);
+
+                sum.Add(IS_CODE, this->cdata, this->csize);
+                out.write(this->cdata, this->csize);
+                offset += this->csize;
+                WritePad(out, offset);
+
+                sum.Add(IS_DATA, this->ddata, this->dsize);
+                out.write(this->ddata, this->dsize);
+            }
 
-            out.write((char*) &mfh, sizeof (memory_file_header));
-            out.write(this->cdata, this->csize);
-            out.write(this->ddata, this->dsize);
-            out.write((char*) (this->regs + 1), sizeof (reg_t)*(RTOTAL - 1));
-            out.write((char*) &this->sflag, sizeof (int32_t));
-            out.write((char*) &hash, sizeof (uint32_t));
+            if (mfh.flags & IF_IMPORTS) {
+                this->DumpImports(out, &sum);
+            }
+            if (mfh.flags & IF_DEBUG) {
+                DumpDebug(out, this->debug.get(), &sum);
+            }
+            sum.Write(out);
+            return sum.Id();
         }
+        return 0;
     }
 
     void memory::Load(std::istream & inp) {
         if (inp) {
             memory_file_header mfh;
-            inp.read((char*) &mfh, sizeof (memory_file_header));
-            if (inp.gcount() != sizeof (memory_file_header)) {
+            const size_t hsize = ReadHeader(inp, &mfh);
+
+            memory temp;
+            temp.NewImage(SectionSize(mfh.csize, mfh.csizehi), SectionSize(mfh.dsize, mfh.dsizehi));
+            temp.iflags = mfh.flags;
+
+            image_sum sum(mfh.checksum);
+            sum.Add(IS_STATE, &mfh, hsize);
+            if ((temp.iflags & IF_ALIGNED) == 0) {
+                if ((temp.iflags & (IF_SPARSE | IF_PACKED)) == 0) {
+                    ReadExact(inp, temp.cdata, temp.csize);
+                    temp.data.Touch(0, temp.dsize);
+                    ReadExact(inp, temp.ddata, temp.dsize);
+                    sum.Add(IS_CODE, temp.cdata, temp.csize);
+                    sum.Add(IS_DATA, temp.ddata, temp.dsize);
+                } else {
+                    ReadSection(inp, temp.cdata, temp.csize, &sum, IS_CODE);
+                    ReadSection(inp, temp.ddata, temp.dsize, &sum, IS_DATA, &temp.data);
+                }
+
+                temp.LoadState(inp, &sum);
+            } else {
+                size_t offset = hsize + temp.LoadState(inp, &sum);
+                SkipPad(inp, offset);
+                offset += ImagePad(offset);
+
+                ReadExact(inp, temp.cdata, temp.csize);
+                offset += temp.csize;
+                SkipPad(inp, offset);
+                temp.data.Touch(0, temp.dsize);
+                ReadExact(inp, temp.ddata, temp.dsize);
+
+                sum.Add(IS_CODE, temp.cdata, temp.csize);
+                sum.Add(IS_DATA, temp.ddata, temp.dsize);
+            }
+
+            if (temp.iflags & IF_IMPORTS) {
+                temp.LoadImports(inp, &sum, this->funcs.get());
+            }
+            if (temp.iflags & IF_DEBUG) {
+                temp.debug = LoadDebug(inp, &sum);
+            }
+            sum.Check(inp);
+            temp.chkid = sum.Id();
+            temp.data.ClearChanged();
+            temp.ApplyLimit();
+            *this = std::move(temp);
+        }
+    }
+
+    void memory::Map(const char* path, bool verify) {
+        std::ifstream inp(path, std::ios_base::in | std::ios_base::binary);
+        if (!inp) {
+            std::cerr << "Map: " << path << std::endl;
+            throw std::runtime_error("Can't open ZHVM image");
+        }
+#ifdef ZHVM_IMAGE_MMAP
+        memory_file_header mfh;
+        const size_t hsize = ReadHeader(inp, &mfh);
+
+        if ((mfh.flags & IF_ALIGNED) && (ZHVM_PAGE_SIZE % sysconf(_SC_PAGESIZE) == 0)) {
+            memory temp(0, 0);
+            temp.iflags = mfh.flags;
+
+            const size_t csize = SectionSize(mfh.csize, mfh.csizehi);
+            const size_t dsize = SectionSize(mfh.dsize, mfh.dsizehi);
+
+            image_sum sum(mfh.checksum);
+            sum.Add(IS_STATE, &mfh, hsize);
+            const size_t offset = hsize + temp.LoadState(inp, &sum);
+            const size_t coffset = offset + ImagePad(offset);
+            const size_t doffset = coffset + csize + ImagePad(coffset + csize);
+
+            int fd = open(path, O_RDONLY | O_CLOEXEC);
+            struct stat fs;
+            if ((fd < 0) || (fstat(fd, &fs) != 0) || ((size_t) fs.st_size < doffset + dsize + sum.Size())) {
+                if (fd >= 0) {
+                    close(fd);
+                }
                 throw std::runtime_error("Unexpected EOF");
             }
 
-            if (mfh.magic != ZHVM_MEMORY_FILE_MAGIC) {
-                throw std::runtime_error("Not a ZHVM image");
+            try {
+                if (csize != 0) {
+                    void* code = mmap(0, csize, PROT_READ, MAP_PRIVATE, fd, coffset);
+                    if (code == MAP_FAILED) {
+                        throw std::runtime_error("Can't map ZHVM image");
+                    }
+                    temp.code.reset((char*) code, [csize](char* ptr) {
+                        munmap(ptr, csize);
+                    });
+                    temp.cdata = temp.code.get();
+                    temp.csize = csize;
+                    temp.cfixed = true;
+                }
+                temp.data = segment(fd, doffset, dsize);
+                temp.ddata = temp.data.Data();
+                temp.dsize = temp.data.Size();
+            } catch (...) {
+                close(fd);
+                throw;
             }
+            close(fd);
 
-            if (mfh.version != ZHVM_VM_VERSION) {
+            inp.seekg(doffset + dsize);
+            if (verify) {
+                sum.Add(IS_CODE, temp.cdata, temp.csize);
+                sum.Add(IS_DATA, temp.ddata, temp.dsize);
+            }
+            if (temp.iflags & IF_IMPORTS) {
+                temp.LoadImports(inp, &sum, this->funcs.get());
+            }
+            if (temp.iflags & IF_DEBUG) {
+                temp.debug = LoadDebug(inp, &sum);
+            }
+            if (verify) {
+                sum.Check(inp);
+            } else {
+                sum.Read(inp);
+            }
+            temp.chkid = sum.Id();
+            temp.ApplyLimit();
+            *this = std::move(temp);
+            return;
+        }
+        inp.seekg(0);
+#endif
+        this->Load(inp);
+    }
+
+    /**
+     * Delta checkpoint header.
+     */
+    struct memory_delta_header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t parent; ///< Id of checkpoint delta applies to
+        uint32_t flags; ///< Image flags
+        uint32_t dflags; ///< Delta flags
+        uint32_t pages; ///< Changed data pages
+        uint64_t csize;
+        uint64_t dsize;
+    };
+
+    /**
+     * Delta checkpoint flags.
+     */
+    enum delta_flags {
+        DF_CODE = 1 << 0 ///< Delta holds whole code segment
+    };
+
+    size_t memory::MapFile(const char* path, off_t offset) {
+        std::ifstream inp(path, std::ios_base::in | std::ios_base::binary | std::ios_base::ate);
+        if (!inp) {
+            std::cerr << "MapFile: " << path << std::endl;
+            throw std::runtime_error("Can't open host file");
+        }
+        const std::streamoff len = inp.tellg();
+        if ((offset < 0) || (offset % ZHVM_PAGE_SIZE != 0) || (len < 0) || ((uint64_t) offset > SIZE_MAX - ZHVM_PAGE_SIZE) || ((uint64_t) len > SIZE_MAX - ZHVM_PAGE_SIZE - (size_t) offset)) {
+            std::cerr << "MapFile: " << path << " at " << std::hex << offset << std::dec << " [" << len << "]" << std::endl;
+            throw std::runtime_error("Invalid host file range");
+        }
+
+        const size_t end = ((size_t) offset + (size_t) len + ZHVM_PAGE_SIZE - 1) & ~(size_t) (ZHVM_PAGE_SIZE - 1);
+        this->dlimit = std::max(this->dlimit, end);
+        this->ApplyLimit();
+        this->dsize = std::max(this->dsize, end);
+
+#ifdef ZHVM_IMAGE_MMAP
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            std::cerr << "MapFile: " << path << std::endl;
+            throw std::runtime_error("Can't open host file");
+        }
+        try {
+            this->data.MapFile(fd, offset, len);
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+        close(fd);
+#else
+        inp.seekg(0);
+        this->data.Touch(offset, len);
+        ReadExact(inp, this->ddata + offset, len);
+#endif
+        this->ddata = this->data.Data();
+        return len;
+    }
+
+    void memory::ShareData(page_store* store) {
+#ifdef ZHVM_IMAGE_MMAP
+        if (ZHVM_PAGE_SIZE % sysconf(_SC_PAGESIZE) != 0) {
+            return;
+        }
+        static const char zero[ZHVM_PAGE_SIZE] = {0};
+
+        // Runs of pages, which are consecutive in store too, are mapped at once
+        const size_t total = this->dsize >> ZHVM_PAGE_SHIFT;
+        size_t first = 0;
+        size_t index = 0;
+        size_t count = 0;
+        for (size_t page = 0; page <= total; ++page) {
+            const char* ptr = this->ddata + ((size_t) page << ZHVM_PAGE_SHIFT);
+            const bool shared = (page < total) && (memcmp(ptr, zero, ZHVM_PAGE_SIZE) != 0);
+            const size_t stored = shared ? store->Intern(ptr) : 0;
+            if (shared && (count != 0) && (stored == index + count)) {
+                ++count;
+                continue;
+            }
+            if (count != 0) {
+                this->data.Share(store->File(), first << ZHVM_PAGE_SHIFT, count << ZHVM_PAGE_SHIFT, index << ZHVM_PAGE_SHIFT);
+            }
+            first = page;
+            index = stored;
+            count = shared ? 1 : 0;
+        }
+#else
+        (void) store;
+#endif
+    }
+
+    uint32_t memory::Suspend(std::ostream& out) {
+        const uint32_t flags = this->iflags;
+        this->iflags = (flags & ~(IF_ALIGNED | IF_DEBUG | IF_IMPORTS)) | IF_SPARSE | IF_PACKED;
+        uint32_t result = 0;
+        try {
+            result = this->DumpImage(out);
+        } catch (...) {
+            this->iflags = flags;
+            throw;
+        }
+        this->iflags = flags;
+        if (!out) {
+            throw std::runtime_error("Can't write ZHVM image");
+        }
+
+        this->code.reset();
+        this->cfixed = false;
+        this->cdata = 0;
+        this->csize = 0;
+
+        this->data = segment();
+        this->ddata = 0;
+        this->dsize = 0;
+        this->dlimit = 0;
+        this->stack = segment();
+        this->ssize = 0;
+
+        this->whead = 0;
+        this->wcount = 0;
+        std::vector<reg_t>().swap(this->wspill);
+        return result;
+    }
+
+    void memory::Resume(std::istream& inp) {
+        std::shared_ptr<host_table> saved = this->funcs;
+        cop savedops[ZHVM_CUSTOM_TOTAL];
+        memcpy(savedops, this->cops, sizeof (savedops));
+        const uint32_t flags = this->iflags;
+        std::shared_ptr<const debug_info> info = this->debug;
+
+        this->Load(inp);
+
+        this->SetTable(saved);
+        memcpy(this->cops, savedops, sizeof (savedops));
+        this->iflags = flags;
+        this->debug = info;
+    }
+
+    void memory::Checkpoint(std::ostream & out) {
+        if (out) {
+            this->chkid = this->DumpImage(out);
+            this->cchanged = false;
+            this->data.ClearChanged();
+        }
+    }
+
+    void memory::Delta(std::ostream & out) {
+        if (out) {
+            std::vector<uint32_t> pages;
+            this->data.ChangedPages(&pages);
+
+            memory_delta_header mdh;
+            memset(&mdh, 0, sizeof (memory_delta_header));
+            mdh.magic = ZHVM_DELTA_FILE_MAGIC;
+            mdh.version = ZHVM_VM_VERSION;
+            mdh.parent = this->chkid;
+            mdh.flags = this->iflags;
+            mdh.dflags = this->cchanged ? DF_CODE : 0;
+            mdh.pages = pages.size();
+            mdh.csize = this->csize;
+            mdh.dsize = this->dsize;
+
+            image_sum sum(IC_CRC32C);
+            sum.Add(IS_STATE, &mdh, sizeof (memory_delta_header));
+            out.write((char*) &mdh, sizeof (memory_delta_header));
+            this->DumpState(out, &sum);
+
+            if (mdh.dflags & DF_CODE) {
+                sum.Add(IS_CODE, this->cdata, this->csize);
+                out.write(this->cdata, this->csize);
+            }
+
+            for (size_t i = 0; i < pages.size(); ++i) {
+                const size_t offset = (size_t) pages[i] << ZHVM_PAGE_SHIFT;
+                const size_t len = std::min<size_t>(ZHVM_PAGE_SIZE, this->dsize - offset);
+
+                sum.Add(IS_DATA, &pages[i], sizeof (uint32_t));
+                sum.Add(IS_DATA, this->ddata + offset, len);
+                out.write((char*) &pages[i], sizeof (uint32_t));
+                out.write(this->ddata + offset, len);
+            }
+
+            sum.Write(out);
+            this->chkid = sum.Id();
+            this->cchanged = false;
+            this->data.ClearChanged();
+        }
+    }
+
+    void memory::LoadDelta(std::istream & inp) {
+        if (inp) {
+            memory_delta_header mdh;
+            ReadExact(inp, &mdh, sizeof (memory_delta_header));
+
+            if (mdh.magic != ZHVM_DELTA_FILE_MAGIC) {
+                throw std::runtime_error("Not a ZHVM delta");
+            }
+
+            if ((mdh.version < ZHVM_VM_VERSION_DELTA) || (mdh.version > ZHVM_VM_VERSION)) {
                 throw std::runtime_error("Invalid ZHVM version");
             }
 
-            memory temp;
-            temp.NewImage(mfh.csize, mfh.dsize);
-            inp.read(temp.cdata, temp.csize);
-            if (inp.gcount() != temp.csize) {
-                throw std::runtime_error("Unexpected EOF");
+            if (mdh.parent != this->chkid) {
+                throw std::runtime_error("ZHVM delta does not follow checkpoint");
             }
 
-            inp.read(temp.ddata, temp.dsize);
-            if (inp.gcount() != temp.dsize) {
-                throw std::runtime_error("Unexpected EOF");
+            // Data segment may only grow since checkpoint
+            const size_t dsize = (size_t) mdh.dsize;
+            if ((mdh.csize != this->csize) || (mdh.dsize != dsize) || (dsize < this->dsize) || ((mdh.flags & ~IF_KNOWN) != 0) || ((mdh.dflags & ~DF_CODE) != 0)) {
+                throw std::runtime_error("ZHVM delta does not match image");
             }
 
-            inp.read((char*)(temp.regs + 1), sizeof (reg_t)*(RTOTAL - 1));
-            if (inp.gcount() != sizeof (reg_t)*(RTOTAL - 1)) {
-                throw std::runtime_error("Unexpected EOF");
+            // Whole delta is read and checked before it is applied
+            image_sum sum(IC_CRC32C);
+            sum.Add(IS_STATE, &mdh, sizeof (memory_delta_header));
+
+            memory state(0, 0);
+            state.iflags = mdh.flags;
+            state.LoadState(inp, &sum);
+
+            std::vector<char> code;
+            if (mdh.dflags & DF_CODE) {
+                code.resize(this->csize);
+                ReadExact(inp, code.data(), code.size());
+                sum.Add(IS_CODE, code.data(), code.size());
             }
 
-            inp.read((char*) &temp.sflag, sizeof (int32_t));
-            if (inp.gcount() != sizeof (int32_t)) {
-                throw std::runtime_error("Unexpected EOF");
+            // Page count comes from file, check it before allocation
+            const size_t total = (dsize + ZHVM_PAGE_SIZE - 1) >> ZHVM_PAGE_SHIFT;
+            if (mdh.pages > total) {
+                throw std::runtime_error("ZHVM delta corrupted");
             }
 
-            uint32_t hash = sdbm(0, &mfh, sizeof (memory_file_header));
-            hash = sdbm(hash, temp.cdata, temp.csize);
-            hash = sdbm(hash, temp.ddata, temp.dsize);
-            hash = sdbm(hash, temp.regs + 1, sizeof (reg_t)*(RTOTAL - 1));
-            hash = sdbm(hash, &temp.sflag, sizeof (int32_t));
+            std::vector<uint32_t> pages(mdh.pages);
+            std::vector<char> bytes(pages.size() * ZHVM_PAGE_SIZE);
+            for (size_t i = 0; i < pages.size(); ++i) {
+                ReadExact(inp, &pages[i], sizeof (uint32_t));
+                // Pages are written in ascending order, each once
+                if ((pages[i] >= total) || ((i > 0) && (pages[i] <= pages[i - 1]))) {
+                    throw std::runtime_error("ZHVM delta corrupted");
+                }
+                const size_t offset = (size_t) pages[i] << ZHVM_PAGE_SHIFT;
+                const size_t len = std::min<size_t>(ZHVM_PAGE_SIZE, dsize - offset);
+                ReadExact(inp, bytes.data() + i * ZHVM_PAGE_SIZE, len);
+
+                sum.Add(IS_DATA, &pages[i], sizeof (uint32_t));
+                sum.Add(IS_DATA, bytes.data() + i * ZHVM_PAGE_SIZE, len);
+            }
 
-            uint32_t fhash = 0;
-            inp.read((char*) &fhash, sizeof (uint32_t));
-            if (inp.gcount() != sizeof (uint32_t)) {
-                throw std::runtime_error("Unexpected EOF");
+            sum.Check(inp);
+
+            for (int i = RA; i < RTOTAL; ++i) {
+                this->regs[i] = state.regs[i];
+            }
+            this->sflag = state.sflag;
+            this->iflags = mdh.flags;
+
+            this->whead = 0;
+            this->wcount = 0;
+            this->wspill = std::move(state.wspill);
+
+            this->stack = std::move(state.stack);
+            this->ssize = state.ssize;
+            this->dsize = dsize;
+            this->dlimit = std::max(state.dlimit, this->dlimit);
+            this->ApplyLimit();
+
+            if (mdh.dflags & DF_CODE) {
+                this->UnshareCode();
+                memcpy(this->cdata, code.data(), this->csize);
             }
 
-            if (fhash != hash) {
-                throw std::runtime_error("ZHVM image corrupted");
+            for (size_t i = 0; i < pages.size(); ++i) {
+                const size_t offset = (size_t) pages[i] << ZHVM_PAGE_SHIFT;
+                const size_t len = std::min<size_t>(ZHVM_PAGE_SIZE, this->dsize - offset);
+                this->data.Touch(offset, len);
+                memcpy(this->ddata + offset, bytes.data() + i * ZHVM_PAGE_SIZE, len);
             }
-            *this = std::move(temp);
+
+            this->chkid = sum.Id();
+            this->cchanged = false;
+            this->data.ClearChanged();
+        }
+    }
+
+    void memory::ApplyLimit() {
+        this->dlimit = std::max(this->dlimit, this->dsize);
+        this->data.Resize(this->dlimit);
+        this->ddata = this->data.Data();
+    }
+
+    void memory::SetLimits(size_t datalimit, size_t stacklimit) {
+        this->dlimit = datalimit;
+        this->ApplyLimit();
+
+        // Stack grows down from zero address, so used part stays at the top
+        stacklimit = std::max(stacklimit, this->ssize);
+        if (stacklimit != this->stack.Size()) {
+            segment grown(stacklimit);
+            grown.Touch(stacklimit - this->ssize, this->ssize);
+            memcpy(grown.Data() + stacklimit - this->ssize, this->stack.Data() + this->stack.Size() - this->ssize, this->ssize);
+            this->stack = std::move(grown);
+        }
+        this->iflags |= IF_GROWABLE;
+    }
+
+    uint32_t memory::ImageFlags() const {
+        return this->iflags;
+    }
+
+    memory& memory::SetImageFlags(uint32_t flags) {
+        this->iflags = flags;
+        return *this;
+    }
+
+    void memory::SetDebug(const std::shared_ptr<const debug_info>& info) {
+        this->debug = info;
+        if (info) {
+            this->iflags |= IF_DEBUG;
+        } else {
+            this->iflags &= ~IF_DEBUG;
+        }
+    }
+
+    /**
+     * Table of new VM, shared by all VMs until they change it
+     */
+    static const std::shared_ptr<host_table>& StandardTable() {
+        static const std::shared_ptr<host_table> standard = std::make_shared<host_table>();
+        return standard;
+    }
+
+    void memory::SetTable(const std::shared_ptr<host_table>& table) {
+        this->funcs = table;
+        this->fdata = table->Data();
+        this->fcount = table->Size();
+    }
+
+    host_table* memory::UnshareFuncs() {
+        if (this->funcs.use_count() > 1) {
+            this->funcs = std::make_shared<host_table>(*this->funcs);
         }
+        return this->funcs.get();
+    }
+
+    void memory::SetFuncs(uint32_t index, cfunc func) {
+        const host_func entry = {func, 0, 0};
+        this->UnshareFuncs()->Set(index, entry);
+        this->SetTable(this->funcs);
     }
 
-    void memory::SetFuncs(uint32_t index, cfunc funcs) {
-        this->funcs[index] = funcs;
+    void memory::SetFuncs(uint32_t index, ufunc func, void* userdata) {
+        const host_func entry = {none, func, userdata};
+        this->UnshareFuncs()->Set(index, entry);
+        this->SetTable(this->funcs);
+    }
+
+    uint32_t memory::Bind(const char* name, ufunc func, void* userdata) {
+        const host_func entry = {none, func, userdata};
+        const uint32_t result = this->UnshareFuncs()->Bind(name, entry);
+        this->SetTable(this->funcs);
+        this->iflags |= IF_IMPORTS;
+        return result;
+    }
+
+    uint32_t memory::Bind(const char* name, cfunc func) {
+        const host_func entry = {func, 0, 0};
+        const uint32_t result = this->UnshareFuncs()->Bind(name, entry);
+        this->SetTable(this->funcs);
+        this->iflags |= IF_IMPORTS;
+        return result;
+    }
+
+    uint32_t memory::Import(const char* name) {
+        uint32_t result = 0;
+        if (!this->funcs->Find(name, &result)) {
+            result = this->UnshareFuncs()->Import(name);
+            this->SetTable(this->funcs);
+        }
+        this->iflags |= IF_IMPORTS;
+        return result;
+    }
+
+    void memory::Unbound(std::vector<std::string>* names) const {
+        for (uint32_t i = ZHVM_CFUNC_ARRAY_SIZE; i < this->fcount; ++i) {
+            if (!this->funcs->Name(i).empty() && this->funcs->Unbound(i)) {
+                names->push_back(this->funcs->Name(i));
+            }
+        }
     }
 
     int memory::Call(uint32_t index) {
-        return this->funcs[index](this);
+        if (index < this->fcount) {
+            const host_func& entry = this->fdata[index];
+            return (entry.func != 0) ? entry.func(this, entry.userdata) : entry.plain(this);
+        }
+        std::cerr << "Call: " << index << std::endl;
+        throw std::runtime_error("Invalid host function");
     }
 
-    void memory::NewImage(size_t codesize, size_t datasize) {
-        delete[] this->cdata;
-        delete[] this->ddata;
+    void memory::SetCustom(uint32_t opcode, cop handler) {
+        if ((opcode < OP_USR0) || (opcode > OP_USR9)) {
+            std::cerr << "SetCustom: " << std::hex << opcode << std::endl;
+            throw std::runtime_error("Invalid custom opcode");
+        }
+        this->cops[opcode - OP_USR0] = (handler != 0) ? handler : nocop;
+    }
 
-        this->cdata = new char[codesize];
+    void memory::NewImage(size_t codesize, size_t datasize) {
+        this->code.reset(segment::Reserve(codesize), [codesize](char* ptr) {
+            segment::Unreserve(ptr, codesize);
+        });
+        this->cfixed = false;
+        this->cdata = this->code.get();
         this->csize = codesize;
 
-        this->ddata = new char[datasize];
-        this->dsize = datasize;
+        this->data = segment(datasize);
+        this->ddata = this->data.Data();
+        this->dsize = this->data.Size();
+        this->dlimit = this->dsize;
+        this->stack = segment();
+        this->ssize = 0;
 
         for (int i = RZ; i < RTOTAL; ++i) {
             this->regs[i] = 0;
         }
+        this->iflags = 0;
+
+        this->whead = 0;
+        this->wcount = 0;
+        this->wspill.clear();
+
+        this->chkid = 0;
+        this->cchanged = false;
+        this->debug.reset();
 
-        for (size_t i = 0; i < ZHVM_CFUNC_ARRAY_SIZE; ++i) {
-            this->funcs[i] = none;
+        this->SetTable(StandardTable());
+        for (size_t i = 0; i < ZHVM_CUSTOM_TOTAL; ++i) {
+            this->cops[i] = nocop;
         }
     }
 
+    void memory::Reset(size_t codesize, size_t datasize) {
+        if (this->cfixed || (this->code.use_count() != 1) || (this->csize != codesize)) {
+            this->code.reset(segment::Reserve(codesize), [codesize](char* ptr) {
+                segment::Unreserve(ptr, codesize);
+            });
+            this->cfixed = false;
+            this->cdata = this->code.get();
+            this->csize = codesize;
+        } else {
+            memset(this->cdata, 0, this->csize);
+        }
+
+        // Data segment may be larger than requested, limit hides the rest
+        if (this->data.Size() < datasize) {
+            this->data = segment(datasize);
+        } else {
+            this->data.Reset();
+        }
+        this->ddata = this->data.Data();
+        this->dsize = datasize;
+        this->dlimit = datasize;
+        this->stack = segment();
+        this->ssize = 0;
+
+        for (int i = RZ; i < RTOTAL; ++i) {
+            this->regs[i] = 0;
+        }
+        this->sflag = 0;
+        this->iflags = this->funcs->Named() ? IF_IMPORTS : 0;
+
+        this->whead = 0;
+        this->wcount = 0;
+        this->wspill.clear();
+
+        this->chkid = 0;
+        this->cchanged = false;
+        this->debug.reset();
+    }
+
 
 }
@@ -0,0 +1,67 @@
+#include <zhvm.h>
+
+namespace zhvm {
+
+    namespace {
+
+        /**
+         * Data segment size class: power of two pages.
+         */
+        size_t SizeClass(size_t size) {
+            size_t result = ZHVM_PAGE_SIZE;
+            while ((result < size) && (result <= SIZE_MAX / 2)) {
+                result <<= 1;
+            }
+            return (result < size) ? size : result;
+        }
+
+    }
+
+    memory_pool::memory_pool(size_t keep) : idle(), keep(keep) {
+        ;
+    }
+
+    memory_pool::~memory_pool() {
+        for (std::map<size_class, std::vector<memory*> >::iterator it = this->idle.begin(); it != this->idle.end(); ++it) {
+            for (size_t i = 0; i < it->second.size(); ++i) {
+                delete it->second[i];
+            }
+        }
+    }
+
+    memory* memory_pool::Acquire(size_t codesize, size_t datasize) {
+        const size_t dclass = SizeClass(datasize);
+        std::vector<memory*>& cls = this->idle[size_class(codesize, dclass)];
+        if (cls.empty()) {
+            memory* result = new memory(codesize, dclass);
+            result->Reset(codesize, datasize);
+            return result;
+        }
+        memory* result = cls.back();
+        cls.pop_back();
+        result->Reset(codesize, datasize);
+        return result;
+    }
+
+    void memory_pool::Release(memory* mem) {
+        if (mem == 0) {
+            return;
+        }
+        // Data segment is at least as large as its limit
+        std::vector<memory*>& cls = this->idle[size_class(mem->CodeSize(), SizeClass(mem->DataLimit()))];
+        if (cls.size() < this->keep) {
+            cls.push_back(mem);
+        } else {
+            delete mem;
+        }
+    }
+
+    size_t memory_pool::Idle() const {
+        size_t result = 0;
+        for (std::map<size_class, std::vector<memory*> >::const_iterator it = this->idle.begin(); it != this->idle.end(); ++it) {
+            result += it->second.size();
+        }
+        return result;
+    }
+
+}
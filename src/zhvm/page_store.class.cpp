@@ -0,0 +1,52 @@
+#include <iostream>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <zhvm.h>
+
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+namespace zhvm {
+
+    page_store::page_store() : file(), pages(0), index() {
+#ifndef WIN32
+        int fd = segment::AnonymousFile();
+        if (fd < 0) {
+            throw std::runtime_error("Can't create page store");
+        }
+        this->file.reset(new int(fd), [](int* ptr) {
+            close(*ptr);
+            delete ptr;
+        });
+#endif
+    }
+
+    size_t page_store::Intern(const char* page) {
+#ifndef WIN32
+        const uint32_t hash = crc32c(0, page, ZHVM_PAGE_SIZE);
+        std::vector<char> stored(ZHVM_PAGE_SIZE);
+        auto range = this->index.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            const off_t offset = (off_t) it->second << ZHVM_PAGE_SHIFT;
+            if ((pread(*this->file, stored.data(), ZHVM_PAGE_SIZE, offset) == ZHVM_PAGE_SIZE) && (memcmp(stored.data(), page, ZHVM_PAGE_SIZE) == 0)) {
+                return it->second;
+            }
+        }
+
+        const off_t offset = (off_t) this->pages << ZHVM_PAGE_SHIFT;
+        if (pwrite(*this->file, page, ZHVM_PAGE_SIZE, offset) != ZHVM_PAGE_SIZE) {
+            std::cerr << "Intern: " << this->pages << std::endl;
+            throw std::runtime_error("Can't write page store");
+        }
+        this->index.insert(std::make_pair(hash, this->pages));
+        return this->pages++;
+#else
+        (void) page;
+        throw std::runtime_error("Page store is not supported");
+#endif
+    }
+
+}
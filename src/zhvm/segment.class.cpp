@@ -0,0 +1,523 @@
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <stdexcept>
+
+#include <zhvm.h>
+
+#ifndef WIN32
+#define ZHVM_SEGMENT_MMAP
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+#else
+#include <malloc.h>
+#endif
+
+namespace zhvm {
+
+    namespace {
+
+        /**
+         * Index of lowest set bit, bits must be non-zero.
+         */
+        inline size_t Lowest(uint64_t bits) {
+#if defined(__GNUC__)
+            return __builtin_ctzll(bits);
+#else
+            size_t result = 0;
+            while ((bits & 1) == 0) {
+                bits >>= 1;
+                ++result;
+            }
+            return result;
+#endif
+        }
+
+        segment_options allocation = {ZHVM_CACHE_LINE, 0};
+
+        /**
+         * Segment of given size uses huge pages.
+         */
+        inline bool HugePages(size_t size) {
+            return (allocation.hugepages != 0) && (size >= allocation.hugepages);
+        }
+
+    }
+
+#ifdef ZHVM_SEGMENT_MMAP
+
+    namespace {
+
+        int anonymous_file() {
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+            return memfd_create("zhvm", MFD_CLOEXEC);
+#else
+            char name[] = "/tmp/zhvm-XXXXXX";
+            int fd = mkstemp(name);
+            if (fd >= 0) {
+                unlink(name);
+            }
+            return fd;
+#endif
+        }
+
+        /**
+         * Descriptor closed with its last owner.
+         */
+        std::shared_ptr<int> shared_file(int fd) {
+            return std::shared_ptr<int>(new int(fd), [](int* ptr) {
+                close(*ptr);
+                delete ptr;
+            });
+        }
+
+    }
+
+#endif
+
+    char* segment::Reserve(size_t size) {
+        if (size == 0) {
+            return 0;
+        }
+        const size_t align = HugePages(size) ? std::max<size_t>(allocation.align, ZHVM_HUGE_PAGE_SIZE) : allocation.align;
+#ifdef ZHVM_SEGMENT_MMAP
+        // Mapping is page aligned, larger alignment needs extra room to trim
+        const size_t host = sysconf(_SC_PAGESIZE);
+        const size_t extra = (align > host) ? align : 0;
+        void* result = mmap(0, size + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (result == MAP_FAILED) {
+            std::cerr << "Reserve: " << size << std::endl;
+            throw std::runtime_error("Segment allocation failed");
+        }
+
+        char* ptr = (char*) result;
+        if (extra != 0) {
+            char* start = (char*) (((uintptr_t) ptr + align - 1) & ~(uintptr_t) (align - 1));
+            char* end = start + ((size + host - 1) & ~(host - 1));
+            if (start != ptr) {
+                munmap(ptr, start - ptr);
+            }
+            if (end != ptr + size + extra) {
+                munmap(end, ptr + size + extra - end);
+            }
+            ptr = start;
+        }
+#ifdef MADV_HUGEPAGE
+        if (HugePages(size)) {
+            madvise(ptr, size, MADV_HUGEPAGE);
+        }
+#endif
+        return ptr;
+#else
+        char* result = (char*) _aligned_malloc(size, align);
+        if (result == 0) {
+            std::cerr << "Reserve: " << size << std::endl;
+            throw std::runtime_error("Segment allocation failed");
+        }
+        memset(result, 0, size);
+        return result;
+#endif
+    }
+
+    void segment::Unreserve(char* ptr, size_t size) {
+        if (ptr == 0) {
+            return;
+        }
+#ifdef ZHVM_SEGMENT_MMAP
+        munmap(ptr, size);
+#else
+        (void) size;
+        _aligned_free(ptr);
+#endif
+    }
+
+    void segment::SetOptions(const segment_options& options) {
+        if ((options.align == 0) || ((options.align & (options.align - 1)) != 0)) {
+            std::cerr << "SetOptions: " << options.align << std::endl;
+            throw std::runtime_error("Invalid segment alignment");
+        }
+        allocation = options;
+    }
+
+    segment_options segment::Options() {
+        return allocation;
+    }
+
+    segment::segment() : data(0), size(0), base(), boffset(0), blen(0), dirty(), changed(), files() {
+        ;
+    }
+
+    segment::segment(size_t size) : data(0), size(0), base(), boffset(0), blen(0), dirty(), changed(), files() {
+        this->Allocate(size);
+    }
+
+#ifdef ZHVM_SEGMENT_MMAP
+
+    segment::segment(int fd, size_t offset, size_t size) : data(0), size(0), base(), boffset(0), blen(0), dirty(), changed(), files() {
+        const size_t pages = (size + ZHVM_PAGE_SIZE - 1) >> ZHVM_PAGE_SHIFT;
+        this->dirty.assign((pages + 63) / 64, 0);
+        this->changed.assign(this->dirty.size(), 0);
+        if (size == 0) {
+            return;
+        }
+
+        void* result = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_NORESERVE, fd, offset);
+        if (result == MAP_FAILED) {
+            std::cerr << "Map: " << offset << " [" << size << "]" << std::endl;
+            throw std::runtime_error("Can't map data segment");
+        }
+        this->data = (char*) result;
+        this->size = size;
+        int copy = dup(fd);
+        if (copy < 0) {
+            std::cerr << "Map: " << fd << std::endl;
+            throw std::runtime_error("Can't duplicate data segment file");
+        }
+        this->base = shared_file(copy);
+        this->boffset = offset;
+        this->blen = size;
+    }
+
+#endif
+
+    segment::segment(const segment& copy) : data(0), size(0), base(), boffset(0), blen(0), dirty(), changed(), files() {
+        this->Allocate(copy.size);
+        memcpy(this->data, copy.data, this->size);
+        this->CopyDirty(copy);
+    }
+
+    segment::segment(const segment& copy, size_t offset, size_t len) : data(0), size(0), base(), boffset(0), blen(0), dirty(), changed(), files() {
+        this->Allocate(copy.size);
+        this->Touch(offset, len);
+        memcpy(this->data + offset, copy.data + offset, len);
+        this->changed = copy.changed;
+    }
+
+    segment::segment(segment&& mv) : data(mv.data), size(mv.size), base(std::move(mv.base)), boffset(mv.boffset), blen(mv.blen), dirty(std::move(mv.dirty)), changed(std::move(mv.changed)), files(std::move(mv.files)) {
+        mv.data = 0;
+        mv.size = 0;
+    }
+
+    segment& segment::operator=(const segment& src) {
+        if (this != &src) {
+            this->Release();
+            this->Allocate(src.size);
+            memcpy(this->data, src.data, this->size);
+            this->CopyDirty(src);
+        }
+        return *this;
+    }
+
+    segment& segment::operator=(segment&& src) {
+        if (this != &src) {
+            this->Release();
+            this->data = src.data;
+            this->size = src.size;
+            this->base = std::move(src.base);
+            this->boffset = src.boffset;
+            this->blen = src.blen;
+            this->dirty = std::move(src.dirty);
+            this->changed = std::move(src.changed);
+            this->files = std::move(src.files);
+
+            src.data = 0;
+            src.size = 0;
+        }
+        return *this;
+    }
+
+    segment::~segment() {
+        this->Release();
+    }
+
+    void segment::Allocate(size_t size) {
+        const size_t pages = (size + ZHVM_PAGE_SIZE - 1) >> ZHVM_PAGE_SHIFT;
+        this->dirty.assign((pages + 63) / 64, 0);
+        this->changed.assign(this->dirty.size(), 0);
+        this->size = size;
+        if (size == 0) {
+            return;
+        }
+        try {
+            this->data = Reserve(size);
+        } catch (...) {
+            this->size = 0;
+            throw;
+        }
+    }
+
+    void segment::CopyDirty(const segment& copy) {
+        // Pages from base or host files are not in dirty bitmap of copy
+        if (!copy.base && copy.files.empty()) {
+            this->dirty = copy.dirty;
+        } else {
+            this->Touch(0, this->size);
+        }
+        this->changed = copy.changed;
+    }
+
+    void segment::Release() {
+        Unreserve(this->data, this->size);
+        this->files.clear();
+        this->data = 0;
+        this->size = 0;
+        this->base.reset();
+        this->boffset = 0;
+        this->blen = 0;
+        this->dirty.clear();
+        this->changed.clear();
+    }
+
+    void segment::Freeze() {
+#ifdef ZHVM_SEGMENT_MMAP
+        int fd = anonymous_file();
+        if ((fd < 0) || (ftruncate(fd, this->size) != 0)) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            std::cerr << "Freeze: " << this->size << std::endl;
+            throw std::runtime_error("Can't create data segment base");
+        }
+        std::shared_ptr<int> file = shared_file(fd);
+
+        // Pages never written are zero, file holes keep them
+        for (size_t word = 0; word < this->dirty.size(); ++word) {
+            for (uint64_t bits = this->dirty[word]; bits != 0; bits &= bits - 1) {
+                const size_t offset = ((word << 6) + Lowest(bits)) << ZHVM_PAGE_SHIFT;
+                const size_t len = std::min<size_t>(ZHVM_PAGE_SIZE, this->size - offset);
+                if (pwrite(fd, this->data + offset, len, offset) != (ssize_t) len) {
+                    std::cerr << "Freeze: " << offset << std::endl;
+                    throw std::runtime_error("Can't create data segment base");
+                }
+            }
+        }
+
+        // Same address, but pages now come from base file
+        void* result = mmap(this->data, this->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED | MAP_NORESERVE, fd, 0);
+        if (result == MAP_FAILED) {
+            throw std::runtime_error("Can't map data segment base");
+        }
+
+        // Host files stay over base, their written pages are restored from it
+        std::vector<uint64_t> kept(this->dirty.size(), 0);
+        for (size_t i = 0; i < this->files.size(); ++i) {
+            const file_range& range = this->files[i];
+            result = mmap(this->data + range.offset, range.len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED | MAP_NORESERVE, *range.file, range.foffset);
+            if (result == MAP_FAILED) {
+                throw std::runtime_error("Can't map host file");
+            }
+            const size_t last = (range.offset + range.len - 1) >> ZHVM_PAGE_SHIFT;
+            for (size_t page = range.offset >> ZHVM_PAGE_SHIFT; page <= last; ++page) {
+                if (this->dirty[page >> 6] & (1ull << (page & 63))) {
+                    const size_t offset = page << ZHVM_PAGE_SHIFT;
+                    const size_t len = std::min<size_t>(ZHVM_PAGE_SIZE, this->size - offset);
+                    if (pread(fd, this->data + offset, len, offset) != (ssize_t) len) {
+                        throw std::runtime_error("Can't map data segment base");
+                    }
+                    kept[page >> 6] |= 1ull << (page & 63);
+                }
+            }
+        }
+
+        this->base = file;
+        this->boffset = 0;
+        this->blen = this->size;
+        this->dirty = std::move(kept);
+#endif
+    }
+
+#ifdef ZHVM_SEGMENT_MMAP
+
+    void segment::Clone(segment* child, size_t size) const {
+        segment result;
+        result.data = Reserve(size);
+        result.size = size;
+        result.dirty = this->dirty;
+        result.changed = this->changed;
+        result.dirty.resize((((size + ZHVM_PAGE_SIZE - 1) >> ZHVM_PAGE_SHIFT) + 63) / 64, 0);
+        result.changed.resize(result.dirty.size(), 0);
+
+        void* mapped = mmap(result.data, this->blen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED | MAP_NORESERVE, *this->base, this->boffset);
+        if (mapped == MAP_FAILED) {
+            throw std::runtime_error("Can't map data segment base");
+        }
+        result.base = this->base;
+        result.boffset = this->boffset;
+        result.blen = this->blen;
+
+        // Last base page may hold file bytes past segment end
+        const size_t tail = std::min<size_t>(size, (this->blen + ZHVM_PAGE_SIZE - 1) & ~(size_t) (ZHVM_PAGE_SIZE - 1));
+        if (tail > this->blen) {
+            result.Touch(this->blen, tail - this->blen);
+            memset(result.data + this->blen, 0, tail - this->blen);
+        }
+
+        // Host files cover base, child maps them at same place
+        for (size_t i = 0; i < this->files.size(); ++i) {
+            const file_range& range = this->files[i];
+            mapped = mmap(result.data + range.offset, range.len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED | MAP_NORESERVE, *range.file, range.foffset);
+            if (mapped == MAP_FAILED) {
+                throw std::runtime_error("Can't map host file");
+            }
+            result.files.push_back(range);
+        }
+
+        // Base file holds everything except pages written after it was created
+        for (size_t word = 0; word < this->dirty.size(); ++word) {
+            for (uint64_t bits = this->dirty[word]; bits != 0; bits &= bits - 1) {
+                const size_t offset = ((word << 6) + Lowest(bits)) << ZHVM_PAGE_SHIFT;
+                memcpy(result.data + offset, this->data + offset, std::min<size_t>(ZHVM_PAGE_SIZE, this->size - offset));
+            }
+        }
+
+        *child = std::move(result);
+    }
+
+#endif
+
+    void segment::Fork(segment* child) {
+        if (child == this) {
+            return;
+        }
+#ifdef ZHVM_SEGMENT_MMAP
+        if (this->size == 0) {
+            *child = segment();
+            return;
+        }
+
+        if (!this->base) {
+            this->Freeze();
+        }
+        this->Clone(child, this->size);
+#else
+        *child = *this;
+#endif
+    }
+
+    void segment::Resize(size_t size) {
+        if (size <= this->size) {
+            return;
+        }
+        if (this->size == 0) {
+            *this = segment(size);
+            return;
+        }
+#ifdef ZHVM_SEGMENT_MMAP
+        if (!this->base) {
+            // Only written pages and host files are copied, no base is needed
+            segment result(size);
+            for (size_t i = 0; i < this->files.size(); ++i) {
+                const file_range& range = this->files[i];
+                result.MapRange(range.file, range.offset, range.len, range.foffset);
+            }
+            for (size_t word = 0; word < this->dirty.size(); ++word) {
+                for (uint64_t bits = this->dirty[word]; bits != 0; bits &= bits - 1) {
+                    const size_t offset = ((word << 6) + Lowest(bits)) << ZHVM_PAGE_SHIFT;
+                    const size_t len = std::min<size_t>(ZHVM_PAGE_SIZE, this->size - offset);
+                    result.Touch(offset, len);
+                    memcpy(result.data + offset, this->data + offset, len);
+                }
+            }
+            result.changed = this->changed;
+            result.changed.resize(result.dirty.size(), 0);
+            *this = std::move(result);
+            return;
+        }
+        segment result;
+        this->Clone(&result, size);
+        *this = std::move(result);
+#else
+        segment result(size);
+        memcpy(result.data, this->data, this->size);
+        result.changed = this->changed;
+        result.changed.resize(result.dirty.size(), 0);
+        *this = std::move(result);
+#endif
+    }
+
+    void segment::Reset() {
+        if (this->base || !this->files.empty()) {
+            // Pages come from files, forget them
+            *this = segment(this->size);
+            return;
+        }
+        for (size_t word = 0; word < this->dirty.size(); ++word) {
+            for (uint64_t bits = this->dirty[word]; bits != 0; bits &= bits - 1) {
+                const size_t offset = ((word << 6) + Lowest(bits)) << ZHVM_PAGE_SHIFT;
+                memset(this->data + offset, 0, std::min<size_t>(ZHVM_PAGE_SIZE, this->size - offset));
+            }
+        }
+        std::fill(this->dirty.begin(), this->dirty.end(), 0);
+        std::fill(this->changed.begin(), this->changed.end(), 0);
+    }
+
+#ifdef ZHVM_SEGMENT_MMAP
+
+    int segment::AnonymousFile() {
+        return anonymous_file();
+    }
+
+    void segment::MapRange(const std::shared_ptr<int>& file, size_t offset, size_t len, size_t foffset) {
+        const size_t host = sysconf(_SC_PAGESIZE);
+        if ((offset % ZHVM_PAGE_SIZE != 0) || (offset % host != 0) || (foffset % host != 0) || (offset > this->size) || (len > this->size - offset)) {
+            std::cerr << "MapFile: " << offset << " [" << len << "]" << std::endl;
+            throw std::runtime_error("Invalid host file range");
+        }
+        if (len == 0) {
+            return;
+        }
+
+        void* result = mmap(this->data + offset, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED | MAP_NORESERVE, *file, foffset);
+        if (result == MAP_FAILED) {
+            std::cerr << "MapFile: " << offset << " [" << len << "]" << std::endl;
+            throw std::runtime_error("Can't map host file");
+        }
+        file_range range = {offset, len, foffset, file};
+        this->files.push_back(range);
+
+        // File is base of its pages
+        const size_t last = (offset + len - 1) >> ZHVM_PAGE_SHIFT;
+        for (size_t page = offset >> ZHVM_PAGE_SHIFT; page <= last; ++page) {
+            this->dirty[page >> 6] &= ~(1ull << (page & 63));
+        }
+    }
+
+    void segment::MapFile(int fd, size_t offset, size_t len) {
+        int copy = dup(fd);
+        if (copy < 0) {
+            std::cerr << "MapFile: " << fd << std::endl;
+            throw std::runtime_error("Can't duplicate host file");
+        }
+        this->MapRange(shared_file(copy), offset, len, 0);
+
+        // Pages are new since checkpoint
+        const size_t last = (offset + len - 1) >> ZHVM_PAGE_SHIFT;
+        for (size_t page = offset >> ZHVM_PAGE_SHIFT; (len != 0) && (page <= last); ++page) {
+            this->changed[page >> 6] |= 1ull << (page & 63);
+        }
+    }
+
+    void segment::Share(const std::shared_ptr<int>& file, size_t offset, size_t len, size_t foffset) {
+        this->MapRange(file, offset, len, foffset);
+    }
+
+#endif
+
+    void segment::ChangedPages(std::vector<uint32_t>* pages) const {
+        pages->clear();
+        for (size_t word = 0; word < this->changed.size(); ++word) {
+            for (uint64_t bits = this->changed[word]; bits != 0; bits &= bits - 1) {
+                pages->push_back((uint32_t) ((word << 6) + Lowest(bits)));
+            }
+        }
+    }
+
+    void segment::ClearChanged() {
+        std::fill(this->changed.begin(), this->changed.end(), 0);
+    }
+
+}
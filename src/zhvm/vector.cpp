@@ -0,0 +1,627 @@
+/**
+ * @file vector.cpp
+ * @author marko
+ *
+ * Vector kernels. Scalar loops handle every operation, SSE2, SSE4.1 and
+ * SSE4.2 kernels are compiled with target attributes and selected at run
+ * time, so they are used even when whole library is built without -msse2.
+ */
+
+#include <stdexcept>
+#include <zhvm.h>
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define ZHVM_VECTOR_SSE
+#include <nmmintrin.h>
+#endif
+
+namespace {
+
+    /**
+     * Scalar operations. Arithmetic is done in unsigned 64-bit to get
+     * wrap-around semantics for every element width.
+     */
+    template <typename T>
+    struct op_add {
+
+        static T apply(T a, T b) {
+            return (T) ((uint64_t) a + (uint64_t) b);
+        }
+    };
+
+    template <typename T>
+    struct op_mul {
+
+        static T apply(T a, T b) {
+            return (T) ((uint64_t) a * (uint64_t) b);
+        }
+    };
+
+    template <typename T>
+    struct op_min {
+
+        static T apply(T a, T b) {
+            return (a < b) ? a : b;
+        }
+    };
+
+    template <typename T>
+    struct op_max {
+
+        static T apply(T a, T b) {
+            return (a > b) ? a : b;
+        }
+    };
+
+    typedef size_t(*map_kernel)(void* dst, const void* src, size_t count);
+    typedef int64_t(*sum_kernel)(const void* src, size_t count);
+    typedef int64_t(*dot_kernel)(const void* src0, const void* src1, size_t count);
+
+    /**
+     * Element-wise map without SIMD part.
+     */
+    size_t map_none(void* dst, const void* src, size_t count) {
+        return 0;
+    }
+
+    /**
+     * Element-wise map. SIMD kernel is used only when ranges are identical or
+     * do not overlap, otherwise result must match scalar in-order semantics.
+     */
+    template <typename T, template <typename> class OP>
+    void vmap(map_kernel simd, void* dst, const void* src, size_t count) {
+        T* d = (T*) dst;
+        const T* s = (const T*) src;
+        size_t i = 0;
+
+        if ((d == s) || (d + count <= s) || (s + count <= d)) {
+            i = simd(dst, src, count);
+        }
+
+        for (; i < count; ++i) {
+            d[i] = OP<T>::apply(d[i], s[i]);
+        }
+    }
+
+    template <typename T>
+    int64_t vsum(const void* src, size_t count) {
+        const T* s = (const T*) src;
+        uint64_t result = 0;
+        for (size_t i = 0; i < count; ++i) {
+            result += (uint64_t) (int64_t) s[i];
+        }
+        return (int64_t) result;
+    }
+
+    template <typename T>
+    int64_t vdot(const void* src0, const void* src1, size_t count) {
+        const T* a = (const T*) src0;
+        const T* b = (const T*) src1;
+        uint64_t result = 0;
+        for (size_t i = 0; i < count; ++i) {
+            result += (uint64_t) (int64_t) a[i] * (uint64_t) (int64_t) b[i];
+        }
+        return (int64_t) result;
+    }
+
+#ifdef ZHVM_VECTOR_SSE
+
+#define ZHVM_SSE2 __attribute__((target("sse2")))
+#define ZHVM_SSE41 __attribute__((target("sse4.1")))
+#define ZHVM_SSE42 __attribute__((target("sse4.2")))
+
+    /**
+     * SIMD lanes: operation over whole 16-byte block.
+     */
+    struct lane_add8 {
+
+        ZHVM_SSE2 static __m128i apply(__m128i a, __m128i b) {
+            return _mm_add_epi8(a, b);
+        }
+    };
+
+    struct lane_add16 {
+
+        ZHVM_SSE2 static __m128i apply(__m128i a, __m128i b) {
+            return _mm_add_epi16(a, b);
+        }
+    };
+
+    struct lane_add32 {
+
+        ZHVM_SSE2 static __m128i apply(__m128i a, __m128i b) {
+            return _mm_add_epi32(a, b);
+        }
+    };
+
+    struct lane_add64 {
+
+        ZHVM_SSE2 static __m128i apply(__m128i a, __m128i b) {
+            return _mm_add_epi64(a, b);
+        }
+    };
+
+    struct lane_mul8 {
+
+        ZHVM_SSE2 static __m128i apply(__m128i a, __m128i b) {
+            // Low byte of 16-bit product depends only on low bytes of factors
+            __m128i even = _mm_mullo_epi16(a, b);
+            __m128i odd = _mm_mullo_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+            return _mm_or_si128(_mm_slli_epi16(odd, 8), _mm_and_si128(even, _mm_set1_epi16(0xFF)));
+        }
+    };
+
+    struct lane_mul16 {
+
+        ZHVM_SSE2 static __m128i apply(__m128i a, __m128i b) {
+            return _mm_mullo_epi16(a, b);
+        }
+    };
+
+    struct lane_mul32 {
+
+        ZHVM_SSE2 static __m128i apply(__m128i a, __m128i b) {
+            __m128i even = _mm_mul_epu32(a, b);
+            __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+            return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+        }
+    };
+
+    struct lane_mul32_sse41 {
+
+        ZHVM_SSE41 static __m128i apply(__m128i a, __m128i b) {
+            return _mm_mullo_epi32(a, b);
+        }
+    };
+
+    struct lane_mul64 {
+
+        ZHVM_SSE2 static __m128i apply(__m128i a, __m128i b) {
+            // Low 64 bits: lo * lo + ((hi * lo + lo * hi) << 32)
+            __m128i cross = _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), b), _mm_mul_epu32(a, _mm_srli_epi64(b, 32)));
+            return _mm_add_epi64(_mm_mul_epu32(a, b), _mm_slli_epi64(cross, 32));
+        }
+    };
+
+    struct lane_min8 {
+
+        ZHVM_SSE2 static __m128i apply(__m128i a, __m128i b) {
+            // Signed bytes compared as unsigned after sign bit flip
+            const __m128i sign = _mm_set1_epi8((char) 0x80);
+            return _mm_xor_si128(_mm_min_epu8(_mm_xor_si128(a, sign), _mm_xor_si128(b, sign)), sign);
+        }
+    };
+
+    struct lane_min8_sse41 {
+
+        ZHVM_SSE41 static __m128i apply(__m128i a, __m128i b) {
+            return _mm_min_epi8(a, b);
+        }
+    };
+
+    struct lane_min16 {
+
+        ZHVM_SSE2 static __m128i apply(__m128i a, __m128i b) {
+            return _mm_min_epi16(a, b);
+        }
+    };
+
+    struct lane_min32 {
+
+        ZHVM_SSE2 static __m128i apply(__m128i a, __m128i b) {
+            __m128i gt = _mm_cmpgt_epi32(a, b);
+            return _mm_or_si128(_mm_and_si128(gt, b), _mm_andnot_si128(gt, a));
+        }
+    };
+
+    struct lane_min32_sse41 {
+
+        ZHVM_SSE41 static __m128i apply(__m128i a, __m128i b) {
+            return _mm_min_epi32(a, b);
+        }
+    };
+
+    struct lane_min64 {
+
+        ZHVM_SSE42 static __m128i apply(__m128i a, __m128i b) {
+            return _mm_blendv_epi8(a, b, _mm_cmpgt_epi64(a, b));
+        }
+    };
+
+    struct lane_max8 {
+
+        ZHVM_SSE2 static __m128i apply(__m128i a, __m128i b) {
+            const __m128i sign = _mm_set1_epi8((char) 0x80);
+            return _mm_xor_si128(_mm_max_epu8(_mm_xor_si128(a, sign), _mm_xor_si128(b, sign)), sign);
+        }
+    };
+
+    struct lane_max8_sse41 {
+
+        ZHVM_SSE41 static __m128i apply(__m128i a, __m128i b) {
+            return _mm_max_epi8(a, b);
+        }
+    };
+
+    struct lane_max16 {
+
+        ZHVM_SSE2 static __m128i apply(__m128i a, __m128i b) {
+            return _mm_max_epi16(a, b);
+        }
+    };
+
+    struct lane_max32 {
+
+        ZHVM_SSE2 static __m128i apply(__m128i a, __m128i b) {
+            __m128i gt = _mm_cmpgt_epi32(a, b);
+            return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+        }
+    };
+
+    struct lane_max32_sse41 {
+
+        ZHVM_SSE41 static __m128i apply(__m128i a, __m128i b) {
+            return _mm_max_epi32(a, b);
+        }
+    };
+
+    struct lane_max64 {
+
+        ZHVM_SSE42 static __m128i apply(__m128i a, __m128i b) {
+            return _mm_blendv_epi8(b, a, _mm_cmpgt_epi64(a, b));
+        }
+    };
+
+    /**
+     * Process whole 16-byte blocks with SIMD lane. Target attribute can't be
+     * template parameter, so kernel is defined for every instruction set,
+     * lane must not need more than kernel target.
+     *
+     * @return number of processed elements
+     */
+#define ZHVM_MAP_KERNEL(NAME, TARGET) \
+    template <typename T, typename LANE> \
+    TARGET size_t NAME(void* dst, const void* src, size_t count) { \
+        T* d = (T*) dst; \
+        const T* s = (const T*) src; \
+        const size_t step = sizeof (__m128i) / sizeof (T); \
+        size_t i = 0; \
+        for (; i + step <= count; i += step) { \
+            __m128i a = _mm_loadu_si128((const __m128i*) (d + i)); \
+            __m128i b = _mm_loadu_si128((const __m128i*) (s + i)); \
+            _mm_storeu_si128((__m128i*) (d + i), LANE::apply(a, b)); \
+        } \
+        return i; \
+    }
+
+    ZHVM_MAP_KERNEL(map_sse2, ZHVM_SSE2)
+    ZHVM_MAP_KERNEL(map_sse41, ZHVM_SSE41)
+    ZHVM_MAP_KERNEL(map_sse42, ZHVM_SSE42)
+
+#undef ZHVM_MAP_KERNEL
+
+    /**
+     * Sign extend low and high 32-bit halves of block to 64-bit lanes and
+     * add them to accumulator.
+     */
+    ZHVM_SSE2 inline __m128i add_widen32(__m128i acc, __m128i v) {
+        const __m128i sign = _mm_srai_epi32(v, 31);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, sign));
+        return _mm_add_epi64(acc, _mm_unpackhi_epi32(v, sign));
+    }
+
+    /**
+     * Sign extend bytes of block to 16-bit lanes.
+     */
+    ZHVM_SSE2 inline void widen8(__m128i v, __m128i* lo, __m128i* hi) {
+        const __m128i sign = _mm_cmpgt_epi8(_mm_setzero_si128(), v);
+        *lo = _mm_unpacklo_epi8(v, sign);
+        *hi = _mm_unpackhi_epi8(v, sign);
+    }
+
+    /**
+     * Sum of 64-bit accumulator lanes.
+     */
+    ZHVM_SSE2 inline uint64_t total64(__m128i acc) {
+        uint64_t lanes[2];
+        _mm_storeu_si128((__m128i*) lanes, acc);
+        return lanes[0] + lanes[1];
+    }
+
+    // Bytes are biased to unsigned, summed by psadbw and unbiased at the end
+    ZHVM_SSE2 int64_t sum8_sse2(const void* src, size_t count) {
+        const int8_t* s = (const int8_t*) src;
+        const __m128i sign = _mm_set1_epi8((char) 0x80);
+        __m128i acc = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (s + i)), sign);
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(v, _mm_setzero_si128()));
+        }
+        uint64_t result = total64(acc) - 128 * (uint64_t) i;
+        for (; i < count; ++i) {
+            result += (uint64_t) (int64_t) s[i];
+        }
+        return (int64_t) result;
+    }
+
+    // Pairs of 16-bit elements fit in 32-bit sums
+    ZHVM_SSE2 int64_t sum16_sse2(const void* src, size_t count) {
+        const int16_t* s = (const int16_t*) src;
+        const __m128i ones = _mm_set1_epi16(1);
+        __m128i acc = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            acc = add_widen32(acc, _mm_madd_epi16(_mm_loadu_si128((const __m128i*) (s + i)), ones));
+        }
+        uint64_t result = total64(acc);
+        for (; i < count; ++i) {
+            result += (uint64_t) (int64_t) s[i];
+        }
+        return (int64_t) result;
+    }
+
+    ZHVM_SSE2 int64_t sum32_sse2(const void* src, size_t count) {
+        const int32_t* s = (const int32_t*) src;
+        __m128i acc = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            acc = add_widen32(acc, _mm_loadu_si128((const __m128i*) (s + i)));
+        }
+        uint64_t result = total64(acc);
+        for (; i < count; ++i) {
+            result += (uint64_t) (int64_t) s[i];
+        }
+        return (int64_t) result;
+    }
+
+    ZHVM_SSE2 int64_t sum64_sse2(const void* src, size_t count) {
+        const int64_t* s = (const int64_t*) src;
+        __m128i acc = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 2 <= count; i += 2) {
+            acc = _mm_add_epi64(acc, _mm_loadu_si128((const __m128i*) (s + i)));
+        }
+        uint64_t result = total64(acc);
+        for (; i < count; ++i) {
+            result += (uint64_t) s[i];
+        }
+        return (int64_t) result;
+    }
+
+    /**
+     * Full 32-bit products of 16-bit lanes, sign extended into accumulator.
+     * Products of widened bytes are exact in 16 bits, but pairs of them are
+     * not, so they are widened the same way.
+     */
+    ZHVM_SSE2 inline __m128i dot_widen16(__m128i acc, __m128i a, __m128i b) {
+        const __m128i lo = _mm_mullo_epi16(a, b);
+        const __m128i hi = _mm_mulhi_epi16(a, b);
+        acc = add_widen32(acc, _mm_unpacklo_epi16(lo, hi));
+        return add_widen32(acc, _mm_unpackhi_epi16(lo, hi));
+    }
+
+    ZHVM_SSE2 int64_t dot8_sse2(const void* src0, const void* src1, size_t count) {
+        const int8_t* a = (const int8_t*) src0;
+        const int8_t* b = (const int8_t*) src1;
+        __m128i acc = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m128i alo, ahi, blo, bhi;
+            widen8(_mm_loadu_si128((const __m128i*) (a + i)), &alo, &ahi);
+            widen8(_mm_loadu_si128((const __m128i*) (b + i)), &blo, &bhi);
+            acc = dot_widen16(acc, alo, blo);
+            acc = dot_widen16(acc, ahi, bhi);
+        }
+        uint64_t result = total64(acc);
+        for (; i < count; ++i) {
+            result += (uint64_t) (int64_t) a[i] * (uint64_t) (int64_t) b[i];
+        }
+        return (int64_t) result;
+    }
+
+    ZHVM_SSE2 int64_t dot16_sse2(const void* src0, const void* src1, size_t count) {
+        const int16_t* a = (const int16_t*) src0;
+        const int16_t* b = (const int16_t*) src1;
+        __m128i acc = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            acc = dot_widen16(acc, _mm_loadu_si128((const __m128i*) (a + i)), _mm_loadu_si128((const __m128i*) (b + i)));
+        }
+        uint64_t result = total64(acc);
+        for (; i < count; ++i) {
+            result += (uint64_t) (int64_t) a[i] * (uint64_t) (int64_t) b[i];
+        }
+        return (int64_t) result;
+    }
+
+    // Signed 32x32->64 multiply of even lanes
+    ZHVM_SSE41 int64_t dot32_sse41(const void* src0, const void* src1, size_t count) {
+        const int32_t* a = (const int32_t*) src0;
+        const int32_t* b = (const int32_t*) src1;
+        __m128i acc = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128i va = _mm_loadu_si128((const __m128i*) (a + i));
+            __m128i vb = _mm_loadu_si128((const __m128i*) (b + i));
+            acc = _mm_add_epi64(acc, _mm_mul_epi32(va, vb));
+            acc = _mm_add_epi64(acc, _mm_mul_epi32(_mm_srli_epi64(va, 32), _mm_srli_epi64(vb, 32)));
+        }
+        uint64_t result = total64(acc);
+        for (; i < count; ++i) {
+            result += (uint64_t) (int64_t) a[i] * (uint64_t) (int64_t) b[i];
+        }
+        return (int64_t) result;
+    }
+
+    ZHVM_SSE2 int64_t dot64_sse2(const void* src0, const void* src1, size_t count) {
+        const int64_t* a = (const int64_t*) src0;
+        const int64_t* b = (const int64_t*) src1;
+        __m128i acc = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 2 <= count; i += 2) {
+            acc = _mm_add_epi64(acc, lane_mul64::apply(_mm_loadu_si128((const __m128i*) (a + i)), _mm_loadu_si128((const __m128i*) (b + i))));
+        }
+        uint64_t result = total64(acc);
+        for (; i < count; ++i) {
+            result += (uint64_t) a[i] * (uint64_t) b[i];
+        }
+        return (int64_t) result;
+    }
+
+#undef ZHVM_SSE42
+#undef ZHVM_SSE41
+#undef ZHVM_SSE2
+
+#endif // ZHVM_VECTOR_SSE
+
+    /**
+     * Kernels for every operation and element width, index is log2 of
+     * width. Filled once with best kernels host CPU supports.
+     */
+    struct vector_kernels {
+        map_kernel add[4];
+        map_kernel mul[4];
+        map_kernel min[4];
+        map_kernel max[4];
+        sum_kernel sum[4];
+        dot_kernel dot[4];
+
+        vector_kernels() {
+            for (int i = 0; i < 4; ++i) {
+                this->add[i] = map_none;
+                this->mul[i] = map_none;
+                this->min[i] = map_none;
+                this->max[i] = map_none;
+            }
+            this->sum[0] = vsum<int8_t>;
+            this->sum[1] = vsum<int16_t>;
+            this->sum[2] = vsum<int32_t>;
+            this->sum[3] = vsum<int64_t>;
+            this->dot[0] = vdot<int8_t>;
+            this->dot[1] = vdot<int16_t>;
+            this->dot[2] = vdot<int32_t>;
+            this->dot[3] = vdot<int64_t>;
+
+#ifdef ZHVM_VECTOR_SSE
+            __builtin_cpu_init();
+
+            if (__builtin_cpu_supports("sse2")) {
+                this->add[0] = map_sse2<int8_t, lane_add8>;
+                this->add[1] = map_sse2<int16_t, lane_add16>;
+                this->add[2] = map_sse2<int32_t, lane_add32>;
+                this->add[3] = map_sse2<int64_t, lane_add64>;
+                this->mul[0] = map_sse2<int8_t, lane_mul8>;
+                this->mul[1] = map_sse2<int16_t, lane_mul16>;
+                this->mul[2] = map_sse2<int32_t, lane_mul32>;
+                this->mul[3] = map_sse2<int64_t, lane_mul64>;
+                this->min[0] = map_sse2<int8_t, lane_min8>;
+                this->min[1] = map_sse2<int16_t, lane_min16>;
+                this->min[2] = map_sse2<int32_t, lane_min32>;
+                this->max[0] = map_sse2<int8_t, lane_max8>;
+                this->max[1] = map_sse2<int16_t, lane_max16>;
+                this->max[2] = map_sse2<int32_t, lane_max32>;
+                this->sum[0] = sum8_sse2;
+                this->sum[1] = sum16_sse2;
+                this->sum[2] = sum32_sse2;
+                this->sum[3] = sum64_sse2;
+                this->dot[0] = dot8_sse2;
+                this->dot[1] = dot16_sse2;
+                this->dot[3] = dot64_sse2;
+            }
+
+            if (__builtin_cpu_supports("sse4.1")) {
+                this->mul[2] = map_sse41<int32_t, lane_mul32_sse41>;
+                this->min[0] = map_sse41<int8_t, lane_min8_sse41>;
+                this->min[2] = map_sse41<int32_t, lane_min32_sse41>;
+                this->max[0] = map_sse41<int8_t, lane_max8_sse41>;
+                this->max[2] = map_sse41<int32_t, lane_max32_sse41>;
+                this->dot[2] = dot32_sse41;
+            }
+
+            if (__builtin_cpu_supports("sse4.2")) {
+                this->min[3] = map_sse42<int64_t, lane_min64>;
+                this->max[3] = map_sse42<int64_t, lane_max64>;
+            }
+#endif
+        }
+    };
+
+    const vector_kernels& Kernels() {
+        static const vector_kernels kernels;
+        return kernels;
+    }
+
+    /**
+     * Kernel table index for element width.
+     */
+    int WidthIndex(size_t width) {
+        switch (width) {
+            case sizeof (int8_t):
+                return 0;
+            case sizeof (int16_t):
+                return 1;
+            case sizeof (int32_t):
+                return 2;
+            case sizeof (int64_t):
+                return 3;
+        }
+        throw std::runtime_error("Invalid vector width");
+    }
+
+    template <template <typename> class OP>
+    void VecMap(const map_kernel* simd, void* dst, const void* src, size_t count, size_t width) {
+        const int index = WidthIndex(width);
+        switch (index) {
+            case 0:
+                return vmap<int8_t, OP>(simd[index], dst, src, count);
+            case 1:
+                return vmap<int16_t, OP>(simd[index], dst, src, count);
+            case 2:
+                return vmap<int32_t, OP>(simd[index], dst, src, count);
+            default:
+                return vmap<int64_t, OP>(simd[index], dst, src, count);
+        }
+    }
+
+}
+
+namespace zhvm {
+
+    bool VecWidth(size_t width) {
+        switch (width) {
+            case sizeof (int8_t):
+            case sizeof (int16_t):
+            case sizeof (int32_t):
+            case sizeof (int64_t):
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    void VecAdd(void* dst, const void* src, size_t count, size_t width) {
+        VecMap<op_add>(Kernels().add, dst, src, count, width);
+    }
+
+    void VecMul(void* dst, const void* src, size_t count, size_t width) {
+        VecMap<op_mul>(Kernels().mul, dst, src, count, width);
+    }
+
+    void VecMin(void* dst, const void* src, size_t count, size_t width) {
+        VecMap<op_min>(Kernels().min, dst, src, count, width);
+    }
+
+    void VecMax(void* dst, const void* src, size_t count, size_t width) {
+        VecMap<op_max>(Kernels().max, dst, src, count, width);
+    }
+
+    int64_t VecSum(const void* src, size_t count, size_t width) {
+        return Kernels().sum[WidthIndex(width)](src, count);
+    }
+
+    int64_t VecDot(const void* src0, const void* src1, size_t count, size_t width) {
+        return Kernels().dot[WidthIndex(width)](src0, src1, count);
+    }
+
+}
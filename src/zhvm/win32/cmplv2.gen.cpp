@@ -12,7 +12,7 @@
  #define isatty(a) (0)
  
 
-#line 14 "/home/timur/projects/zhvm/stage/src/zhvm/cmplv2.gen.cpp"
+#line 13 "/home/timur/projects/zhvm/stage/src/zhvm/cmplv2.gen.cpp"
 
 #define  YY_INT_ALIGNED short int
 
@@ -26,6 +26,46 @@
 #define FLEX_BETA
 #endif
 
+#define yy_create_buffer cmplv2_create_buffer
+#define yy_delete_buffer cmplv2_delete_buffer
+#define yy_scan_buffer cmplv2_scan_buffer
+#define yy_scan_string cmplv2_scan_string
+#define yy_scan_bytes cmplv2_scan_bytes
+#define yy_init_buffer cmplv2_init_buffer
+#define yy_flush_buffer cmplv2_flush_buffer
+#define yy_load_buffer_state cmplv2_load_buffer_state
+#define yy_switch_to_buffer cmplv2_switch_to_buffer
+#define yypush_buffer_state cmplv2push_buffer_state
+#define yypop_buffer_state cmplv2pop_buffer_state
+#define yyensure_buffer_stack cmplv2ensure_buffer_stack
+#define yylex cmplv2lex
+#define yyrestart cmplv2restart
+#define yylex_init cmplv2lex_init
+#define yylex_init_extra cmplv2lex_init_extra
+#define yylex_destroy cmplv2lex_destroy
+#define yyget_debug cmplv2get_debug
+#define yyset_debug cmplv2set_debug
+#define yyget_extra cmplv2get_extra
+#define yyset_extra cmplv2set_extra
+#define yyget_in cmplv2get_in
+#define yyset_in cmplv2set_in
+#define yyget_out cmplv2get_out
+#define yyset_out cmplv2set_out
+#define yyget_leng cmplv2get_leng
+#define yyget_text cmplv2get_text
+#define yyget_lineno cmplv2get_lineno
+#define yyset_lineno cmplv2set_lineno
+#define yyget_column cmplv2get_column
+#define yyset_column cmplv2set_column
+#define yywrap cmplv2wrap
+#define yyget_lval cmplv2get_lval
+#define yyset_lval cmplv2set_lval
+#define yyget_lloc cmplv2get_lloc
+#define yyset_lloc cmplv2set_lloc
+#define yyalloc cmplv2alloc
+#define yyrealloc cmplv2realloc
+#define yyfree cmplv2free
+
 /* First, we deal with  platform-specific or compiler-specific issues. */
 
 /* begin standard C headers. */
@@ -366,7 +406,7 @@ void yyfree (void * ,yyscan_t yyscanner );
 
 /* Begin user sect3 */
 
-#define yywrap(yyscanner) (/*CONSTCOND*/1)
+#define cmplv2wrap(yyscanner) (/*CONSTCOND*/1)
 #define YY_SKIP_YYWRAP
 
 typedef unsigned char YY_CHAR;
@@ -393,8 +433,8 @@ static void yy_fatal_error (yyconst char msg[] ,yyscan_t yyscanner );
 	*yy_cp = '\0'; \
 	yyg->yy_c_buf_p = yy_cp;
 
-#define YY_NUM_RULES 28
-#define YY_END_OF_BUFFER 29
+#define YY_NUM_RULES 31
+#define YY_END_OF_BUFFER 32
 /* This struct is not used in this scanner,
    but its presence is necessary. */
 struct yy_trans_info
@@ -402,15 +442,17 @@ struct yy_trans_info
 	flex_int32_t yy_verify;
 	flex_int32_t yy_nxt;
 	};
-static yyconst flex_int16_t yy_accept[64] =
+static yyconst flex_int16_t yy_accept[89] =
     {   0,
-        0,    0,    0,    0,   27,   27,    0,    0,   17,   17,
-       29,   14,   10,   13,    2,    1,   11,    8,   12,    9,
-        9,    5,    4,    3,    6,    7,   16,   28,   15,   27,
-       26,   22,   24,   25,   20,   23,   23,   21,   21,   18,
-       17,   10,    9,    9,    0,    3,   27,   22,   23,   23,
-        0,   21,   21,   18,   17,    9,   23,   21,   21,   21,
-       21,   19,    0
+        0,    0,    0,    0,   30,   30,    0,    0,   19,   19,
+       32,   16,   12,   15,    2,    1,   13,    8,   14,   10,
+       10,    5,    4,    3,    6,    7,   16,   18,   31,   17,
+       30,   29,   24,   27,   28,   22,   31,   26,   26,   23,
+       23,   20,   19,   12,    0,   10,    9,    0,   10,    0,
+        3,    0,   11,   30,   24,    0,    0,   26,   25,    0,
+       26,    0,   23,   23,   20,   19,    9,    0,    9,   10,
+       10,   25,    0,   25,   26,   26,   23,    0,    0,   23,
+        0,    9,    0,   25,   23,   23,   21,    0
     } ;
 
 static yyconst YY_CHAR yy_ec[256] =
@@ -419,16 +461,16 @@ static yyconst YY_CHAR yy_ec[256] =
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    2,    4,    1,    5,    6,    1,    1,    1,    1,
-        1,    1,    7,    8,    7,    1,    1,    9,   10,   10,
-       10,   10,   10,   10,   10,   10,   11,    1,    1,    1,
-       12,    1,    1,   13,   14,   14,   14,   14,   15,   15,
-       15,   15,   15,   15,   15,   16,   15,   15,   15,   14,
-       16,   15,   17,   15,   15,   15,   15,   15,   15,   14,
-       18,    1,   19,    1,    1,    1,   14,   14,   20,   21,
-
-       22,   15,   15,   15,   23,   15,   15,   24,   15,   25,
-       15,   14,   16,   15,   17,   15,   26,   15,   15,   27,
-       15,   14,    1,    1,    1,    1,    1,    1,    1,    1,
+        1,    1,    7,    8,    7,    9,    1,   10,   11,   11,
+       11,   11,   11,   11,   11,   11,   12,    1,    1,    1,
+       13,    1,    1,   14,   15,   15,   15,   16,   17,   18,
+       18,   18,   18,   18,   18,   19,   18,   18,   18,   15,
+       19,   18,   20,   18,   18,   18,   18,   18,   18,   15,
+       21,    1,   22,    1,   18,    1,   15,   15,   23,   24,
+
+       25,   18,   18,   18,   26,   18,   18,   27,   18,   28,
+       18,   15,   19,   18,   20,   18,   29,   18,   18,   30,
+       18,   15,   31,    1,   32,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
@@ -445,86 +487,271 @@ static yyconst YY_CHAR yy_ec[256] =
         1,    1,    1,    1,    1
     } ;
 
-static yyconst YY_CHAR yy_meta[28] =
+static yyconst YY_CHAR yy_meta[33] =
     {   0,
-        1,    2,    3,    1,    1,    1,    1,    1,    4,    4,
-        4,    1,    1,    4,    4,    4,    4,    1,    1,    4,
-        4,    4,    4,    4,    4,    4,    4
+        1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
+        1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
+        1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
+        1,    1
     } ;
 
-static yyconst flex_uint16_t yy_base[71] =
+static yyconst flex_uint16_t yy_base[89] =
     {   0,
-        0,    0,   25,   44,  112,  107,   65,    0,   27,   29,
-      109,  151,  105,  151,  151,  151,  151,  151,  151,   84,
-       79,  151,  151,    0,  151,  151,  151,  151,  151,    0,
-      151,  103,  151,  151,  151,  103,   77,    0,   78,    0,
-      100,   97,   71,   20,   39,    0,    0,   95,   69,   35,
-       46,    0,   43,    0,   60,    0,    0,   36,   17,   20,
-       18,    0,  151,  130,  134,  138,   34,  142,   29,  146
+        0,   32,   64,   96,  128,  160,  192,  224,  256,  288,
+      967,  967,  319,  967,  967,  967,  967,  967,  967,  313,
+      335,  967,  967,  353,  967,  967,  383,  967,  967,  967,
+      415,  967,  324,  967,  967,  967,  324,  439,  461,  479,
+      500,  530,  325,  326,  338,  554,  967,  346,  347,  442,
+      572,  602,  967,  634,  329,  658,  450,  668,  967,  472,
+      448,  557,  686,  707,  737,  337,  760,  565,  763,  770,
+      782,  794,  661,  804,  811,  815,  833,  679,  857,  860,
+      881,  884,  887,  891,  894,  915,  936,  967
     } ;
 
-static yyconst flex_int16_t yy_def[71] =
+static yyconst flex_int16_t yy_def[89] =
     {   0,
-       63,    1,   64,   64,   65,   65,   63,    7,   66,   66,
-       63,   63,   63,   63,   63,   63,   63,   63,   63,   63,
-       20,   63,   63,   67,   63,   63,   63,   63,   63,   68,
-       63,   63,   63,   63,   63,   63,   36,   69,   69,   70,
-       63,   63,   20,   63,   63,   67,   68,   63,   36,   63,
-       63,   69,   69,   70,   63,   20,   36,   69,   69,   69,
-       69,   69,    0,   63,   63,   63,   63,   63,   63,   63
+       88,   88,   88,   88,   88,   88,   88,   88,   88,   88,
+       88,   88,   88,   88,   88,   88,   88,   88,   88,   88,
+       88,   88,   88,   88,   88,   88,   88,   88,   88,   88,
+       88,   88,   88,   88,   88,   88,   88,   88,   88,   88,
+       88,   88,   88,   88,   88,   88,   88,   88,   88,   88,
+       88,   88,   88,   88,   88,   88,   88,   88,   88,   88,
+       88,   88,   88,   88,   88,   88,   88,   88,   88,   88,
+       88,   88,   88,   88,   88,   88,   88,   88,   88,   88,
+       88,   88,   88,   88,   88,   88,   88,    0
     } ;
 
-static yyconst flex_uint16_t yy_nxt[179] =
+static yyconst flex_uint16_t yy_nxt[1000] =
     {   0,
-       12,   13,   14,   15,   16,   17,   18,   19,   20,   21,
-       21,   22,   23,   24,   24,   24,   24,   25,   26,   24,
-       24,   24,   24,   24,   24,   24,   24,   28,   41,   28,
-       41,   28,   52,   29,   29,   44,   44,   46,   29,   62,
-       61,   29,   60,   44,   29,   29,   28,   56,   43,   43,
-       50,   50,   29,   29,   57,   49,   49,   29,   50,   59,
-       29,   55,   58,   29,   29,   28,   32,   33,   28,   34,
-       35,   28,   28,   36,   37,   37,   28,   28,   38,   38,
-       38,   38,   28,   28,   38,   38,   38,   39,   38,   38,
-       38,   38,   43,   43,   43,   63,   48,   63,   42,   44,
-
-       44,   55,   53,   63,   48,   63,   42,   44,   63,   31,
-       45,   49,   49,   49,   31,   63,   63,   63,   50,   50,
-       63,   63,   63,   63,   63,   63,   50,   63,   63,   51,
-       27,   27,   27,   27,   30,   30,   30,   30,   40,   40,
-       40,   40,   47,   47,   63,   47,   54,   63,   63,   54,
-       11,   63,   63,   63,   63,   63,   63,   63,   63,   63,
-       63,   63,   63,   63,   63,   63,   63,   63,   63,   63,
-       63,   63,   63,   63,   63,   63,   63,   63
+       12,   13,   14,   15,   16,   17,   18,   19,   12,   20,
+       21,   21,   22,   23,   24,   24,   24,   24,   24,   24,
+       25,   26,   24,   24,   24,   24,   24,   24,   24,   24,
+       27,   12,   12,   13,   14,   15,   16,   17,   18,   19,
+       12,   20,   21,   21,   22,   23,   24,   24,   24,   24,
+       24,   24,   25,   26,   24,   24,   24,   24,   24,   24,
+       24,   24,   27,   12,   28,   28,   29,   28,   28,   28,
+       28,   28,   28,   30,   30,   28,   28,   28,   30,   30,
+       28,   28,   28,   30,   28,   28,   30,   30,   28,   28,
+       28,   28,   28,   28,   28,   28,   28,   28,   29,   28,
+
+       28,   28,   28,   28,   28,   30,   30,   28,   28,   28,
+       30,   30,   28,   28,   28,   30,   28,   28,   30,   30,
+       28,   28,   28,   28,   28,   28,   28,   28,   31,   31,
+       32,   31,   31,   31,   31,   31,   31,   31,   31,   31,
+       31,   31,   31,   31,   31,   31,   31,   31,   31,   31,
+       31,   31,   31,   31,   31,   31,   31,   31,   31,   31,
+       31,   31,   32,   31,   31,   31,   31,   31,   31,   31,
+       31,   31,   31,   31,   31,   31,   31,   31,   31,   31,
+       31,   31,   31,   31,   31,   31,   31,   31,   31,   31,
+       31,   31,   29,   33,   34,   29,   35,   36,   37,   29,
+
+       29,   38,   39,   39,   29,   29,   40,   40,   40,   40,
+       40,   40,   29,   29,   40,   40,   40,   41,   40,   40,
+       40,   40,   29,   29,   29,   33,   34,   29,   35,   36,
+       37,   29,   29,   38,   39,   39,   29,   29,   40,   40,
+       40,   40,   40,   40,   29,   29,   40,   40,   40,   41,
+       40,   40,   40,   40,   29,   29,   42,   43,   29,   42,
+       42,   42,   42,   42,   42,   42,   42,   42,   42,   42,
+       42,   42,   42,   42,   42,   42,   42,   42,   42,   42,
+       42,   42,   42,   42,   42,   42,   42,   42,   42,   43,
+       29,   42,   42,   42,   42,   42,   42,   42,   42,   42,
+
+       42,   42,   42,   42,   42,   42,   42,   42,   42,   42,
+       42,   42,   42,   42,   42,   42,   42,   42,   42,   42,
+       44,   45,   46,   46,   46,   55,   66,   44,   47,   48,
+       55,   49,   49,   56,   56,   56,   47,   48,   66,   49,
+        0,    0,   50,   45,   46,   46,   46,   67,   67,   67,
+       47,   48,   68,   49,   49,   69,   69,   69,   47,   48,
+        0,   49,   51,   51,   51,   49,   49,   51,   51,   51,
+       51,   51,   51,   49,    0,   51,   51,   51,   51,   51,
+       51,   51,   51,   52,   52,    0,   52,   52,   52,   52,
+       52,   52,   52,   52,   52,   52,   52,   52,   52,   52,
+
+       52,   52,   52,   52,   52,   52,   52,   52,   52,   52,
+       52,   52,   52,   52,   53,   54,   54,    0,   54,   54,
+       54,   54,   54,   54,   54,   54,   54,   54,   54,   54,
+       54,   54,   54,   54,   54,   54,   54,   54,   54,   54,
+       54,   54,   54,   54,   54,   54,   54,   57,   58,   58,
+       58,   70,   71,   71,   59,   60,    0,   61,   61,   72,
+       72,   72,   59,   60,    0,   61,   61,   61,   62,   57,
+       58,   58,   58,    0,   61,    0,   59,   60,   73,   61,
+       61,   74,   74,   74,   59,   60,    0,   61,   63,   63,
+       63,    0,    0,   63,   63,   63,   63,   63,   63,    0,
+
+        0,   63,   63,   63,   63,   63,   63,   63,   63,   63,
+       63,   63,    0,    0,   63,   63,   63,   63,   63,   63,
+        0,    0,   63,   63,   63,   63,   63,   64,   63,   63,
+       65,    0,    0,   65,   65,   65,   65,   65,   65,   65,
+       65,   65,   65,   65,   65,   65,   65,   65,   65,   65,
+       65,   65,   65,   65,   65,   65,   65,   65,   65,   65,
+       65,   65,   45,   46,   46,   46,   75,   76,   76,   47,
+       48,    0,   49,   49,   69,   69,   69,   47,   48,    0,
+       49,   51,   51,   51,    0,    0,   51,   51,   51,   51,
+       51,   51,    0,    0,   51,   51,   51,   51,   51,   51,
+
+       51,   51,   52,   52,    0,   52,   52,   52,   52,   52,
+       52,   52,   52,   52,   52,   52,   52,   52,   52,   52,
+       52,   52,   52,   52,   52,   52,   52,   52,   52,   52,
+       52,   52,   52,   53,   54,   54,    0,   54,   54,   54,
+       54,   54,   54,   54,   54,   54,   54,   54,   54,   54,
+       54,   54,   54,   54,   54,   54,   54,   54,   54,   54,
+       54,   54,   54,   54,   54,   54,   57,   56,   56,   56,
+       74,   74,   74,   59,   60,    0,   57,   58,   58,   58,
+        0,   59,   60,   59,   60,   81,   61,   61,   82,   82,
+       82,   59,   60,    0,   61,   63,   63,   63,    0,    0,
+
+       63,   63,   63,   63,   63,   63,    0,    0,   63,   63,
+       63,   63,   63,   63,   63,   63,   63,   63,   63,    0,
+        0,   63,   63,   63,   63,   63,   63,    0,    0,   77,
+       63,   63,   63,   63,   63,   63,   63,   65,    0,    0,
+       65,   65,   65,   65,   65,   65,   65,   65,   65,   65,
+       65,   65,   65,   65,   65,   65,   65,   65,   65,   65,
+       65,   65,   65,   65,   65,   65,   65,   65,   65,   67,
+       67,   67,   69,   69,   69,   47,   78,    0,   47,   71,
+       71,   71,    0,   47,   78,    0,   47,    0,   49,   49,
+        0,   71,   71,   71,    0,    0,   49,    0,    0,   50,
+
+       49,   49,    0,   72,   72,   72,    0,    0,   49,   59,
+       79,    0,    0,   74,   74,   74,    0,   59,   79,   59,
+       76,   76,   76,    0,   76,   76,   76,   59,    0,   61,
+       61,    0,    0,   61,   61,    0,    0,   61,    0,    0,
+       62,   61,   63,   63,   63,    0,    0,   63,   63,   63,
+       63,   63,   63,    0,    0,   63,   63,   63,   63,   80,
+       63,   63,   63,   83,    0,    0,   84,   84,   84,   63,
+       63,   63,    0,    0,   63,   63,   63,   63,   63,   63,
+        0,    0,   63,   63,   63,   63,   63,   63,   85,   63,
+       82,   82,   82,   82,   82,   82,   84,   84,   84,   47,
+
+       84,   84,   84,   63,   63,   63,   59,   47,   63,   63,
+       63,   63,   63,   63,   59,    0,   63,   86,   63,   63,
+       63,   63,   63,   63,   63,   63,   63,    0,    0,   63,
+       63,   63,   63,   63,   63,    0,    0,   63,   63,   87,
+       63,   63,   63,   63,   63,   63,   63,   63,    0,    0,
+       63,   63,   63,   63,   63,   63,    0,    0,   63,   63,
+       63,   63,   63,   63,   63,   63,   11,   88,   88,   88,
+       88,   88,   88,   88,   88,   88,   88,   88,   88,   88,
+       88,   88,   88,   88,   88,   88,   88,   88,   88,   88,
+       88,   88,   88,   88,   88,   88,   88,   88,   88
     } ;
 
-static yyconst flex_int16_t yy_chk[179] =
+static yyconst flex_int16_t yy_chk[1000] =
     {   0,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
-        1,    1,    1,    1,    1,    1,    1,    3,    9,    9,
-       10,   10,   69,    3,    3,   44,   44,   67,    3,   61,
-       60,    3,   59,   44,    3,    3,    4,   45,   45,   45,
-       50,   50,    4,    4,   51,   51,   51,    4,   50,   58,
-        4,   55,   53,    4,    4,    7,    7,    7,    7,    7,
+        1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
+        1,    1,    2,    2,    2,    2,    2,    2,    2,    2,
+        2,    2,    2,    2,    2,    2,    2,    2,    2,    2,
+        2,    2,    2,    2,    2,    2,    2,    2,    2,    2,
+        2,    2,    2,    2,    3,    3,    3,    3,    3,    3,
+        3,    3,    3,    3,    3,    3,    3,    3,    3,    3,
+        3,    3,    3,    3,    3,    3,    3,    3,    3,    3,
+        3,    3,    3,    3,    3,    3,    4,    4,    4,    4,
+
+        4,    4,    4,    4,    4,    4,    4,    4,    4,    4,
+        4,    4,    4,    4,    4,    4,    4,    4,    4,    4,
+        4,    4,    4,    4,    4,    4,    4,    4,    5,    5,
+        5,    5,    5,    5,    5,    5,    5,    5,    5,    5,
+        5,    5,    5,    5,    5,    5,    5,    5,    5,    5,
+        5,    5,    5,    5,    5,    5,    5,    5,    5,    5,
+        6,    6,    6,    6,    6,    6,    6,    6,    6,    6,
+        6,    6,    6,    6,    6,    6,    6,    6,    6,    6,
+        6,    6,    6,    6,    6,    6,    6,    6,    6,    6,
+        6,    6,    7,    7,    7,    7,    7,    7,    7,    7,
+
         7,    7,    7,    7,    7,    7,    7,    7,    7,    7,
         7,    7,    7,    7,    7,    7,    7,    7,    7,    7,
-        7,    7,   20,   20,   20,   49,   48,   43,   42,   20,
-
-       20,   41,   39,   37,   32,   21,   13,   20,   11,    6,
-       20,   36,   36,   36,    5,    0,    0,    0,   36,   36,
-        0,    0,    0,    0,    0,    0,   36,    0,    0,   36,
-       64,   64,   64,   64,   65,   65,   65,   65,   66,   66,
-       66,   66,   68,   68,    0,   68,   70,    0,    0,   70,
-       63,   63,   63,   63,   63,   63,   63,   63,   63,   63,
-       63,   63,   63,   63,   63,   63,   63,   63,   63,   63,
-       63,   63,   63,   63,   63,   63,   63,   63
+        7,    7,    7,    7,    8,    8,    8,    8,    8,    8,
+        8,    8,    8,    8,    8,    8,    8,    8,    8,    8,
+        8,    8,    8,    8,    8,    8,    8,    8,    8,    8,
+        8,    8,    8,    8,    8,    8,    9,    9,    9,    9,
+        9,    9,    9,    9,    9,    9,    9,    9,    9,    9,
+        9,    9,    9,    9,    9,    9,    9,    9,    9,    9,
+        9,    9,    9,    9,    9,    9,    9,    9,   10,   10,
+       10,   10,   10,   10,   10,   10,   10,   10,   10,   10,
+
+       10,   10,   10,   10,   10,   10,   10,   10,   10,   10,
+       10,   10,   10,   10,   10,   10,   10,   10,   10,   10,
+       13,   20,   20,   20,   20,   33,   43,   44,   20,   20,
+       55,   20,   20,   37,   37,   37,   20,   20,   66,   20,
+        0,    0,   20,   21,   21,   21,   21,   45,   45,   45,
+       21,   21,   48,   21,   21,   48,   48,   48,   21,   21,
+        0,   21,   24,   24,   24,   49,   49,   24,   24,   24,
+       24,   24,   24,   49,    0,   24,   24,   24,   24,   24,
+       24,   24,   24,   27,   27,    0,   27,   27,   27,   27,
+       27,   27,   27,   27,   27,   27,   27,   27,   27,   27,
+
+       27,   27,   27,   27,   27,   27,   27,   27,   27,   27,
+       27,   27,   27,   27,   27,   31,   31,    0,   31,   31,
+       31,   31,   31,   31,   31,   31,   31,   31,   31,   31,
+       31,   31,   31,   31,   31,   31,   31,   31,   31,   31,
+       31,   31,   31,   31,   31,   31,   31,   38,   38,   38,
+       38,   50,   50,   50,   38,   38,    0,   38,   38,   57,
+       57,   57,   38,   38,    0,   38,   61,   61,   38,   39,
+       39,   39,   39,    0,   61,    0,   39,   39,   60,   39,
+       39,   60,   60,   60,   39,   39,    0,   39,   40,   40,
+       40,    0,    0,   40,   40,   40,   40,   40,   40,    0,
+
+        0,   40,   40,   40,   40,   40,   40,   40,   40,   41,
+       41,   41,    0,    0,   41,   41,   41,   41,   41,   41,
+        0,    0,   41,   41,   41,   41,   41,   41,   41,   41,
+       42,    0,    0,   42,   42,   42,   42,   42,   42,   42,
+       42,   42,   42,   42,   42,   42,   42,   42,   42,   42,
+       42,   42,   42,   42,   42,   42,   42,   42,   42,   42,
+       42,   42,   46,   46,   46,   46,   62,   62,   62,   46,
+       46,    0,   46,   46,   68,   68,   68,   46,   46,    0,
+       46,   51,   51,   51,    0,    0,   51,   51,   51,   51,
+       51,   51,    0,    0,   51,   51,   51,   51,   51,   51,
+
+       51,   51,   52,   52,    0,   52,   52,   52,   52,   52,
+       52,   52,   52,   52,   52,   52,   52,   52,   52,   52,
+       52,   52,   52,   52,   52,   52,   52,   52,   52,   52,
+       52,   52,   52,   52,   54,   54,    0,   54,   54,   54,
+       54,   54,   54,   54,   54,   54,   54,   54,   54,   54,
+       54,   54,   54,   54,   54,   54,   54,   54,   54,   54,
+       54,   54,   54,   54,   54,   54,   56,   56,   56,   56,
+       73,   73,   73,   56,   56,    0,   58,   58,   58,   58,
+        0,   56,   56,   58,   58,   78,   58,   58,   78,   78,
+       78,   58,   58,    0,   58,   63,   63,   63,    0,    0,
+
+       63,   63,   63,   63,   63,   63,    0,    0,   63,   63,
+       63,   63,   63,   63,   63,   63,   64,   64,   64,    0,
+        0,   64,   64,   64,   64,   64,   64,    0,    0,   64,
+       64,   64,   64,   64,   64,   64,   64,   65,    0,    0,
+       65,   65,   65,   65,   65,   65,   65,   65,   65,   65,
+       65,   65,   65,   65,   65,   65,   65,   65,   65,   65,
+       65,   65,   65,   65,   65,   65,   65,   65,   65,   67,
+       67,   67,   69,   69,   69,   67,   67,    0,   69,   70,
+       70,   70,    0,   67,   67,    0,   69,    0,   70,   70,
+        0,   71,   71,   71,    0,    0,   70,    0,    0,   70,
+
+       71,   71,    0,   72,   72,   72,    0,    0,   71,   72,
+       72,    0,    0,   74,   74,   74,    0,   72,   72,   74,
+       75,   75,   75,    0,   76,   76,   76,   74,    0,   75,
+       75,    0,    0,   76,   76,    0,    0,   75,    0,    0,
+       75,   76,   77,   77,   77,    0,    0,   77,   77,   77,
+       77,   77,   77,    0,    0,   77,   77,   77,   77,   77,
+       77,   77,   77,   79,    0,    0,   79,   79,   79,   80,
+       80,   80,    0,    0,   80,   80,   80,   80,   80,   80,
+        0,    0,   80,   80,   80,   80,   80,   80,   80,   80,
+       81,   81,   81,   82,   82,   82,   83,   83,   83,   82,
+
+       84,   84,   84,   85,   85,   85,   84,   82,   85,   85,
+       85,   85,   85,   85,   84,    0,   85,   85,   85,   85,
+       85,   85,   85,   85,   86,   86,   86,    0,    0,   86,
+       86,   86,   86,   86,   86,    0,    0,   86,   86,   86,
+       86,   86,   86,   86,   86,   87,   87,   87,    0,    0,
+       87,   87,   87,   87,   87,   87,    0,    0,   87,   87,
+       87,   87,   87,   87,   87,   87,   88,   88,   88,   88,
+       88,   88,   88,   88,   88,   88,   88,   88,   88,   88,
+       88,   88,   88,   88,   88,   88,   88,   88,   88,   88,
+       88,   88,   88,   88,   88,   88,   88,   88,   88
     } ;
 
 /* Table of booleans, true if rule could match eol. */
-static yyconst flex_int32_t yy_rule_can_match_eol[29] =
+static yyconst flex_int32_t yy_rule_can_match_eol[33] =
     {   0,
-0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 
-    0, 0, 0, 0, 1, 0, 1, 0, 0,     };
+0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 
+    0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0,     };
 
 /* The intent behind this definition is that it'll catch
  * any uses of REJECT which flex missed.
@@ -538,6 +765,18 @@ static yyconst flex_int32_t yy_rule_can_match_eol[29] =
 #line 19 "cmplv2.lex"
 
 #include <zhvm.h>
+
+/**
+ * Token type for flex
+ */
+#define YYSTYPE zhvm::token_v2
+
+/**
+ * Location type for flex
+ */
+#define YYLTYPE zhvm::location
+
+
 #include <zhvm/cmplv2.h>
 
 #define YY_USER_ACTION *yylloc = yylineno;
@@ -551,7 +790,7 @@ int include_stack_top = 0;
 
 
 
-#line 553 "/home/timur/projects/zhvm/stage/src/zhvm/cmplv2.gen.cpp"
+#line 791 "/home/timur/projects/zhvm/stage/src/zhvm/cmplv2.gen.cpp"
 
 #define INITIAL 0
 #define REGISTER 1
@@ -846,10 +1085,10 @@ YY_DECL
 		}
 
 	{
-#line 53 "cmplv2.lex"
+#line 70 "cmplv2.lex"
 
 
-#line 851 "/home/timur/projects/zhvm/stage/src/zhvm/cmplv2.gen.cpp"
+#line 1089 "/home/timur/projects/zhvm/stage/src/zhvm/cmplv2.gen.cpp"
 
 	while ( /*CONSTCOND*/1 )		/* loops until end-of-file is reached */
 		{
@@ -876,13 +1115,13 @@ yy_match:
 			while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 				{
 				yy_current_state = (int) yy_def[yy_current_state];
-				if ( yy_current_state >= 64 )
+				if ( yy_current_state >= 89 )
 					yy_c = yy_meta[(unsigned int) yy_c];
 				}
 			yy_current_state = yy_nxt[yy_base[yy_current_state] + (unsigned int) yy_c];
 			++yy_cp;
 			}
-		while ( yy_base[yy_current_state] != 151 );
+		while ( yy_base[yy_current_state] != 967 );
 
 yy_find_action:
 		yy_act = yy_accept[yy_current_state];
@@ -920,7 +1159,7 @@ do_action:	/* This label is used only to access EOF actions. */
 
 case 1:
 YY_RULE_SETUP
-#line 57 "cmplv2.lex"
+#line 74 "cmplv2.lex"
 
                   // IGNORE EVERYTHING FROM # TO EOL
                   BEGIN(COMMENT_STATE);
@@ -928,7 +1167,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 2:
 YY_RULE_SETUP
-#line 62 "cmplv2.lex"
+#line 79 "cmplv2.lex"
 
                   BEGIN(MACRO_STATE);
                   yylval->type = zhvm::TT2_MACRO;
@@ -937,7 +1176,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 3:
 YY_RULE_SETUP
-#line 68 "cmplv2.lex"
+#line 85 "cmplv2.lex"
 
                   yylval->type = zhvm::TT2_WORD;
                   yylval->opr.assign(yytext);
@@ -946,7 +1185,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 4:
 YY_RULE_SETUP
-#line 74 "cmplv2.lex"
+#line 91 "cmplv2.lex"
 
                   yylval->type = zhvm::TT2_AT;
                   return zhvm::TT2_AT;
@@ -954,7 +1193,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 5:
 YY_RULE_SETUP
-#line 79 "cmplv2.lex"
+#line 96 "cmplv2.lex"
 
                   yylval->type= zhvm::TT2_SET;
                   return zhvm::TT2_SET;
@@ -962,7 +1201,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 6:
 YY_RULE_SETUP
-#line 84 "cmplv2.lex"
+#line 101 "cmplv2.lex"
 
                   yylval->type = zhvm::TT2_OPEN;
                   return zhvm::TT2_OPEN;
@@ -970,7 +1209,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 7:
 YY_RULE_SETUP
-#line 89 "cmplv2.lex"
+#line 106 "cmplv2.lex"
 
                   yylval->type = zhvm::TT2_CLOSE;
                   return zhvm::TT2_CLOSE;
@@ -978,7 +1217,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 8:
 YY_RULE_SETUP
-#line 94 "cmplv2.lex"
+#line 111 "cmplv2.lex"
 
                   switch (yytext[0]){
                     case '+':
@@ -992,7 +1231,17 @@ YY_RULE_SETUP
 	YY_BREAK
 case 9:
 YY_RULE_SETUP
-#line 105 "cmplv2.lex"
+#line 122 "cmplv2.lex"
+
+                  // DOUBLE IS STORED AS ITS BIT PATTERN
+                  yylval->num = zhvm::DoubleToReg(strtod(yytext, 0));
+                  yylval->type = zhvm::TT2_NUMBER_DOUBLE;
+                  return zhvm::TT2_NUMBER_DOUBLE;
+
+	YY_BREAK
+case 10:
+YY_RULE_SETUP
+#line 129 "cmplv2.lex"
 
                   {
                     char* end = yytext;
@@ -1022,50 +1271,66 @@ YY_RULE_SETUP
                   }
 
 	YY_BREAK
-case 10:
+case 11:
 YY_RULE_SETUP
-#line 134 "cmplv2.lex"
+#line 158 "cmplv2.lex"
+
+                  // REGISTER LIST IS A BITMASK NUMBER
+                  yylval->num = zhvm::GetRegisterMask(yytext);
+                  if (yylval->num < 0) {
+                    yylval->type = zhvm::TT2_ERROR;
+                    ERROR_MSG("%s: %s", "UNEXPECTED REGISTER LIST", yytext);
+                    return zhvm::TT2_ERROR;
+                  }
+                  yylval->type = zhvm::TT2_NUMBER_SHORT;
+                  return zhvm::TT2_NUMBER_SHORT;
+
+	YY_BREAK
+case 12:
+YY_RULE_SETUP
+#line 170 "cmplv2.lex"
 
                   // DO NOTHING
 
 	YY_BREAK
-case 11:
+case 13:
 YY_RULE_SETUP
-#line 138 "cmplv2.lex"
+#line 174 "cmplv2.lex"
 yy_push_state(REGISTER,  yyscanner);
 	YY_BREAK
-case 12:
+case 14:
 YY_RULE_SETUP
-#line 140 "cmplv2.lex"
+#line 176 "cmplv2.lex"
 
                   yylval->type = zhvm::TT2_COMMA;
                   return zhvm::TT2_COMMA;
 
 	YY_BREAK
-case 13:
-/* rule 13 can match eol */
+case 15:
+/* rule 15 can match eol */
 YY_RULE_SETUP
-#line 145 "cmplv2.lex"
+#line 181 "cmplv2.lex"
 
 
 
 	YY_BREAK
 case YY_STATE_EOF(INITIAL):
-#line 149 "cmplv2.lex"
+#line 185 "cmplv2.lex"
 
                    if ( -- include_stack_top < 0){
                      yyterminate();
                    } else {
-                     yy_delete_buffer(YY_CURRENT_BUFFER,yyscanner);
-                     yy_switch_to_buffer(include_stack[include_stack_top] ,yyscanner
+                     yy_delete_buffer(YY_CURRENT_BUFFER, yyscanner);
+                     yy_switch_to_buffer(
+                       include_stack[include_stack_top] , yyscanner
                      );
                      BEGIN(MACRO_STATE);
                    }
 
 	YY_BREAK
-case 14:
+case 16:
 YY_RULE_SETUP
-#line 161 "cmplv2.lex"
+#line 197 "cmplv2.lex"
 
                   yylval->type = zhvm::TT2_ERROR;
                   yylval->num = yytext[0];
@@ -1074,10 +1339,9 @@ YY_RULE_SETUP
 
 	YY_BREAK
 
-
-case 15:
+case 17:
 YY_RULE_SETUP
-#line 172 "cmplv2.lex"
+#line 208 "cmplv2.lex"
 
                   yy_pop_state(yyscanner);
                   switch (yytext[0]){
@@ -1135,9 +1399,9 @@ YY_RULE_SETUP
                   return zhvm::TT2_REG;
 
 	YY_BREAK
-case 16:
+case 18:
 YY_RULE_SETUP
-#line 229 "cmplv2.lex"
+#line 265 "cmplv2.lex"
 
                   yy_pop_state(yyscanner);
                   yylval->type = zhvm::TT2_ERROR;
@@ -1147,15 +1411,14 @@ YY_RULE_SETUP
 
 	YY_BREAK
 
-
-case 17:
+case 19:
 YY_RULE_SETUP
-#line 241 "cmplv2.lex"
-// Eat spaces 
+#line 277 "cmplv2.lex"
+// Eat spaces
 	YY_BREAK
-case 18:
+case 20:
 YY_RULE_SETUP
-#line 243 "cmplv2.lex"
+#line 279 "cmplv2.lex"
   // Got file name
 
                   if (include_stack_top >= ZHVM_MAX_INCLUDE){
@@ -1171,42 +1434,51 @@ YY_RULE_SETUP
                      return zhvm::TT2_ERROR;
                   }
 
-                  yy_switch_to_buffer(yy_create_buffer(yyin,YY_BUF_SIZE,yyscanner),yyscanner);
+                  yy_switch_to_buffer(yy_create_buffer( yyin, YY_BUF_SIZE, yyscanner), yyscanner);
                   BEGIN(INITIAL);
 
 
 	YY_BREAK
 
-
-case 19:
+case 21:
 YY_RULE_SETUP
-#line 267 "cmplv2.lex"
+#line 303 "cmplv2.lex"
 BEGIN(INCLUDE_FILE);
 	YY_BREAK
-case 20:
+case 22:
 YY_RULE_SETUP
-#line 269 "cmplv2.lex"
+#line 305 "cmplv2.lex"
 yy_push_state(REGISTER,  yyscanner);
 	YY_BREAK
-case 21:
+case 23:
 YY_RULE_SETUP
-#line 271 "cmplv2.lex"
+#line 307 "cmplv2.lex"
 
                   yylval->type = zhvm::TT2_WORD;
                   yylval->opr.assign(yytext);
                   return zhvm::TT2_WORD;
 
 	YY_BREAK
-case 22:
+case 24:
 YY_RULE_SETUP
-#line 277 "cmplv2.lex"
+#line 313 "cmplv2.lex"
 
                   // DO NOTHING
 
 	YY_BREAK
-case 23:
+case 25:
 YY_RULE_SETUP
-#line 281 "cmplv2.lex"
+#line 317 "cmplv2.lex"
+
+                  // DOUBLE IS STORED AS ITS BIT PATTERN
+                  yylval->num = zhvm::DoubleToReg(strtod(yytext, 0));
+                  yylval->type = zhvm::TT2_NUMBER_DOUBLE;
+                  return zhvm::TT2_NUMBER_DOUBLE;
+
+	YY_BREAK
+case 26:
+YY_RULE_SETUP
+#line 324 "cmplv2.lex"
 
                   {
                     char* end = yytext;
@@ -1236,42 +1508,41 @@ YY_RULE_SETUP
                   }
 
 	YY_BREAK
-case 24:
-/* rule 24 can match eol */
+case 27:
+/* rule 27 can match eol */
 YY_RULE_SETUP
-#line 310 "cmplv2.lex"
+#line 353 "cmplv2.lex"
 BEGIN(INITIAL);
 	YY_BREAK
-case 25:
+case 28:
 YY_RULE_SETUP
-#line 312 "cmplv2.lex"
+#line 355 "cmplv2.lex"
 
                   // IGNORE EVERYTHING FROM # TO EOL
                   BEGIN(COMMENT_STATE);
 
 	YY_BREAK
 
-
-case 26:
-/* rule 26 can match eol */
+case 29:
+/* rule 29 can match eol */
 YY_RULE_SETUP
-#line 321 "cmplv2.lex"
+#line 364 "cmplv2.lex"
 BEGIN(INITIAL);
 	YY_BREAK
-case 27:
+case 30:
 YY_RULE_SETUP
-#line 323 "cmplv2.lex"
+#line 366 "cmplv2.lex"
 
                   // IGNORE ALL
 
 	YY_BREAK
 
-case 28:
+case 31:
 YY_RULE_SETUP
-#line 332 "cmplv2.lex"
+#line 375 "cmplv2.lex"
 ECHO;
 	YY_BREAK
-#line 1273 "/home/timur/projects/zhvm/stage/src/zhvm/cmplv2.gen.cpp"
+#line 1543 "/home/timur/projects/zhvm/stage/src/zhvm/cmplv2.gen.cpp"
 case YY_STATE_EOF(REGISTER):
 case YY_STATE_EOF(COMMENT_STATE):
 case YY_STATE_EOF(MACRO_STATE):
@@ -1569,7 +1840,7 @@ static int yy_get_next_buffer (yyscan_t yyscanner)
 		while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 			{
 			yy_current_state = (int) yy_def[yy_current_state];
-			if ( yy_current_state >= 64 )
+			if ( yy_current_state >= 89 )
 				yy_c = yy_meta[(unsigned int) yy_c];
 			}
 		yy_current_state = yy_nxt[yy_base[yy_current_state] + (unsigned int) yy_c];
@@ -1598,11 +1869,11 @@ static int yy_get_next_buffer (yyscan_t yyscanner)
 	while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 		{
 		yy_current_state = (int) yy_def[yy_current_state];
-		if ( yy_current_state >= 64 )
+		if ( yy_current_state >= 89 )
 			yy_c = yy_meta[(unsigned int) yy_c];
 		}
 	yy_current_state = yy_nxt[yy_base[yy_current_state] + (unsigned int) yy_c];
-	yy_is_jam = (yy_current_state == 63);
+	yy_is_jam = (yy_current_state == 88);
 
 	(void)yyg;
 	return yy_is_jam ? 0 : yy_current_state;
@@ -2518,7 +2789,7 @@ void yyfree (void * ptr , yyscan_t yyscanner)
 
 #define YYTABLES_NAME "yytables"
 
-#line 332 "cmplv2.lex"
+#line 375 "cmplv2.lex"
 
 
 
@@ -28,6 +28,46 @@
 #define FLEX_BETA
 #endif
 
+#define yy_create_buffer cmplv2_create_buffer
+#define yy_delete_buffer cmplv2_delete_buffer
+#define yy_scan_buffer cmplv2_scan_buffer
+#define yy_scan_string cmplv2_scan_string
+#define yy_scan_bytes cmplv2_scan_bytes
+#define yy_init_buffer cmplv2_init_buffer
+#define yy_flush_buffer cmplv2_flush_buffer
+#define yy_load_buffer_state cmplv2_load_buffer_state
+#define yy_switch_to_buffer cmplv2_switch_to_buffer
+#define yypush_buffer_state cmplv2push_buffer_state
+#define yypop_buffer_state cmplv2pop_buffer_state
+#define yyensure_buffer_stack cmplv2ensure_buffer_stack
+#define yylex cmplv2lex
+#define yyrestart cmplv2restart
+#define yylex_init cmplv2lex_init
+#define yylex_init_extra cmplv2lex_init_extra
+#define yylex_destroy cmplv2lex_destroy
+#define yyget_debug cmplv2get_debug
+#define yyset_debug cmplv2set_debug
+#define yyget_extra cmplv2get_extra
+#define yyset_extra cmplv2set_extra
+#define yyget_in cmplv2get_in
+#define yyset_in cmplv2set_in
+#define yyget_out cmplv2get_out
+#define yyset_out cmplv2set_out
+#define yyget_leng cmplv2get_leng
+#define yyget_text cmplv2get_text
+#define yyget_lineno cmplv2get_lineno
+#define yyset_lineno cmplv2set_lineno
+#define yyget_column cmplv2get_column
+#define yyset_column cmplv2set_column
+#define yywrap cmplv2wrap
+#define yyget_lval cmplv2get_lval
+#define yyset_lval cmplv2set_lval
+#define yyget_lloc cmplv2get_lloc
+#define yyset_lloc cmplv2set_lloc
+#define yyalloc cmplv2alloc
+#define yyrealloc cmplv2realloc
+#define yyfree cmplv2free
+
 /* First, we deal with  platform-specific or compiler-specific issues. */
 
 /* begin standard C headers. */
@@ -232,7 +272,7 @@ void yyfree (void * ,yyscan_t yyscanner );
 
 /* Begin user sect3 */
 
-#define yywrap(yyscanner) (/*CONSTCOND*/1)
+#define cmplv2wrap(yyscanner) (/*CONSTCOND*/1)
 #define YY_SKIP_YYWRAP
 
 #define yytext_ptr yytext_r
@@ -369,9 +409,9 @@ extern int yylex \
 #undef YY_DECL
 #endif
 
-#line 332 "cmplv2.lex"
+#line 375 "cmplv2.lex"
 
 
-#line 376 "/home/timur/projects/zhvm/stage/src/zhvm/cmplv2.gen.h"
+#line 416 "/home/timur/projects/zhvm/stage/src/zhvm/cmplv2.gen.h"
 #undef yyIN_HEADER
 #endif /* yyHEADER_H */
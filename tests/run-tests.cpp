@@ -5,7 +5,20 @@ extern "C" {
 #include <cstdio>
 #include <cstdint>
 #include <ctime>
+#include <cstring>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
 #include <zhvm.h>
+#include <zlg.h>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 void TestGetSetRegisters(CuTest* tc) {
     zhvm::memory mem;
@@ -198,11 +211,1671 @@ void TestCommands(CuTest* tc) {
 
 }
 
+template <typename T>
+void CheckVectorKernels(CuTest* tc, const T* a, const T* b, size_t count) {
+
+    using namespace zhvm;
+
+    uint64_t sum = 0;
+    uint64_t dot = 0;
+    for (size_t i = 0; i < count; ++i) {
+        sum += (uint64_t) (int64_t) a[i];
+        dot += (uint64_t) (int64_t) a[i] * (uint64_t) (int64_t) b[i];
+    }
+    CuAssertTrue(tc, VecSum(a, count, sizeof (T)) == (int64_t) sum);
+    CuAssertTrue(tc, VecDot(a, b, count, sizeof (T)) == (int64_t) dot);
+
+    std::vector<T> add(a, a + count);
+    std::vector<T> mul(a, a + count);
+    std::vector<T> min(a, a + count);
+    std::vector<T> max(a, a + count);
+    VecAdd(add.data(), b, count, sizeof (T));
+    VecMul(mul.data(), b, count, sizeof (T));
+    VecMin(min.data(), b, count, sizeof (T));
+    VecMax(max.data(), b, count, sizeof (T));
+    for (size_t i = 0; i < count; ++i) {
+        CuAssertTrue(tc, add[i] == (T) ((uint64_t) a[i] + (uint64_t) b[i]));
+        CuAssertTrue(tc, mul[i] == (T) ((uint64_t) a[i] * (uint64_t) b[i]));
+        CuAssertTrue(tc, min[i] == std::min(a[i], b[i]));
+        CuAssertTrue(tc, max[i] == std::max(a[i], b[i]));
+    }
+}
+
+void TestVectorKernels(CuTest* tc) {
+
+    // Every kernel against scalar definition, values cover full element
+    // range, count leaves tail after SIMD blocks
+    const size_t size = 67 * sizeof (int64_t);
+    std::vector<uint8_t> a(size);
+    std::vector<uint8_t> b(size);
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < size; ++i) {
+        seed = seed * 1103515245 + 12345;
+        a[i] = (uint8_t) (seed >> 16);
+        seed = seed * 1103515245 + 12345;
+        b[i] = (uint8_t) (seed >> 16);
+    }
+    // Extreme values
+    memset(a.data(), 0x80, 32);
+    memset(b.data(), 0x80, 16);
+    memset(b.data() + 16, 0x7F, 16);
+
+    CheckVectorKernels(tc, (const int8_t*) a.data(), (const int8_t*) b.data(), size);
+    CheckVectorKernels(tc, (const int16_t*) a.data(), (const int16_t*) b.data(), size / 2);
+    CheckVectorKernels(tc, (const int32_t*) a.data(), (const int32_t*) b.data(), size / 4);
+    CheckVectorKernels(tc, (const int64_t*) a.data(), (const int64_t*) b.data(), size / 8);
+
+}
+
+void TestVectors(CuTest* tc) {
+
+    using namespace zhvm;
+
+    memory mem;
+    const size_t memsz = 1024;
+    mem.NewImage(memsz, memsz);
+
+    const int64_t count = 37; // Not a multiple of SIMD block
+    const off_t va = 0;
+    const off_t vb = 512;
+
+    int64_t sum = 0;
+    int64_t dot = 0;
+    for (int64_t i = 0; i < count; ++i) {
+        mem.SetQuad(va + i * sizeof (int64_t), i - 10);
+        mem.SetQuad(vb + i * sizeof (int64_t), 3 * i);
+        sum += 3 * i;
+        dot += (i - 10) * 3 * i;
+    }
+
+    uint32_t rg[3] = {RA, RB, RC};
+
+    mem.Set(RA, va);
+    mem.Set(RB, vb);
+    mem.Set(RC, count);
+
+    //     OP_VDOT
+    Invoke(&mem, PackCommand(OP_VDOT, rg, sizeof (int64_t)));
+    CuAssertIntEquals(tc, dot, mem.Get(RA));
+
+    //     OP_VSUM
+    Invoke(&mem, PackCommand(OP_VSUM, rg, sizeof (int64_t)));
+    CuAssertIntEquals(tc, sum, mem.Get(RA));
+
+    //     OP_VADD
+    mem.Set(RA, va);
+    Invoke(&mem, PackCommand(OP_VADD, rg, sizeof (int64_t)));
+    CuAssertIntEquals(tc, (count - 1 - 10) + 3 * (count - 1), mem.GetQuad(va + (count - 1) * sizeof (int64_t)));
+
+    //     OP_VMAX
+    Invoke(&mem, PackCommand(OP_VMAX, rg, sizeof (int64_t)));
+    CuAssertIntEquals(tc, 4 * 20 - 10, mem.GetQuad(va + 20 * sizeof (int64_t)));
+
+    //     OP_VMIN
+    Invoke(&mem, PackCommand(OP_VMIN, rg, sizeof (int64_t)));
+    CuAssertIntEquals(tc, 3 * 20, mem.GetQuad(va + 20 * sizeof (int64_t)));
+
+    //     OP_VMUL (two byte elements)
+    mem.SetShort(va, -3);
+    mem.SetShort(vb, 7);
+    mem.Set(RC, 1);
+    Invoke(&mem, PackCommand(OP_VMUL, rg, sizeof (int16_t)));
+    CuAssertIntEquals(tc, -21, mem.GetShort(va));
+
+    //     Invalid element width
+    CuAssertIntEquals(tc, 0, VecWidth(3));
+
+    //     Range out of memory
+    int thrown = 0;
+    mem.Set(RC, memsz);
+    try {
+        Invoke(&mem, PackCommand(OP_VADD, rg, sizeof (int64_t)));
+    } catch (std::runtime_error& err) {
+        thrown = 1;
+    }
+    CuAssertIntEquals(tc, 1, thrown);
+
+}
+
+void TestHash(CuTest* tc) {
+
+    using namespace zhvm;
+
+    memory mem;
+    const size_t memsz = 1024;
+    mem.NewImage(memsz, memsz);
+
+    const char* check = "123456789";
+    const off_t offset = 100;
+    for (size_t i = 0; i < strlen(check); ++i) {
+        mem.SetByte(offset + i, check[i]);
+    }
+
+    uint32_t rg[3] = {RA, RB, RC};
+
+    //     OP_CRC
+    mem.Set(RA, 0);
+    mem.Set(RB, offset);
+    mem.Set(RC, 5);
+    Invoke(&mem, PackCommand(OP_CRC, rg, 4));
+    CuAssert(tc, "crc32c(123456789) == 0xE3069283", mem.Get(RA) == 0xE3069283);
+
+    //     OP_CRC in two parts
+    mem.Set(RA, 0);
+    Invoke(&mem, PackCommand(OP_CRC, rg, 0));
+    mem.Set(RB, offset + 5);
+    Invoke(&mem, PackCommand(OP_CRC, rg, -1));
+    CuAssert(tc, "chained crc32c(123456789) == 0xE3069283", mem.Get(RA) == 0xE3069283);
+
+    //     OP_SDBM
+    mem.Set(RA, 0);
+    mem.Set(RB, offset);
+    mem.Set(RC, strlen(check));
+    Invoke(&mem, PackCommand(OP_SDBM, rg, 0));
+    CuAssert(tc, "sdbm(123456789)", mem.Get(RA) == sdbm(0, check, strlen(check)));
+
+    CuAssert(tc, "crc32c(empty) == 0", crc32c(0, check, 0) == 0);
+
+}
+
+void TestPushPop(CuTest* tc) {
+
+    using namespace zhvm;
+
+    memory mem;
+    const size_t memsz = 1024;
+    mem.NewImage(memsz, memsz);
+
+    int64_t a = rand();
+    int64_t r1 = rand();
+    int64_t r8 = ((int64_t) rand() << 32) | rand();
+
+    int64_t mask = GetRegisterMask("{$a $1, $8}");
+    CuAssertIntEquals(tc, (1 << RA) | (1 << R1) | (1 << R8), mask);
+    CuAssertIntEquals(tc, -1, GetRegisterMask("{$a $x}"));
+
+    mem.Set(RA, a);
+    mem.Set(R1, r1);
+    mem.Set(R8, r8);
+    mem.Set(RS, memsz);
+
+    uint32_t rg[3] = {RZ, RS, RZ};
+
+    //     OP_PSH
+    Invoke(&mem, PackCommand(OP_PSH, rg, mask));
+    CuAssertIntEquals(tc, memsz - 3 * sizeof (int64_t), mem.Get(RS));
+    CuAssert(tc, "RA on stack top", mem.GetQuad(mem.Get(RS)) == a);
+
+    mem.Set(RA, 0);
+    mem.Set(R1, 0);
+    mem.Set(R8, 0);
+
+    //     OP_POP
+    Invoke(&mem, PackCommand(OP_POP, rg, mask));
+    CuAssertIntEquals(tc, memsz, mem.Get(RS));
+    CuAssert(tc, "RA restored", mem.Get(RA) == a);
+    CuAssert(tc, "R1 restored", mem.Get(R1) == r1);
+    CuAssert(tc, "R8 restored", mem.Get(R8) == r8);
+
+    //     Stack overflow
+    int thrown = 0;
+    mem.Set(RS, 8);
+    try {
+        Invoke(&mem, PackCommand(OP_PSH, rg, mask));
+    } catch (std::runtime_error& err) {
+        thrown = 1;
+    }
+    CuAssertIntEquals(tc, 1, thrown);
+    CuAssertIntEquals(tc, 8, mem.Get(RS));
+
+}
+
+void TestLoop(CuTest* tc) {
+
+    using namespace zhvm;
+
+    const char* program =
+            "$c = add[,10]\n"
+            "!start\n"
+            "$a = add[$a, 2]\n"
+            "$p = loop[$c, @start]\n"
+            "hlt[]\n";
+
+    memory mem;
+    CuAssert(tc, "Assemble loop", Assemble(program, &mem, LL_NONE) != 0);
+
+    memory burst(mem);
+
+    CuAssertIntEquals(tc, IR_HALT, Execute(&mem, false));
+    CuAssertIntEquals(tc, 20, mem.Get(RA));
+    CuAssertIntEquals(tc, 0, mem.Get(RC));
+
+    CuAssertIntEquals(tc, IR_HALT, ExecutePrefetch(&burst));
+    CuAssertIntEquals(tc, 20, burst.Get(RA));
+    CuAssertIntEquals(tc, 0, burst.Get(RC));
+
+}
+
+void TestFloat(CuTest* tc) {
+
+    using namespace zhvm;
+
+    const char* program =
+            "!data\n"
+            "!fval\n"
+            "!0.75\n"
+            "!code\n"
+            "!$a 2.25\n"
+            "!$b -0.5\n"
+            "$c = fmul[$a, $b]\n"
+            "$0 = fsqrt[,16]\n"
+            "$1 = itof[,-7]\n"
+            "$2 = ftoi[$c]\n"
+            "$3 = fcmp[$a, $b]\n"
+            "$4 = fdiv[$z, $z]\n"
+            "$5 = fcmp[$4, $4]\n"
+            "$6 = ftoi[$4]\n"
+            "$7 = fadd[$a, 1]\n"
+            "$8 = ldq[,@fval]\n"
+            "$8 = fsub[$8, $a]\n"
+            "hlt[]\n";
+
+    memory mem;
+    CuAssert(tc, "Assemble float", Assemble(program, &mem, LL_NONE) != 0);
+
+    memory burst(mem);
+
+    CuAssertIntEquals(tc, IR_HALT, Execute(&mem, false));
+    CuAssertIntEquals(tc, IR_HALT, ExecutePrefetch(&burst));
+
+    memory* results[] = {&mem, &burst};
+    for (int i = 0; i < 2; ++i) {
+        memory* res = results[i];
+        CuAssertDblEquals(tc, -1.125, RegToDouble(res->Get(RC)), 0.0);
+        CuAssertDblEquals(tc, 4.0, RegToDouble(res->Get(R0)), 0.0);
+        CuAssertDblEquals(tc, -7.0, RegToDouble(res->Get(R1)), 0.0);
+        CuAssertIntEquals(tc, -1, res->Get(R2));
+        CuAssertIntEquals(tc, 1, res->Get(R3));
+        CuAssertIntEquals(tc, 2, res->Get(R5));
+        CuAssertIntEquals(tc, 0, res->Get(R6));
+        CuAssertDblEquals(tc, 3.25, RegToDouble(res->Get(R7)), 0.0);
+        CuAssertDblEquals(tc, -1.5, RegToDouble(res->Get(R8)), 0.0);
+    }
+
+}
+
+void TestCompact(CuTest* tc) {
+
+    using namespace zhvm;
+
+    const char* program =
+            "$a = add[,5]\n"
+            "$b = add[,1]\n"
+            "$c = add[,0]\n"
+            "!start\n"
+            "$0 = add[$a]\n"
+            "$0 = mul[$0, $a]\n"
+            "$c = add[$c, $0]\n"
+            "$1 = add[$c]\n"
+            "$a = sub[$a, $b]\n"
+            "$p = cmn[$a, @start]\n"
+            "$d = svq[$c]\n"
+            "$2 = ldq[$d]\n"
+            "hlt[]\n";
+
+    memory wide;
+    memory narrow;
+    {
+        cmplv2 cmpl(program, &wide);
+        cmpl.SetLogLevel(LL_NONE);
+        CuAssertIntEquals(tc, TT2_EOF, cmpl());
+        CuAssertIntEquals(tc, 12 * sizeof (uint32_t), cmpl.CodeOffset());
+    }
+    {
+        cmplv2 cmpl(program, &narrow);
+        cmpl.SetLogLevel(LL_NONE);
+        cmpl.SetCompact(true);
+        CuAssertIntEquals(tc, TT2_EOF, cmpl());
+        CuAssertIntEquals(tc, 9 * sizeof (uint32_t), cmpl.CodeOffset());
+    }
+
+    CuAssertIntEquals(tc, 0, wide.ImageFlags());
+    CuAssertIntEquals(tc, IF_COMPACT, narrow.ImageFlags());
+    CuAssertIntEquals(tc, OP_PAIR, ZHVM_OPMASK(narrow.GetCode(3 * sizeof (uint32_t))));
+
+    std::stringstream image;
+    narrow.Dump(image);
+    memory loaded;
+    loaded.Load(image);
+    CuAssertIntEquals(tc, IF_COMPACT, loaded.ImageFlags());
+
+    memory burst(loaded);
+
+    CuAssertIntEquals(tc, IR_HALT, Execute(&wide, false));
+    CuAssertIntEquals(tc, IR_HALT, Execute(&loaded, false));
+    CuAssertIntEquals(tc, IR_HALT, ExecutePrefetch(&burst));
+
+    CuAssertIntEquals(tc, 55, wide.Get(RC));
+    for (uint32_t reg = RA; reg < RP; ++reg) {
+        CuAssertIntEquals(tc, wide.Get(reg), loaded.Get(reg));
+        CuAssertIntEquals(tc, wide.Get(reg), burst.Get(reg));
+    }
+
+}
+
+void TestLoadOldImage(CuTest* tc) {
+
+    using namespace zhvm;
+
+    memory mem(64, 64);
+    mem.Set(RA, 42);
+    mem.SetQuad(8, 0x1234);
+
+    std::stringstream image;
+    mem.Dump(image);
+    std::string data = image.str();
+
+    // Current image has crc32c of every section, flip one data byte
+    std::string broken(data);
+    const size_t headersize = 8 * sizeof (uint32_t) + (RTOTAL - 1) * sizeof (reg_t) + sizeof (int32_t);
+    broken[headersize + 64 + 8] ^= 1;
+    std::stringstream brokenimage(broken);
+    memory corrupted;
+    int failed = 0;
+    try {
+        corrupted.Load(brokenimage);
+    } catch (std::runtime_error&) {
+        failed = 1;
+    }
+    CuAssertIntEquals(tc, 1, failed);
+
+    // Version 10 header has no flags, checksum and size high bits fields, 
+    // image ends with sdbm hash
+    const size_t flagsoffset = 4 * sizeof (uint32_t) + (RTOTAL - 1) * sizeof (reg_t) + sizeof (int32_t);
+    data.erase(flagsoffset, 4 * sizeof (uint32_t));
+    data.resize(data.size() - 3 * sizeof (uint32_t));
+    uint32_t version = 10;
+    memcpy(&data[sizeof (uint32_t)], &version, sizeof (uint32_t));
+    uint32_t hash = sdbm(0, data.data(), data.size());
+    data.append((const char*) &hash, sizeof (uint32_t));
+
+    std::stringstream oldimage(data);
+    memory loaded;
+    loaded.Load(oldimage);
+
+    CuAssertIntEquals(tc, 42, loaded.Get(RA));
+    CuAssertIntEquals(tc, 0x1234, loaded.GetQuad(8));
+    CuAssertIntEquals(tc, 0, loaded.ImageFlags());
+
+}
+
+void TestWindows(CuTest* tc) {
+
+    using namespace zhvm;
+
+    const char* program =
+            "$a = add[,15]\n"
+            "$0 = add[,77]\n"
+            "$p = wcl[, @fib]\n"
+            "hlt[]\n"
+            "!fib\n"
+            "$0 = add[$a]\n"
+            "$1 = ls[$0, 2]\n"
+            "$p = cmn[$1, @fib_end]\n"
+            "$a = sub[$0, 1]\n"
+            "$p = wcl[, @fib]\n"
+            "$2 = add[$a]\n"
+            "$a = sub[$0, 2]\n"
+            "$p = wcl[, @fib]\n"
+            "$a = add[$a, $2]\n"
+            "!fib_end\n"
+            "$p = wrt[]\n";
+
+    memory mem;
+    CuAssert(tc, "Assemble windows", Assemble(program, &mem, LL_NONE) != 0);
+    CuAssertIntEquals(tc, IF_WINDOWS, mem.ImageFlags());
+
+    memory burst(mem);
+
+    CuAssertIntEquals(tc, IR_HALT, Execute(&mem, false));
+    CuAssertIntEquals(tc, 610, mem.Get(RA));
+    CuAssertIntEquals(tc, 77, mem.Get(R0));
+    CuAssertIntEquals(tc, 0, mem.WindowDepth());
+
+    CuAssertIntEquals(tc, IR_HALT, ExecutePrefetch(&burst));
+    CuAssertIntEquals(tc, 610, burst.Get(RA));
+    CuAssertIntEquals(tc, 77, burst.Get(R0));
+
+    memory deep;
+    deep.SetImageFlags(IF_WINDOWS);
+    for (int i = 0; i < 20; ++i) {
+        deep.Set(R0, i);
+        deep.PushWindow(i * 4);
+        CuAssertIntEquals(tc, 0, deep.Get(R0));
+    }
+    CuAssertIntEquals(tc, 20, deep.WindowDepth());
+
+    std::stringstream image;
+    deep.Dump(image);
+    memory loaded;
+    loaded.Load(image);
+    CuAssertIntEquals(tc, 20, loaded.WindowDepth());
+
+    for (int i = 19; i >= 0; --i) {
+        CuAssertIntEquals(tc, i * 4, deep.PopWindow());
+        CuAssertIntEquals(tc, i, deep.Get(R0));
+        CuAssertIntEquals(tc, i * 4, loaded.PopWindow());
+        CuAssertIntEquals(tc, i, loaded.Get(R0));
+    }
+    CuAssertIntEquals(tc, 0, loaded.WindowDepth());
+
+    memory full;
+    full.SetImageFlags(IF_WINDOWS);
+    for (uint32_t i = 0; i < ZHVM_WINDOW_SPILL_MAX + ZHVM_WINDOW_BANKS; ++i) {
+        full.PushWindow(i);
+    }
+    bool overflow = false;
+    try {
+        full.PushWindow(0);
+    } catch (std::runtime_error&) {
+        overflow = true;
+    }
+    CuAssertTrue(tc, overflow);
+    CuAssertIntEquals(tc, ZHVM_WINDOW_SPILL_MAX + ZHVM_WINDOW_BANKS, full.WindowDepth());
+
+}
+
+int custom_mix(zhvm::memory* mem, uint32_t dst, uint32_t src0, uint32_t src1, int32_t imm) {
+    mem->Set(dst, mem->Get(src0) * 1000 + mem->Get(src1) * 10 + imm);
+    return zhvm::IR_RUN;
+}
+
+void TestCustomOpcode(CuTest* tc) {
+
+    using namespace zhvm;
+
+    const char* program =
+            "!opcode mix 0x35\n"
+            "$b = add[,3]\n"
+            "$c = add[,4]\n"
+            "$a = mix[$b, $c + 5]\n"
+            "$0 = usr0[$c, $b]\n"
+            "$1 = usr1[]\n"
+            "hlt[]\n";
+
+    memory mem;
+    CuAssert(tc, "Assemble custom", Assemble(program, &mem, LL_NONE) != 0);
+    CuAssert(tc, "Standard mnemonic taken", Assemble("!opcode add 0x35\n", &mem, LL_NONE) == 0);
+    CuAssert(tc, "Not custom opcode", Assemble("!opcode foo 0x01\n", &mem, LL_NONE) == 0);
+
+    mem.SetCustom(OP_USR0, custom_mix);
+    memory burst(mem);
+
+    CuAssertIntEquals(tc, IR_OP_UNKNWN, Execute(&mem, false));
+    CuAssertIntEquals(tc, 3045, mem.Get(RA));
+    CuAssertIntEquals(tc, 4030, mem.Get(R0));
+
+    CuAssertIntEquals(tc, IR_OP_UNKNWN, ExecutePrefetch(&burst));
+    CuAssertIntEquals(tc, 3045, burst.Get(RA));
+    CuAssertIntEquals(tc, 4030, burst.Get(R0));
+
+}
+
+void TestSharedCode(CuTest* tc) {
+
+    using namespace zhvm;
+
+    memory mem;
+    CuAssert(tc, "Assemble shared", Assemble("$a = add[,7]\nhlt[]\n", &mem, LL_NONE) != 0);
+
+    memory copy(mem);
+    memory other;
+    other = copy;
+    CuAssert(tc, "Copy shares code", copy.SharesCode(mem));
+    CuAssert(tc, "Assignment shares code", other.SharesCode(mem));
+
+    uint32_t first = mem.GetCode(0);
+    copy.SetCode(0, 0);
+    CuAssert(tc, "Write unshares code", !copy.SharesCode(mem));
+    CuAssert(tc, "Others still share", other.SharesCode(mem));
+    CuAssertIntEquals(tc, first, mem.GetCode(0));
+    CuAssertIntEquals(tc, 0, copy.GetCode(0));
+
+    CuAssertIntEquals(tc, IR_HALT, Execute(&other, false));
+    CuAssertIntEquals(tc, 7, other.Get(RA));
+
+}
+
+void TestFork(CuTest* tc) {
+
+    using namespace zhvm;
+
+    const size_t size = 64 * ZHVM_PAGE_SIZE;
+    memory parent(1024, size);
+    for (size_t i = 0; i < size - 8; i += ZHVM_PAGE_SIZE) {
+        parent.SetQuad(i, i);
+    }
+    CuAssert(tc, "Assemble fork", Assemble("$a = add[,5]\n$b = ldq[$z]\nhlt[]\n", &parent, LL_NONE) != 0);
+
+    memory child;
+    parent.Fork(&child);
+    CuAssert(tc, "Fork shares code", child.SharesCode(parent));
+    for (size_t i = 0; i < size - 8; i += ZHVM_PAGE_SIZE) {
+        CuAssertIntEquals(tc, i, child.GetQuad(i));
+    }
+
+    parent.SetQuad(ZHVM_PAGE_SIZE, -1);
+    child.SetQuad(2 * ZHVM_PAGE_SIZE, -2);
+    CuAssertIntEquals(tc, ZHVM_PAGE_SIZE, child.GetQuad(ZHVM_PAGE_SIZE));
+    CuAssertIntEquals(tc, 2 * ZHVM_PAGE_SIZE, parent.GetQuad(2 * ZHVM_PAGE_SIZE));
+
+    memory second;
+    parent.Fork(&second);
+    CuAssertIntEquals(tc, -1, second.GetQuad(ZHVM_PAGE_SIZE));
+    CuAssertIntEquals(tc, 2 * ZHVM_PAGE_SIZE, second.GetQuad(2 * ZHVM_PAGE_SIZE));
+
+    memory grandchild;
+    child.Fork(&grandchild);
+    CuAssertIntEquals(tc, -2, grandchild.GetQuad(2 * ZHVM_PAGE_SIZE));
+    CuAssertIntEquals(tc, ZHVM_PAGE_SIZE, grandchild.GetQuad(ZHVM_PAGE_SIZE));
+
+    parent.SetQuad(0, 42);
+    CuAssertIntEquals(tc, IR_HALT, Execute(&second, false));
+    CuAssertIntEquals(tc, 5, second.Get(RA));
+    CuAssertIntEquals(tc, 0, second.Get(RB));
+
+    bool violation = false;
+    try {
+        second.Copy(size - 4, 0, 8);
+    } catch (std::runtime_error&) {
+        violation = true;
+    }
+    CuAssertTrue(tc, violation);
+
+}
+
+void TestForkUntouched(CuTest* tc) {
+
+    using namespace zhvm;
+
+#ifndef WIN32
+    // Pages parent never wrote must stay holes in child, not copies
+    const size_t size = 1024 * ZHVM_PAGE_SIZE;
+    segment parent(size);
+    parent.Touch(0, 8);
+    memset(parent.Data(), 0x5A, 8);
+
+    segment child;
+    parent.Fork(&child);
+    CuAssertIntEquals(tc, 0x5A, child.Data()[7]);
+
+    const size_t host = sysconf(_SC_PAGESIZE);
+    std::vector<unsigned char> resident((size + host - 1) / host);
+    CuAssertIntEquals(tc, 0, mincore(child.Data(), size, resident.data()));
+    size_t copied = 0;
+    for (size_t i = 0; i < resident.size(); ++i) {
+        copied += resident[i] & 1;
+    }
+    CuAssert(tc, "Fork copies untouched pages", copied <= ZHVM_PAGE_SIZE / host);
+#else
+    (void) tc;
+#endif
+
+}
+
+void TestForkDescriptors(CuTest* tc) {
+
+    using namespace zhvm;
+
+#ifndef WIN32
+    // VMs and forks must not hold descriptor each
+    struct rlimit saved;
+    CuAssertIntEquals(tc, 0, getrlimit(RLIMIT_NOFILE, &saved));
+    struct rlimit limit = saved;
+    limit.rlim_cur = std::min<rlim_t>(saved.rlim_cur, 256);
+    CuAssertIntEquals(tc, 0, setrlimit(RLIMIT_NOFILE, &limit));
+    const size_t count = 2 * limit.rlim_cur;
+
+    int opened = -1;
+    int thrown = 0;
+    try {
+        std::vector<memory*> vms;
+        for (size_t i = 0; i < count; ++i) {
+            vms.push_back(new memory(1024, 1024));
+            vms.back()->SetQuad(0, i);
+        }
+
+        memory parent(1024, 4 * ZHVM_PAGE_SIZE);
+        parent.SetQuad(ZHVM_PAGE_SIZE, 7);
+        std::vector<memory> children(count);
+        for (size_t i = 0; i < count; ++i) {
+            parent.Fork(&children[i]);
+        }
+        children.back().SetQuad(0, 9);
+        memory grandchild;
+        children.back().Fork(&grandchild);
+        CuAssertIntEquals(tc, 9, grandchild.GetQuad(0));
+        CuAssertIntEquals(tc, 7, grandchild.GetQuad(ZHVM_PAGE_SIZE));
+        CuAssertIntEquals(tc, count - 1, vms.back()->GetQuad(0));
+
+        opened = open("/dev/null", O_RDONLY);
+        for (size_t i = 0; i < vms.size(); ++i) {
+            delete vms[i];
+        }
+    } catch (std::runtime_error&) {
+        thrown = 1;
+    }
+    setrlimit(RLIMIT_NOFILE, &saved);
+
+    CuAssertIntEquals(tc, 0, thrown);
+    CuAssert(tc, "Host can open files", opened >= 0);
+    close(opened);
+#else
+    (void) tc;
+#endif
+
+}
+
+void TestMapImage(CuTest* tc) {
+
+    using namespace zhvm;
+
+    const char* path = "run-tests-map.zhvm";
+
+    memory mem(1024, 3 * ZHVM_PAGE_SIZE);
+    CuAssert(tc, "Assemble map", Assemble("$a = ldq[$z]\nhlt[]\n", &mem, LL_NONE) != 0);
+    mem.SetQuad(0, 0x1234);
+    mem.SetQuad(2 * ZHVM_PAGE_SIZE, 0x5678);
+    mem.Set(RC, 77);
+    mem.SetImageFlags(IF_ALIGNED);
+    {
+        std::ofstream out(path, std::ios_base::out | std::ios_base::binary);
+        mem.Dump(out);
+    }
+
+    memory mapped;
+    mapped.Map(path, true);
+    CuAssertIntEquals(tc, IF_ALIGNED, mapped.ImageFlags());
+    CuAssertIntEquals(tc, 77, mapped.Get(RC));
+    CuAssertIntEquals(tc, 0x5678, mapped.GetQuad(2 * ZHVM_PAGE_SIZE));
+
+    memory loaded;
+    {
+        std::ifstream inp(path, std::ios_base::in | std::ios_base::binary);
+        loaded.Load(inp);
+    }
+    CuAssertIntEquals(tc, mapped.GetCode(0), loaded.GetCode(0));
+    CuAssertIntEquals(tc, 0x5678, loaded.GetQuad(2 * ZHVM_PAGE_SIZE));
+
+    memory child;
+    mapped.SetQuad(2 * ZHVM_PAGE_SIZE, 1);
+    mapped.Fork(&child);
+    mapped.SetCode(0, 0);
+    CuAssertIntEquals(tc, 1, child.GetQuad(2 * ZHVM_PAGE_SIZE));
+    CuAssertIntEquals(tc, 0x1234, child.GetQuad(0));
+    CuAssertIntEquals(tc, IR_HALT, Execute(&child, false));
+    CuAssertIntEquals(tc, 0x1234, child.Get(RA));
+
+    {
+        std::fstream patch(path, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+        patch.seekp(-1, std::ios_base::end);
+        patch.put(0x55);
+    }
+
+    int corrupted = 0;
+    try {
+        memory bad;
+        bad.Map(path, true);
+    } catch (std::runtime_error&) {
+        corrupted = 1;
+    }
+    CuAssertIntEquals(tc, 1, corrupted);
+
+    remove(path);
+
+}
+
+void TestSparseImage(CuTest* tc) {
+
+    using namespace zhvm;
+
+    memory mem(1024, 256 * 1024);
+    CuAssert(tc, "Assemble sparse", Assemble("$a = ldq[$z]\nhlt[]\n", &mem, LL_NONE) != 0);
+    mem.SetQuad(0, 0x1234);
+    mem.SetCode(1016, 0xC0DE);
+    for (int i = 0; i < 4096; ++i) {
+        mem.SetByte(100000 + i, "zhvm"[i % 4]);
+        mem.SetByte(200000 + i, rand());
+    }
+
+    std::stringstream full;
+    mem.Dump(full);
+
+    for (int pass = 0; pass < 2; ++pass) {
+        mem.SetImageFlags(pass ? (IF_SPARSE | IF_PACKED) : IF_SPARSE);
+        std::stringstream image;
+        mem.Dump(image);
+        CuAssert(tc, "Sparse image is smaller", image.str().size() < full.str().size() / 16);
+
+        memory loaded;
+        loaded.Load(image);
+        // Zero runs are skipped on load, buffers must come zero filled
+        for (size_t i = 0; i + 4 < 1024; i += 4) {
+            CuAssertIntEquals(tc, mem.GetCode(i), loaded.GetCode(i));
+        }
+        for (size_t i = 0; i + 8 < 256 * 1024; i += 8) {
+            CuAssertIntEquals(tc, mem.GetQuad(i), loaded.GetQuad(i));
+        }
+        CuAssertIntEquals(tc, IR_HALT, Execute(&loaded, false));
+        CuAssertIntEquals(tc, 0x1234, loaded.Get(RA));
+
+        std::stringstream truncated(image.str().substr(0, image.str().size() / 2));
+        bool failed = false;
+        try {
+            loaded.Load(truncated);
+        } catch (std::runtime_error&) {
+            failed = true;
+        }
+        CuAssertTrue(tc, failed);
+        CuAssertIntEquals(tc, 0x1234, loaded.GetQuad(0));
+    }
+
+    const char text[] = "abcabcabcabcabcabcabcabcabcabcabcabcabcabc0123456789";
+    char packed[sizeof (text)];
+    char unpacked[sizeof (text)];
+    size_t plen = LzCompress(text, sizeof (text), packed, sizeof (packed));
+    CuAssert(tc, "Text compressed", (plen != 0) && (plen < sizeof (text)));
+    CuAssert(tc, "Text decompressed", LzDecompress(packed, plen, unpacked, sizeof (unpacked)));
+    CuAssert(tc, "Same text", memcmp(text, unpacked, sizeof (text)) == 0);
+    CuAssert(tc, "Truncated block", !LzDecompress(packed, plen - 1, unpacked, sizeof (unpacked)));
+
+}
+
+void TestCheckpoint(CuTest* tc) {
+
+    using namespace zhvm;
+
+    const size_t size = 64 * ZHVM_PAGE_SIZE;
+    memory mem(1024, size);
+    CuAssert(tc, "Assemble checkpoint", Assemble("$a = add[,1]\nhlt[]\n", &mem, LL_NONE) != 0);
+    mem.SetQuad(0, 1);
+
+    std::stringstream base;
+    mem.Checkpoint(base);
+
+    mem.SetQuad(5 * ZHVM_PAGE_SIZE, 5);
+    mem.Set(RB, 55);
+    std::stringstream first;
+    mem.Delta(first);
+    CuAssert(tc, "Delta is small", first.str().size() < 2 * ZHVM_PAGE_SIZE);
+
+    mem.SetQuad(size - 16, 7);
+    mem.SetCode(0, mem.GetCode(4));
+    std::stringstream second;
+    mem.Delta(second);
+
+    memory restored;
+    restored.Load(base);
+    CuAssertIntEquals(tc, 1, restored.GetQuad(0));
+    CuAssertIntEquals(tc, 0, restored.GetQuad(5 * ZHVM_PAGE_SIZE));
+
+    int rejected = 0;
+    try {
+        memory skipped(restored);
+        skipped.LoadDelta(second);
+    } catch (std::runtime_error&) {
+        rejected = 1;
+    }
+    CuAssertIntEquals(tc, 1, rejected);
+    second.seekg(0);
+
+    // Page count of delta header is checked before allocation
+    std::string forged = first.str();
+    const uint32_t many = 0xFFFFFFFF;
+    memcpy(&forged[5 * sizeof (uint32_t)], &many, sizeof (uint32_t));
+    std::stringstream huge(forged);
+    try {
+        memory copy(restored);
+        copy.LoadDelta(huge);
+    } catch (std::runtime_error&) {
+        rejected = 2;
+    }
+    CuAssertIntEquals(tc, 2, rejected);
+
+    restored.LoadDelta(first);
+    CuAssertIntEquals(tc, 5, restored.GetQuad(5 * ZHVM_PAGE_SIZE));
+    CuAssertIntEquals(tc, 55, restored.Get(RB));
+    CuAssertIntEquals(tc, 0, restored.GetQuad(size - 16));
+
+    restored.LoadDelta(second);
+    CuAssertIntEquals(tc, 7, restored.GetQuad(size - 16));
+    CuAssertIntEquals(tc, mem.GetCode(0), restored.GetCode(0));
+    for (size_t i = 0; i + 8 < size; i += 8) {
+        CuAssertIntEquals(tc, mem.GetQuad(i), restored.GetQuad(i));
+    }
+
+}
+
+void TestWideSegments(CuTest* tc) {
+
+    using namespace zhvm;
+
+    memory mem(1024, 3 * ZHVM_PAGE_SIZE);
+    mem.SetQuad(2 * ZHVM_PAGE_SIZE, 0x1234);
+    std::stringstream image;
+    mem.Dump(image);
+
+    // Size high bits follow checksum field
+    const size_t sizesoffset = 6 * sizeof (uint32_t) + (RTOTAL - 1) * sizeof (reg_t) + sizeof (int32_t);
+    std::string data = image.str();
+    uint32_t header[4];
+    memcpy(header, &data[0], sizeof (header));
+    CuAssertIntEquals(tc, ZHVM_VM_VERSION, header[1]);
+    CuAssertIntEquals(tc, 1024, header[2]);
+    CuAssertIntEquals(tc, 3 * ZHVM_PAGE_SIZE, header[3]);
+    memcpy(header, &data[sizesoffset], 2 * sizeof (uint32_t));
+    CuAssertIntEquals(tc, 0, header[0]);
+    CuAssertIntEquals(tc, 0, header[1]);
+
+    memory loaded;
+    loaded.Load(image);
+    CuAssertIntEquals(tc, 0x1234, loaded.GetQuad(2 * ZHVM_PAGE_SIZE));
+
+    // Data size above 4 GB is read from high bits, this image is too short
+    const uint32_t hi = 1;
+    memcpy(&data[sizesoffset + sizeof (uint32_t)], &hi, sizeof (uint32_t));
+    std::stringstream wide(data);
+    int failed = 0;
+    try {
+        loaded.Load(wide);
+    } catch (std::runtime_error&) {
+        failed = 1;
+    }
+    CuAssertIntEquals(tc, 1, failed);
+    CuAssertIntEquals(tc, 0x1234, loaded.GetQuad(2 * ZHVM_PAGE_SIZE));
+
+#ifndef WIN32
+    // Only touched pages are committed
+    const size_t size = 256 << 20;
+    segment lazy(size);
+    lazy.Touch(size - 8, 8);
+    lazy.Data()[size - 1] = 1;
+
+    const size_t host = sysconf(_SC_PAGESIZE);
+    std::vector<unsigned char> resident((size + host - 1) / host);
+    CuAssertIntEquals(tc, 0, mincore(lazy.Data(), size, resident.data()));
+    size_t committed = 0;
+    for (size_t i = 0; i < resident.size(); ++i) {
+        committed += resident[i] & 1;
+    }
+    CuAssert(tc, "Segment commits untouched pages", committed <= ZHVM_PAGE_SIZE / host);
+#endif
+
+    if (sizeof (size_t) >= sizeof (uint64_t)) {
+        const size_t huge = (size_t) ((uint64_t) 16 << 30);
+        memory big(1024, huge);
+        big.SetQuad(huge - 16, 0x1234);
+        CuAssertIntEquals(tc, 0x1234, big.GetQuad(huge - 16));
+        CuAssertIntEquals(tc, 0, big.GetQuad(huge / 2));
+    }
+
+}
+
+void TestGrowable(CuTest* tc) {
+
+    using namespace zhvm;
+
+    memory mem(1024, ZHVM_PAGE_SIZE);
+    mem.SetLimits(16 * ZHVM_PAGE_SIZE, 4 * ZHVM_PAGE_SIZE);
+    CuAssertIntEquals(tc, ZHVM_PAGE_SIZE, mem.DataSize());
+    CuAssertIntEquals(tc, 0, mem.StackSize());
+
+    // Data segment grows on write, up to limit
+    CuAssertIntEquals(tc, 0, mem.GetQuad(8 * ZHVM_PAGE_SIZE));
+    CuAssertIntEquals(tc, ZHVM_PAGE_SIZE, mem.DataSize());
+    mem.SetQuad(8 * ZHVM_PAGE_SIZE, 0x1234);
+    CuAssertIntEquals(tc, 9 * ZHVM_PAGE_SIZE, mem.DataSize());
+
+    int thrown = 0;
+    try {
+        mem.SetQuad(16 * ZHVM_PAGE_SIZE - 4, 1);
+    } catch (std::runtime_error&) {
+        thrown = 1;
+    }
+    CuAssertIntEquals(tc, 1, thrown);
+
+    // Stack region lies below zero address
+    int64_t a = rand();
+    int64_t mask = GetRegisterMask("{$a}");
+    uint32_t rg[3] = {RZ, RS, RZ};
+    mem.Set(RA, a);
+    mem.Set(RS, 0);
+    Invoke(&mem, PackCommand(OP_PSH, rg, mask));
+    CuAssertIntEquals(tc, -8, mem.Get(RS));
+    CuAssert(tc, "RA on stack top", mem.GetQuad(-8) == a);
+    CuAssertIntEquals(tc, ZHVM_PAGE_SIZE, mem.StackSize());
+
+    mem.Set(RS, -4 * ZHVM_PAGE_SIZE + 8);
+    try {
+        Invoke(&mem, PackCommand(OP_PSH, rg, mask | GetRegisterMask("{$b}")));
+    } catch (std::runtime_error&) {
+        thrown = 2;
+    }
+    CuAssertIntEquals(tc, 2, thrown);
+
+    std::stringstream image;
+    mem.Dump(image);
+    memory loaded;
+    loaded.Load(image);
+    CuAssertIntEquals(tc, 9 * ZHVM_PAGE_SIZE, loaded.DataSize());
+    CuAssertIntEquals(tc, ZHVM_PAGE_SIZE, loaded.StackSize());
+    CuAssertIntEquals(tc, 0x1234, loaded.GetQuad(8 * ZHVM_PAGE_SIZE));
+    CuAssert(tc, "Stack loaded", loaded.GetQuad(-8) == a);
+    loaded.SetQuad(12 * ZHVM_PAGE_SIZE, 1);
+
+    memory child;
+    loaded.Fork(&child);
+    CuAssert(tc, "Stack forked", child.GetQuad(-8) == a);
+    CuAssertIntEquals(tc, 1, child.GetQuad(12 * ZHVM_PAGE_SIZE));
+    child.SetQuad(-16, 5);
+    child.SetQuad(15 * ZHVM_PAGE_SIZE, 6);
+    CuAssertIntEquals(tc, 0, loaded.GetQuad(-16));
+    CuAssertIntEquals(tc, 0, loaded.GetQuad(15 * ZHVM_PAGE_SIZE));
+
+    // Delta carries grown data segment
+    std::stringstream base;
+    child.Checkpoint(base);
+    child.SetQuad(15 * ZHVM_PAGE_SIZE + 8, 7);
+    std::stringstream delta;
+    child.Delta(delta);
+
+    memory restored;
+    restored.Load(base);
+    restored.LoadDelta(delta);
+    CuAssertIntEquals(tc, 7, restored.GetQuad(15 * ZHVM_PAGE_SIZE + 8));
+    CuAssertIntEquals(tc, 5, restored.GetQuad(-16));
+    CuAssertIntEquals(tc, 16 * ZHVM_PAGE_SIZE, restored.DataSize());
+
+}
+
+void TestSegmentOptions(CuTest* tc) {
+
+    using namespace zhvm;
+
+    const segment_options saved = segment::Options();
+    CuAssert(tc, "Default alignment", (uintptr_t) segment(1024).Data() % ZHVM_CACHE_LINE == 0);
+
+    segment_options options = {1 << 16, 4 << 20};
+    segment::SetOptions(options);
+
+    segment small(1024);
+    CuAssert(tc, "Small segment aligned", (uintptr_t) small.Data() % (1 << 16) == 0);
+
+    // Huge page segment starts at huge page boundary and still forks
+    segment huge(8 << 20);
+    CuAssert(tc, "Huge segment aligned", (uintptr_t) huge.Data() % ZHVM_HUGE_PAGE_SIZE == 0);
+    huge.Touch(5 << 20, 8);
+    huge.Data()[5 << 20] = 5;
+    segment child;
+    huge.Fork(&child);
+    CuAssertIntEquals(tc, 5, child.Data()[5 << 20]);
+
+    int thrown = 0;
+    options.align = 48;
+    try {
+        segment::SetOptions(options);
+    } catch (std::runtime_error&) {
+        thrown = 1;
+    }
+    CuAssertIntEquals(tc, 1, thrown);
+    CuAssertIntEquals(tc, 1 << 16, segment::Options().align);
+
+    segment::SetOptions(saved);
+
+}
+
+void TestBulkAccess(CuTest* tc) {
+
+    using namespace zhvm;
+
+    const size_t size = 1 << 20;
+    memory mem(1024, 2 * size);
+    std::vector<char> input(size);
+    for (size_t i = 0; i < size; ++i) {
+        input[i] = (char) rand();
+    }
+
+    std::stringstream base;
+    mem.Checkpoint(base);
+
+    mem.Write(size / 2, input.data(), size);
+    CuAssertIntEquals(tc, input[7], mem.GetByte(size / 2 + 7));
+
+    std::vector<char> output(size);
+    mem.Read(output.data(), size / 2, size);
+    CuAssert(tc, "Read back", output == input);
+
+    // Writes through view are tracked like stores
+    span<char> view = mem.View(size + size / 2, 16);
+    CuAssertIntEquals(tc, 16, view.Size());
+    view[3] = 42;
+    CuAssertIntEquals(tc, 42, mem.GetByte(size + size / 2 + 3));
+
+    const memory& cmem = mem;
+    span<const char> cview = cmem.View(0, 2 * size);
+    CuAssertIntEquals(tc, 42, cview[size + size / 2 + 3]);
+
+    int thrown = 0;
+    try {
+        mem.Write(2 * size - 8, input.data(), 16);
+    } catch (std::runtime_error&) {
+        thrown = 1;
+    }
+    try {
+        mem.Read(output.data(), -8, 8);
+    } catch (std::runtime_error&) {
+        thrown += 1;
+    }
+    try {
+        cmem.View(size, (size_t) -1);
+    } catch (std::runtime_error&) {
+        thrown += 1;
+    }
+    CuAssertIntEquals(tc, 3, thrown);
+
+    std::stringstream delta;
+    mem.Delta(delta);
+    memory restored;
+    restored.Load(base);
+    restored.LoadDelta(delta);
+    CuAssertIntEquals(tc, 42, restored.GetByte(size + size / 2 + 3));
+    CuAssertIntEquals(tc, input[size - 1], restored.GetByte(size / 2 + size - 1));
+
+}
+
+void TestMapFile(CuTest* tc) {
+
+    using namespace zhvm;
+
+    const char* path = "run-tests-input.bin";
+    const size_t size = 3 * ZHVM_PAGE_SIZE + 100;
+    std::vector<char> input(size);
+    for (size_t i = 0; i < size; ++i) {
+        input[i] = (char) rand();
+    }
+    {
+        std::ofstream out(path, std::ios_base::out | std::ios_base::binary);
+        out.write(input.data(), input.size());
+    }
+
+    // Data segment grows to hold file
+    memory mem(1024, 2 * ZHVM_PAGE_SIZE);
+    mem.SetQuad(0, 0x1234);
+    CuAssertIntEquals(tc, size, mem.MapFile(path, ZHVM_PAGE_SIZE));
+    CuAssertIntEquals(tc, 5 * ZHVM_PAGE_SIZE, mem.DataSize());
+    CuAssertIntEquals(tc, 0x1234, mem.GetQuad(0));
+    CuAssertIntEquals(tc, input[size - 1], mem.GetByte(ZHVM_PAGE_SIZE + size - 1));
+    CuAssertIntEquals(tc, 0, mem.GetByte(ZHVM_PAGE_SIZE + size));
+
+    // Writes stay private to VM and its forks
+    mem.SetByte(ZHVM_PAGE_SIZE + 5, input[5] + 1);
+    memory child;
+    mem.Fork(&child);
+    CuAssertIntEquals(tc, (char) (input[5] + 1), child.GetByte(ZHVM_PAGE_SIZE + 5));
+    CuAssertIntEquals(tc, input[size / 2], child.GetByte(ZHVM_PAGE_SIZE + size / 2));
+    child.SetByte(ZHVM_PAGE_SIZE + 6, input[6] + 1);
+    CuAssertIntEquals(tc, input[6], mem.GetByte(ZHVM_PAGE_SIZE + 6));
+
+    memory other(1024, 1024);
+    other.MapFile(path, 0);
+    CuAssertIntEquals(tc, input[5], other.GetByte(5));
+
+    int thrown = 0;
+    try {
+        other.MapFile(path, 100);
+    } catch (std::runtime_error&) {
+        thrown = 1;
+    }
+    CuAssertIntEquals(tc, 1, thrown);
+
+    // Image holds mapped contents
+    std::stringstream image;
+    child.Dump(image);
+    remove(path);
+    memory loaded;
+    loaded.Load(image);
+    CuAssertIntEquals(tc, input[size - 1], loaded.GetByte(ZHVM_PAGE_SIZE + size - 1));
+    CuAssertIntEquals(tc, (char) (input[6] + 1), loaded.GetByte(ZHVM_PAGE_SIZE + 6));
+
+}
+
+int PoolFunc(zhvm::memory* mem) {
+    mem->Set(zhvm::RA, 99);
+    return zhvm::IR_RUN;
+}
+
+void TestMemoryPool(CuTest* tc) {
+
+    using namespace zhvm;
+
+    memory_pool pool(1);
+    memory* mem = pool.Acquire(1024, 3 * ZHVM_PAGE_SIZE);
+    CuAssertIntEquals(tc, 3 * ZHVM_PAGE_SIZE, mem->DataSize());
+    CuAssert(tc, "Assemble pool", Assemble("cll[,5]\nhlt[]\n", mem, LL_NONE) != 0);
+    mem->SetFuncs(5, PoolFunc);
+    mem->SetQuad(2 * ZHVM_PAGE_SIZE, 7);
+    mem->Set(RB, 3);
+
+    int thrown = 0;
+    try {
+        mem->SetQuad(3 * ZHVM_PAGE_SIZE, 1);
+    } catch (std::runtime_error&) {
+        thrown = 1;
+    }
+    CuAssertIntEquals(tc, 1, thrown);
+    pool.Release(mem);
+    CuAssertIntEquals(tc, 1, pool.Idle());
+
+    // Same size class gives same instance, clean but with host functions
+    memory* again = pool.Acquire(1024, 4 * ZHVM_PAGE_SIZE);
+    CuAssert(tc, "Instance reused", again == mem);
+    CuAssertIntEquals(tc, 0, pool.Idle());
+    CuAssertIntEquals(tc, 4 * ZHVM_PAGE_SIZE, again->DataSize());
+    CuAssertIntEquals(tc, 0, again->GetQuad(2 * ZHVM_PAGE_SIZE));
+    CuAssertIntEquals(tc, 0, again->Get(RB));
+    CuAssertIntEquals(tc, 0, again->GetCode(0));
+    CuAssert(tc, "Assemble pool", Assemble("cll[,5]\nhlt[]\n", again, LL_NONE) != 0);
+    Execute(again, false);
+    CuAssertIntEquals(tc, 99, again->Get(RA));
+
+    // Forked instance is reset too
+    memory* other = pool.Acquire(1024, 4 * ZHVM_PAGE_SIZE);
+    CuAssert(tc, "New instance", other != again);
+    other->SetQuad(8, 5);
+    memory child;
+    other->Fork(&child);
+    pool.Release(other);
+    pool.Release(again);
+    CuAssertIntEquals(tc, 1, pool.Idle());
+    other = pool.Acquire(1024, 4 * ZHVM_PAGE_SIZE);
+    CuAssertIntEquals(tc, 0, other->GetQuad(8));
+    CuAssertIntEquals(tc, 5, child.GetQuad(8));
+    delete other;
+
+}
+
+void TestPageStore(CuTest* tc) {
+
+    using namespace zhvm;
+
+    // Three equal table pages and one distinct page
+    memory mem(1024, 8 * ZHVM_PAGE_SIZE);
+    for (size_t page = 1; page < 4; ++page) {
+        for (size_t i = 0; i < ZHVM_PAGE_SIZE; i += 8) {
+            mem.SetQuad(page * ZHVM_PAGE_SIZE + i, i * 31);
+        }
+    }
+    mem.SetQuad(5 * ZHVM_PAGE_SIZE + 8, 55);
+    std::stringstream image;
+    mem.Dump(image);
+    const std::string data = image.str();
+
+    page_store store;
+    memory first;
+    first.Load(image);
+    first.ShareData(&store);
+    memory second;
+    std::stringstream again(data);
+    second.Load(again);
+    second.ShareData(&store);
+#ifndef WIN32
+    CuAssertIntEquals(tc, 2, store.Pages());
+#endif
+
+    CuAssertIntEquals(tc, 31 * 8, first.GetQuad(3 * ZHVM_PAGE_SIZE + 8));
+    CuAssertIntEquals(tc, 55, second.GetQuad(5 * ZHVM_PAGE_SIZE + 8));
+
+    // Shared pages are copied on first write
+    std::stringstream base;
+    second.Checkpoint(base);
+    first.SetQuad(2 * ZHVM_PAGE_SIZE, 7);
+    CuAssertIntEquals(tc, 0, second.GetQuad(2 * ZHVM_PAGE_SIZE));
+    CuAssertIntEquals(tc, 0, first.GetQuad(ZHVM_PAGE_SIZE));
+
+    memory child;
+    first.Fork(&child);
+    CuAssertIntEquals(tc, 7, child.GetQuad(2 * ZHVM_PAGE_SIZE));
+    CuAssertIntEquals(tc, 55, child.GetQuad(5 * ZHVM_PAGE_SIZE + 8));
+    child.SetQuad(5 * ZHVM_PAGE_SIZE + 8, 56);
+    CuAssertIntEquals(tc, 55, first.GetQuad(5 * ZHVM_PAGE_SIZE + 8));
+
+    std::stringstream dumped;
+    second.Dump(dumped);
+    CuAssert(tc, "Shared image unchanged", dumped.str() == data);
+
+    std::stringstream delta;
+    second.Delta(delta);
+    CuAssert(tc, "Sharing changes no pages", delta.str().size() < ZHVM_PAGE_SIZE);
+
+}
+
+void TestHibernation(CuTest* tc) {
+
+    using namespace zhvm;
+
+    const char* path = "run-tests-hibernate.log";
+    const size_t size = 256 * ZHVM_PAGE_SIZE;
+
+    memory first(1024, size);
+    CuAssert(tc, "Assemble hibernation", Assemble("cll[,5]\nhlt[]\n", &first, LL_NONE) != 0);
+    first.SetFuncs(5, PoolFunc);
+    first.SetQuad(100 * ZHVM_PAGE_SIZE, 0x1234);
+    first.Set(RB, 77);
+    first.SetImageFlags(IF_ALIGNED);
+
+    memory second(1024, size);
+    second.SetQuad(8, 8);
+
+    {
+        hibernation_log log(path);
+        const uint64_t one = log.Suspend(&first);
+        const uint64_t two = log.Suspend(&second);
+        CuAssertIntEquals(tc, 0, first.DataSize());
+        CuAssertIntEquals(tc, 0, first.CodeSize());
+        // Zero pages take no space
+        CuAssert(tc, "Log is compact", log.Size() < 2 * ZHVM_PAGE_SIZE);
+
+        log.Resume(two, &second);
+        CuAssertIntEquals(tc, 8, second.GetQuad(8));
+
+        log.Resume(one, &first);
+        CuAssertIntEquals(tc, size, first.DataSize());
+        CuAssertIntEquals(tc, 0x1234, first.GetQuad(100 * ZHVM_PAGE_SIZE));
+        CuAssertIntEquals(tc, 77, first.Get(RB));
+        CuAssertIntEquals(tc, IF_ALIGNED, first.ImageFlags());
+        CuAssertIntEquals(tc, IR_HALT, Execute(&first, false));
+        CuAssertIntEquals(tc, 99, first.Get(RA));
+
+        // Resumed VM can be suspended again
+        first.SetQuad(0, 1);
+        const uint64_t three = log.Suspend(&first);
+        CuAssert(tc, "New record", three > two);
+        log.Resume(three, &first);
+        CuAssertIntEquals(tc, 1, first.GetQuad(0));
+
+        int thrown = 0;
+        try {
+            log.Resume(three + 1, &second);
+        } catch (std::runtime_error&) {
+            thrown = 1;
+        }
+        CuAssertIntEquals(tc, 1, thrown);
+        CuAssertIntEquals(tc, 8, second.GetQuad(8));
+    }
+    remove(path);
+
+}
+
+void TestDebugInfo(CuTest* tc) {
+
+    using namespace zhvm;
+
+    const char* program =
+            "!data\n"
+            "!table\n"
+            "!0x12\n"
+            "!code\n"
+            "!start\n"
+            "$a = add[,3]\n"
+            "!loop\n"
+            "$a = add[$a, $a]\n"
+            "$b = add[,1]\n"
+            "hlt[]\n";
+
+    memory mem(1024, 1024);
+    {
+        cmplv2 cmpl(program, &mem);
+        cmpl.SetLogLevel(LL_NONE);
+        CuAssertIntEquals(tc, 0, cmpl.SetDebug(true));
+        CuAssertIntEquals(tc, TT2_EOF, cmpl());
+    }
+    CuAssert(tc, "Debug info attached", mem.Debug() != 0);
+    CuAssertIntEquals(tc, IF_DEBUG, mem.ImageFlags());
+    CuAssertStrEquals(tc, "start:6", mem.Debug()->Symbolize(0).c_str());
+    CuAssertStrEquals(tc, "loop+0x4:9", mem.Debug()->Symbolize(8).c_str());
+    CuAssertIntEquals(tc, 10, mem.Debug()->Line(12));
+
+    uint32_t delta = 0;
+    CuAssertStrEquals(tc, "table", mem.Debug()->Label(0, DS_DATA, &delta));
+    CuAssertIntEquals(tc, 0, delta);
+    CuAssertStrEquals(tc, "start", mem.Debug()->Label(0, DS_CODE, 0));
+
+    const uint32_t layouts[] = {0, IF_SPARSE | IF_PACKED, IF_ALIGNED};
+    for (size_t i = 0; i < sizeof (layouts) / sizeof (layouts[0]); ++i) {
+        mem.SetImageFlags(IF_DEBUG | layouts[i]);
+        std::stringstream image;
+        mem.Dump(image);
+
+        memory loaded;
+        loaded.Load(image);
+        CuAssert(tc, "Debug info loaded", loaded.Debug() != 0);
+        CuAssertStrEquals(tc, "loop+0x4:9", loaded.Debug()->Symbolize(8).c_str());
+        CuAssertStrEquals(tc, "table", loaded.Debug()->Label(4, DS_DATA, &delta));
+        CuAssertIntEquals(tc, 4, delta);
+        CuAssertIntEquals(tc, IR_HALT, Execute(&loaded, false));
+        CuAssertIntEquals(tc, 6, loaded.Get(RA));
+    }
+
+    // Mapped aligned image reads debug section behind data
+    const char* path = "run-tests-debug.bin";
+    {
+        std::ofstream out(path, std::ios_base::out | std::ios_base::binary);
+        mem.Dump(out);
+    }
+    memory mapped;
+    mapped.Map(path, true);
+    remove(path);
+    CuAssert(tc, "Debug info mapped", mapped.Debug() != 0);
+    CuAssertStrEquals(tc, "start:6", mapped.Debug()->Symbolize(0).c_str());
+
+    // Image without debug info has no section
+    std::stringstream plain;
+    mem.SetDebug(std::shared_ptr<const debug_info>());
+    CuAssertIntEquals(tc, IF_ALIGNED, mem.ImageFlags());
+    mem.Dump(plain);
+    memory stripped;
+    stripped.Load(plain);
+    CuAssert(tc, "No debug info", stripped.Debug() == 0);
+
+}
+
+int CountFunc(zhvm::memory* mem, void* userdata) {
+    int* counter = (int*) userdata;
+    ++*counter;
+    mem->Set(zhvm::RB, *counter);
+    return zhvm::IR_RUN;
+}
+
+void TestHostTable(CuTest* tc) {
+
+    using namespace zhvm;
+
+    const char* program =
+            "!import count\n"
+            "!import other\n"
+            "cll[,@count]\n"
+            "cll[,@count]\n"
+            "hlt[]\n";
+
+    memory mem(1024, 1024);
+    {
+        cmplv2 cmpl(program, &mem);
+        cmpl.SetLogLevel(LL_NONE);
+        CuAssertIntEquals(tc, TT2_EOF, cmpl());
+    }
+    CuAssertIntEquals(tc, IF_IMPORTS, mem.ImageFlags());
+
+    std::vector<std::string> unbound;
+    mem.Unbound(&unbound);
+    CuAssertIntEquals(tc, 2, unbound.size());
+
+    // Imported name keeps its index
+    int counter = 0;
+    CuAssertIntEquals(tc, ZHVM_CFUNC_ARRAY_SIZE, mem.Bind("count", CountFunc, &counter));
+    CuAssertIntEquals(tc, ZHVM_CFUNC_ARRAY_SIZE + 2, mem.Bind("extra", PoolFunc));
+    unbound.clear();
+    mem.Unbound(&unbound);
+    CuAssertIntEquals(tc, 1, unbound.size());
+    CuAssertStrEquals(tc, "other", unbound[0].c_str());
+
+    // Copy shares table until it changes
+    memory copy(mem);
+    copy.SetFuncs(ZHVM_CFUNC_ARRAY_SIZE, PoolFunc);
+
+    CuAssertIntEquals(tc, IR_HALT, Execute(&mem, false));
+    CuAssertIntEquals(tc, 2, counter);
+    CuAssertIntEquals(tc, 2, mem.Get(RB));
+    CuAssertIntEquals(tc, IR_HALT, Execute(&copy, false));
+    CuAssertIntEquals(tc, 99, copy.Get(RA));
+    CuAssertIntEquals(tc, 2, counter);
+
+    // Table grows past standard slots
+    mem.SetFuncs(100, PoolFunc);
+    CuAssertIntEquals(tc, 101, mem.Funcs().Size());
+    CuAssertIntEquals(tc, IR_RUN, mem.Call(100));
+    int thrown = 0;
+    try {
+        mem.Call(101);
+    } catch (std::runtime_error&) {
+        thrown = 1;
+    }
+    CuAssertIntEquals(tc, 1, thrown);
+
+    // Image keeps imports, names bound before load are resolved
+    const uint32_t layouts[] = {0, IF_SPARSE | IF_PACKED, IF_ALIGNED};
+    for (size_t i = 0; i < sizeof (layouts) / sizeof (layouts[0]); ++i) {
+        mem.SetImageFlags(mem.ImageFlags() | layouts[i]);
+        mem.Set(RP, 0);
+        std::stringstream image;
+        mem.Dump(image);
+        mem.SetImageFlags(mem.ImageFlags() & ~layouts[i]);
+
+        memory host;
+        int loaded = 0;
+        host.Bind("count", CountFunc, &loaded);
+        host.Load(image);
+
+        uint32_t index = 0;
+        CuAssert(tc, "Import loaded", host.Funcs().Find("other", &index));
+        CuAssertIntEquals(tc, ZHVM_CFUNC_ARRAY_SIZE + 1, index);
+        CuAssertIntEquals(tc, IR_HALT, Execute(&host, false));
+        CuAssertIntEquals(tc, 2, loaded);
+    }
+
+    // Standard slots have no names
+    thrown = 0;
+    try {
+        mem.Bind("", PoolFunc);
+    } catch (std::runtime_error&) {
+        thrown = 1;
+    }
+    CuAssertIntEquals(tc, 1, thrown);
+
+}
+
+void TestBufferedIo(CuTest* tc) {
+
+    using namespace zhvm;
+
+    const char* program =
+            "$a = add[,16]\n"
+            "$b = add[,5]\n"
+            "cll[,5]\n"
+            "$c = add[$b]\n"
+            "cll[,4]\n"
+            "$a = add[,33]\n"
+            "cll[,2]\n"
+            "cll[,0]\n"
+            "hlt[]\n";
+
+    memory mem(1024, 1024);
+    {
+        cmplv2 cmpl(program, &mem);
+        cmpl.SetLogLevel(LL_NONE);
+        CuAssertIntEquals(tc, TT2_EOF, cmpl());
+    }
+
+    std::stringstream out;
+    std::stringstream inp("hello world");
+    {
+        buffered_io io(&out, &inp, 8);
+        io.Install(&mem);
+        CuAssertIntEquals(tc, IR_HALT, Execute(&mem, false));
+        CuAssertIntEquals(tc, 5, mem.Get(RC));
+        CuAssertIntEquals(tc, 'h', mem.GetByte(16));
+
+        // Full buffer goes to stream, last value waits for flush
+        CuAssertStrEquals(tc, "hello!", out.str().c_str());
+        CuAssertIntEquals(tc, 5, io.Pending());
+        io.Flush();
+        CuAssertStrEquals(tc, "hello!0x21\n", out.str().c_str());
+
+        mem.Set(RA, 0);
+        mem.Set(RB, 100);
+        CuAssertIntEquals(tc, IR_RUN, mem.Call(CN_READ));
+        CuAssertIntEquals(tc, 6, mem.Get(RB));
+        CuAssertIntEquals(tc, 'w', mem.GetByte(1));
+
+        mem.Set(RA, 0);
+        mem.Set(RB, 2);
+        mem.Call(CN_WRITE);
+        CuAssertIntEquals(tc, 2, io.Pending());
+    }
+    // Destructor flushes
+    CuAssertStrEquals(tc, "hello!0x21\n w", out.str().c_str());
+
+    // Zero capacity writes every output at once
+    std::stringstream direct;
+    {
+        buffered_io io(&direct, &inp, 0);
+        io.Install(&mem);
+        mem.Set(RA, 'x');
+        mem.Call(CN_PUTC);
+        mem.Set(RA, 1);
+        mem.Call(CN_PUT);
+        CuAssertStrEquals(tc, "x0x1\n", direct.str().c_str());
+        CuAssertIntEquals(tc, 0, io.Pending());
+    }
+
+    int thrown = 0;
+    try {
+        buffered_io io(&out, &inp);
+        io.Install(&mem);
+        mem.Set(RA, 1000);
+        mem.Set(RB, 100);
+        mem.Call(CN_WRITE);
+    } catch (std::runtime_error&) {
+        thrown = 1;
+    }
+    CuAssertIntEquals(tc, 1, thrown);
+
+}
+
+/**
+ * Compile ZLang program, run it and return printed values. Value of first
+ * loop result register is stored to loop when given, or -1 if loop has no
+ * result.
+ */
+std::string RunZlg(const char* text, int64_t* loop) {
+
+    using namespace zhvm;
+
+    zlg::ast root;
+    root.Scan(text);
+    zlg::context cont;
+    std::stringstream program;
+    root.Generate(program, &cont, 0);
+    cont.ProduceVariables(program);
+    program << "hlt[]" << std::endl;
+
+    memory mem(4096, 4096);
+    {
+        cmplv2 cmpl(program.str().c_str(), &mem);
+        cmpl.SetLogLevel(LL_NONE);
+        cmpl();
+    }
+
+    // Registers never written by program keep marker
+    for (uint32_t reg = RA; reg <= R8; ++reg) {
+        mem.Set(reg, -7);
+    }
+
+    std::stringstream out;
+    std::stringstream inp;
+    buffered_io io(&out, &inp);
+    io.Install(&mem);
+    Execute(&mem, false);
+    io.Flush();
+
+    if (loop == 0) {
+        return out.str();
+    }
+    *loop = -1;
+    const zlg::zblock* block = dynamic_cast<const zlg::zblock*> (root.Items().front().get());
+    for (auto& item : block->Items()) {
+        const zlg::zwhile* node = dynamic_cast<const zlg::zwhile*> (item.get());
+        if ((node != 0) && (node->result() >= 0)) {
+            *loop = mem.Get(node->result());
+            break;
+        }
+    }
+    return out.str();
+}
+
+void TestZlgCountedLoop(CuTest* tc) {
+
+    // Counted loop and same loop, which condition hides counter
+    const char* counted[] = {
+        "[\ni = 3\ns = 0\ndum (i) [\ns = s + i\ni = i - 1\n]\npresi i\npresi s\n]\n",
+        "[\ni = 3\ndum (i) [\ni = i - 1\n]\npresi i\n]\n",
+        "[\ni = 3\ndum (i) i = i - 1\npresi i\n]\n",
+        "[\ni = 0\ns = 5\ndum (i) [\ns = s + 1\ni = i - 1\n]\npresi i\npresi s\n]\n",
+        "[\ni = 0\ndum (i) i = i - 1\npresi i\n]\n",
+    };
+    const char* plain[] = {
+        "[\ni = 3\ns = 0\ndum (i + 0) [\ns = s + i\ni = i - 1\n]\npresi i\npresi s\n]\n",
+        "[\ni = 3\ndum (i + 0) [\ni = i - 1\n]\npresi i\n]\n",
+        "[\ni = 3\ndum (i + 0) i = i - 1\npresi i\n]\n",
+        "[\ni = 0\ns = 5\ndum (i + 0) [\ns = s + 1\ni = i - 1\n]\npresi i\npresi s\n]\n",
+        "[\ni = 0\ndum (i + 0) i = i - 1\npresi i\n]\n",
+    };
+
+    for (size_t i = 0; i < sizeof (counted) / sizeof (counted[0]); ++i) {
+        int64_t cres = 0;
+        std::string cprinted = RunZlg(counted[i], &cres);
+        std::string pprinted = RunZlg(plain[i], 0);
+        CuAssertStrEquals(tc, pprinted.c_str(), cprinted.c_str());
+
+        // Result is final counter value
+        CuAssertIntEquals(tc, 0, cres);
+    }
+
+}
+
 CuSuite* RegisterTests() {
     CuSuite* suite = CuSuiteNew();
     SUITE_ADD_TEST(suite, TestGetSetRegisters);
     SUITE_ADD_TEST(suite, TestGetSetMemory);
     SUITE_ADD_TEST(suite, TestCommands);
+    SUITE_ADD_TEST(suite, TestVectors);
+    SUITE_ADD_TEST(suite, TestVectorKernels);
+    SUITE_ADD_TEST(suite, TestHash);
+    SUITE_ADD_TEST(suite, TestPushPop);
+    SUITE_ADD_TEST(suite, TestLoop);
+    SUITE_ADD_TEST(suite, TestFloat);
+    SUITE_ADD_TEST(suite, TestCompact);
+    SUITE_ADD_TEST(suite, TestLoadOldImage);
+    SUITE_ADD_TEST(suite, TestWindows);
+    SUITE_ADD_TEST(suite, TestCustomOpcode);
+    SUITE_ADD_TEST(suite, TestSharedCode);
+    SUITE_ADD_TEST(suite, TestFork);
+    SUITE_ADD_TEST(suite, TestForkUntouched);
+    SUITE_ADD_TEST(suite, TestForkDescriptors);
+    SUITE_ADD_TEST(suite, TestMapImage);
+    SUITE_ADD_TEST(suite, TestSparseImage);
+    SUITE_ADD_TEST(suite, TestCheckpoint);
+    SUITE_ADD_TEST(suite, TestWideSegments);
+    SUITE_ADD_TEST(suite, TestGrowable);
+    SUITE_ADD_TEST(suite, TestSegmentOptions);
+    SUITE_ADD_TEST(suite, TestBulkAccess);
+    SUITE_ADD_TEST(suite, TestMapFile);
+    SUITE_ADD_TEST(suite, TestMemoryPool);
+    SUITE_ADD_TEST(suite, TestPageStore);
+    SUITE_ADD_TEST(suite, TestHibernation);
+    SUITE_ADD_TEST(suite, TestDebugInfo);
+    SUITE_ADD_TEST(suite, TestHostTable);
+    SUITE_ADD_TEST(suite, TestBufferedIo);
+    SUITE_ADD_TEST(suite, TestZlgCountedLoop);
     return suite;
 }
 